@@ -0,0 +1,87 @@
+#include "alloc_counter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Calls made by every thread
+static thread_local long long thread_allocations = 0;
+static thread_local long long thread_deallocations = 0;
+
+static void *allocate(std::size_t size)
+{
+    thread_allocations++;
+
+    void *p = std::malloc(size == 0 ? 1 : size);
+
+    if (p == 0)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+static void deallocate(void *p)
+{
+    if (p == 0)
+        return;
+
+    thread_deallocations++;
+    std::free(p);
+}
+
+void *operator new(std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    thread_allocations++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    thread_allocations++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
+
+AllocationScope::AllocationScope()
+{
+    allocations_ = thread_allocations;
+    deallocations_ = thread_deallocations;
+}
+
+long long AllocationScope::allocations() const
+{
+    return thread_allocations - allocations_;
+}
+
+long long AllocationScope::deallocations() const
+{
+    return thread_deallocations - deallocations_;
+}
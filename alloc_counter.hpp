@@ -0,0 +1,22 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+// Counts of calls of the global operator new and delete. Linking
+// alloc_counter.o replaces the global operators by counting ones (on top of
+// malloc and free), only the benchmarks are linked with it. Counters are per
+// thread, so work of background threads isn't counted
+class AllocationScope {
+
+    long long allocations_, deallocations_;
+
+public:
+
+    // Start counting from now
+    AllocationScope();
+
+    // Calls made by this thread since the scope started
+    long long allocations() const;
+    long long deallocations() const;
+};
+
+#endif
@@ -0,0 +1,1188 @@
+// Benchmarks of the loader, math, picking, lists, draw submission, bounds, mesh
+// formats and the job system on 1 to n threads. GL is replaced by gl_stub.hpp,
+// so nothing but the compiler is needed. Every benchmark is run a few times to
+// warm up and then repeatedly; the median and the median absolute deviation of
+// the time per operation are printed and can be written to a JSON file. Two
+// such files can be compared, changes beyond a threshold (and beyond the noise)
+// are reported as regressions. Per-frame paths are also checked to make no heap
+// allocations (counted by alloc_counter.hpp), any allocation fails the run,
+// rotations by the controllers to stay orthonormal, commands posted by threads
+// to arrive and centroids to be accurate
+
+#include "gl_stub.hpp"
+#include "alloc_counter.hpp"
+#include "scene.hpp"
+#include "primitive_mesh.hpp"
+#include "primitives.hpp"
+#include "list.hpp"
+#include "parallel.hpp"
+#include "bounds.hpp"
+#include "binary_mesh.hpp"
+#include "obj_writer.hpp"
+#include "mat.hpp"
+#include "vec.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Result of a benchmark: times in nanoseconds per operation
+struct Result {
+    string name;
+    int ops;                    // Operations per repetition
+    double median, mad, min;
+};
+
+int warmup = 3, repetitions = 15;
+
+// Only benchmarks with names containing filter are run
+const char *filter = "";
+
+vector<Result> results;
+
+// Keeps results of benchmarked code alive
+volatile double sink;
+
+template <class F>
+void measure(const string & name, int ops, F body)
+{
+    if (name.find(filter) == string::npos)
+        return;
+
+    for (int i = 0; i < warmup; i++)
+        body();
+
+    vector<double> t(repetitions);
+
+    for (int i = 0; i < repetitions; i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        body();
+        t[i] = chrono::duration<double, nano>(
+            chrono::steady_clock::now() - start).count() / ops;
+    }
+
+    sort(t.begin(), t.end());
+
+    Result r;
+    r.name = name;
+    r.ops = ops;
+    r.min = t[0];
+    r.median = t[repetitions / 2];
+
+    for (int i = 0; i < repetitions; i++)
+        t[i] = fabs(t[i] - r.median);
+    sort(t.begin(), t.end());
+    r.mad = t[repetitions / 2];
+
+    results.push_back(r);
+
+    cout << left << setw(36) << name << right << fixed << setprecision(1) <<
+        setw(14) << r.median << " ns +- " << setw(10) << r.mad <<
+        " (min " << r.min << ")" << endl;
+}
+
+// Loading (parsing, upload and start of simplification) of every file
+void loader_benchmarks(int n, char **files)
+{
+    Mesh::use_cache = false;
+
+    for (int i = 0; i < n; i++) {
+        string name = files[i];
+        name = name.substr(name.find_last_of('/') + 1);
+
+        measure("load/" + name, 1, [&]() {
+            Mesh mesh;
+            mesh.load_file(files[i]);
+        });
+    }
+}
+
+void math_benchmarks()
+{
+    const int products = 1000, vertices = 100000;
+
+    mat4 a = RotY(0.01) * RotX(0.02) * Translate(0.1, 0.2, 0.3);
+
+    measure("mat4/multiply", products, [&]() {
+        mat4 m(1);
+        for (int i = 0; i < products; i++)
+            m = m * a;
+        sink = m[0][0];
+    });
+
+    vector<vec3> v(vertices), u(vertices);
+    for (int i = 0; i < vertices; i++)
+        v[i] = vec3(i % 100, i % 37, i % 11);
+
+    measure("mat4/transform", vertices, [&]() {
+        for (int i = 0; i < vertices; i++)
+            u[i] = a * v[i];
+        sink = u[vertices - 1].x;
+    });
+
+    // A step of a rotation controller about a pivot: a product of matrices
+    // before, an update of the components and composition of the matrix now
+    vec3 pivot(1, 2, 3);
+    mat4 about = Translate(pivot) * RotY(0.001) * Translate(-pivot);
+    quat q(vec3(0, 1, 0), -0.001);
+
+    measure("mat4/rotate_about", products, [&]() {
+        mat4 m(1);
+        for (int i = 0; i < products; i++)
+            m = about * m;
+        sink = m[0][0];
+    });
+
+    measure("transform/rotate_about", products, [&]() {
+        Transform t;
+        for (int i = 0; i < products; i++)
+            t.rotate_about(q, pivot);
+        sink = t.matrix()[0][0];
+    });
+}
+
+// Largest deviation of the linear part of A from an orthonormal matrix
+static double orthonormality_error(const mat4 & A)
+{
+    double error = 0;
+
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++) {
+            double d = i == j ? -1 : 0;
+
+            for (int k = 0; k < 3; k++)
+                d += (double) A[k][i] * A[k][j];
+
+            error = max(error, fabs(d));
+        }
+
+    return error;
+}
+
+// Many small rotations, as a controller drag applies them, about the three
+// axes in turn: accumulated in a quaternion they stay a rotation, products
+// of matrices drift; returns false if the quaternion drifts too
+bool drift_check()
+{
+    if (string("transform/drift").find(filter) == string::npos)
+        return true;
+
+    const int steps = 1000000;
+    const double tolerance = 1e-5;
+
+    quat q[3] = { quat(vec3(1, 0, 0), 0.001), quat(vec3(0, 1, 0), -0.001),
+        quat(vec3(0, 0, 1), 0.001) };
+    mat4 r[3] = { RotX(0.001), RotY(0.001), RotZ(0.001) };
+
+    Transform t;
+    mat4 m(1);
+
+    for (int i = 0; i < steps; i++) {
+        t.rotate_about(q[i % 3], vec3(0));
+        m = r[i % 3] * m;
+    }
+
+    double error = orthonormality_error(t.matrix());
+
+    cout << left << setw(36) << "transform/drift" << right <<
+        scientific << setprecision(2) << setw(14) << error <<
+        " after " << steps << " rotations (matrices " <<
+        orthonormality_error(m) << ")" <<
+        (error > tolerance ? "  FAILED" : "") << fixed << endl;
+
+    return error <= tolerance;
+}
+
+void picking_benchmarks(Scene & scene)
+{
+    const int points = 1000;
+
+    mt19937 random(1);
+    uniform_real_distribution<GLfloat> coordinate(-1, 1);
+    vector<vec2> p(points);
+
+    for (int i = 0; i < points; i++)
+        p[i] = vec2(coordinate(random), coordinate(random));
+
+    measure("pick/segment", points, [&]() {
+        int hits = 0;
+        for (int i = 0; i < points; i++)
+            hits += belongs_to_segment(p[i], vec2(-0.5, -0.3),
+                vec2(0.6, 0.4), 0.05);
+        sink = hits;
+    });
+
+    // Pointer away from the gizmo: all of its axes are tested
+    scene.activate_translation();
+
+    measure("pick/gizmo", 1, [&]() {
+        sink = scene.local_transform(-1, 0, 0, 0.9, -0.9);
+    });
+
+    scene.deactivate_transformation();
+}
+
+// A million elements pushed and popped one by one, and pushed and released
+// together, with nodes of an allocator
+template <template <class> class Allocator>
+void list_allocator_benchmarks(const string & allocator)
+{
+    const int n = 1000000;
+
+    measure("list/push_pop_1m/" + allocator, 2 * n, [&]() {
+        List<int, Allocator> list;
+        for (int i = 0; i < n; i++)
+            list.push(i);
+
+        int sum = 0;
+        for (int i = 0; i < n; i++)
+            sum += list.pop_head();
+        sink = sum;
+    });
+
+    measure("list/push_clear_1m/" + allocator, n, [&]() {
+        List<int, Allocator> list;
+        for (int i = 0; i < n; i++)
+            list.push(i);
+
+        sink = list.length();
+        list.clear();
+    });
+}
+
+void list_benchmarks()
+{
+    const int n = 10000, indexed = 1000;
+
+    measure("list/push_pop", n, [&]() {
+        List<int> list;
+        for (int i = 0; i < n; i++)
+            list.push(i);
+
+        int sum = 0;
+        for (int i = 0; i < n; i++)
+            sum += list.pop_head();
+        sink = sum;
+    });
+
+    List<int> list;
+    for (int i = 0; i < n; i++)
+        list.push(i);
+
+    measure("list/iterate", n, [&]() {
+        int sum = 0;
+        for (list.set_iterator(); list.iterator(); list.iterate())
+            sum += list.get_iterator();
+        sink = sum;
+    });
+
+    // Indexing walks the list
+    measure("list/index", indexed, [&]() {
+        int sum = 0;
+        for (int i = 0; i < indexed; i++)
+            sum += list[i];
+        sink = sum;
+    });
+
+    list_allocator_benchmarks<HeapNodes>("heap");
+    list_allocator_benchmarks<NodePool>("pool");
+    list_allocator_benchmarks<NodeArena>("arena");
+}
+
+void draw_benchmarks(Scene & scene)
+{
+    if (string("draw/scene").find(filter) == string::npos)
+        return;
+
+    // Small objects: levels of detail of every copy are built at start
+    scene.add_synthetic(64, 64000, 1, solarized);
+    scene.wait_lods();
+
+    GLStubCounters before = gl_stub;
+    scene.draw();
+
+    cout << "draw/scene: 64 objects, " <<
+        gl_stub.draw_calls - before.draw_calls << " draw calls, " <<
+        gl_stub.state_calls - before.state_calls << " other calls" << endl;
+
+    measure("draw/scene", 1, [&]() {
+        scene.draw();
+    });
+}
+
+// Operations on the active object of a large scene: picking and dragging a
+// controller and switching objects look the object up several times
+void scene_benchmarks()
+{
+    const int n = 100000;
+    const char *names[7] = { "scene/pick", "scene/drag", "scene/switch",
+        "scene/replace", "scene/bounds", "scene/cull", "scene/draw" };
+
+    bool selected = false;
+    for (int i = 0; i < 7; i++)
+        selected = selected || string(names[i]).find(filter) != string::npos;
+
+    if (!selected)
+        return;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // Boxes are too small to be simplified
+    PrimitiveMesh box(Primitive::box, 0);
+    Scene scene;
+    scene.init(0, 1, 2);
+    scene.set_viewport(600, 600);
+
+    // Rows of instances of one mesh in front of and behind the camera
+    Handle geometry = scene.add_geometry(box);
+
+    for (int i = 0; i < n; i++)
+        scene.add_instance(geometry, Transform(vec3(i % 400 - 200, 0,
+            i / 400 - 125), quat(), vec3(1)), solarized);
+
+    cout << "scene: " << n << " objects added in " <<
+        chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count() << " ms" << endl;
+
+    scene.activate_translation();
+
+    measure(names[0], 1, [&]() {
+        sink = scene.local_transform(-1, 0, 0, 0.9, -0.9);
+    });
+
+    measure(names[1], 2, [&]() {
+        scene.local_transform(0, 0.001, 0, 0, 0);
+        scene.local_transform(0, -0.001, 0, 0, 0);
+    });
+
+    scene.deactivate_transformation();
+
+    measure(names[2], 2, [&]() {
+        scene.previous_object();
+        scene.next_object();
+    });
+
+    // Object next to the last one is removed and a new one is added
+    measure(names[3], 1, [&]() {
+        scene.remove_object(scene.active_object());
+        scene.add_instance(geometry, Transform(), solarized);
+        scene.previous_object();
+    });
+
+    measure(names[4], n, [&]() {
+        scene.update_bounds();
+    });
+
+    measure(names[5], n, [&]() {
+        sink = scene.cull();
+    });
+
+    cout << "scene: " << scene.cull() << " objects visible" << endl;
+
+    measure(names[6], n, [&]() {
+        scene.draw();
+    });
+}
+
+// World transformations of a hierarchy of n objects: a root with about
+// sqrt(n) children, each with about sqrt(n) children
+void hierarchy_benchmarks()
+{
+    const int n = 100000;
+    const char *names[2] = { "hierarchy/root", "hierarchy/leaf" };
+
+    if (string(names[0]).find(filter) == string::npos &&
+        string(names[1]).find(filter) == string::npos)
+        return;
+
+    PrimitiveMesh box(Primitive::box, 0);
+    Scene scene;
+    scene.init(0, 1, 2);
+
+    Handle geometry = scene.add_geometry(box);
+    Handle root = scene.add_instance(geometry, Transform(), solarized);
+    Handle leaf = root;
+
+    int branches = sqrt(n);
+    vector<Handle> parents;
+
+    for (int i = 1; i < n; i++) {
+        Handle parent = i <= branches ? root : parents[i % branches];
+        leaf = scene.add_instance(geometry, Transform(vec3(i % branches, 0,
+            i / branches), quat(), vec3(1)), solarized);
+
+        scene.set_parent(leaf, parent);
+
+        if (i <= branches)
+            parents.push_back(leaf);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    scene.update_world();
+
+    cout << "hierarchy: " << n << " objects, order built in " <<
+        chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count() << " ms" << endl;
+
+    // Moving the root updates all the objects, a leaf only itself
+    GLfloat x = 0;
+
+    measure(names[0], n, [&]() {
+        x += 0.001;
+        scene.set_transformation(root,
+            Transform(vec3(x, 0, 0), quat(), vec3(1)));
+        scene.update_world();
+    });
+
+    measure(names[1], 1, [&]() {
+        x += 0.001;
+        scene.set_transformation(leaf,
+            Transform(vec3(x, 0, 0), quat(), vec3(1)));
+        scene.update_world();
+    });
+}
+
+// Changes posted to a scene from other threads: posting a command, posting
+// and applying it on GL thread, and several threads posting while GL thread
+// applies; returns false if commands of the threads were lost
+bool command_checks()
+{
+    const int n = 10000, threads = 4, posts = 2000, meshes = 25;
+
+    const char *names[3] = { "commands/post", "commands/post_apply",
+        "commands/threads" };
+
+    bool selected = false;
+    for (int i = 0; i < 3; i++)
+        selected = selected || string(names[i]).find(filter) != string::npos;
+
+    if (!selected)
+        return true;
+
+    PrimitiveMesh box(Primitive::box, 0);
+    Scene scene;
+    scene.init(0, 1, 2);
+
+    Handle object = scene.add_object(box);
+    Transform t;
+
+    measure(names[0], n, [&]() {
+        for (int i = 0; i < n; i++)
+            scene.post_transformation(object, t);
+    });
+
+    scene.apply_commands();
+
+    measure(names[1], n, [&]() {
+        for (int i = 0; i < n; i++)
+            scene.post_transformation(object, t);
+        sink = scene.apply_commands();
+    });
+
+    // Workers move the object, add meshes they make, move them through the
+    // handles they get and remove every other one; GL thread applies the
+    // commands until the workers are done and the queue is empty
+    vector<thread> workers;
+    vector<Handle> added[threads];
+    int applied = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    for (int w = 0; w < threads; w++)
+        workers.push_back(thread([&, w]() {
+            for (int i = 0; i < posts; i++) {
+                scene.post_transformation(object,
+                    Transform(vec3(w, i, 0), quat(), vec3(1)));
+
+                if (i % (posts / meshes) == 0) {
+                    Geometry g;
+                    make_primitive(g, Primitive::box, 0);
+
+                    Mesh *mesh = new Mesh;
+                    mesh -> set_geometry(move(g), "box", 60);
+                    Handle h = scene.post_add_object(mesh, t, solarized);
+
+                    scene.post_transformation(h,
+                        Transform(vec3(w, i, 1), quat(), vec3(1)));
+                    if (added[w].size() % 2 == 1)
+                        scene.post_remove_object(h);
+
+                    added[w].push_back(h);
+                }
+            }
+        }));
+
+    for (int w = 0; w < threads; w++) {
+        while (scene.commands_pending())
+            applied += scene.apply_commands();
+
+        workers[w].join();
+    }
+
+    applied += scene.apply_commands();
+
+    // Added objects are there unless they were removed
+    int kept = (meshes + 1) / 2;
+    bool lost = false;
+
+    for (int w = 0; w < threads; w++)
+        for (size_t k = 0; k < added[w].size(); k++)
+            lost = lost || (scene.object(added[w][k]) != 0) != (k % 2 == 0);
+
+    int expected = threads * (posts + 2 * meshes + meshes - kept);
+    lost = lost || applied != expected ||
+        scene.objects_number() != 1 + threads * kept;
+
+    cout << left << setw(36) << names[2] << right << setw(14) << applied <<
+        " commands of " << threads << " threads applied in " <<
+        chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count() << " ms" <<
+        (lost ? "  FAILED" : "") << endl;
+
+    return !lost;
+}
+
+// Bounds and centroid of 4M points: the scalar loops the loader had (float
+// sum, branches), and the reduction over AoS, SoA and transformed points.
+// Points are far from the origin, where float sums lose the centroid
+bool bounds_benchmarks()
+{
+    const int n = 1 << 22;
+    const double tolerance = 1e-4;
+    const char *names[5] = { "bounds/scalar", "bounds/aos", "bounds/soa",
+        "bounds/world", "bounds/centroid" };
+
+    bool selected = false;
+    for (int i = 0; i < 5; i++)
+        selected = selected || string(names[i]).find(filter) != string::npos;
+
+    if (!selected)
+        return true;
+
+    mt19937 random(1);
+    uniform_real_distribution<GLfloat> coordinate(999, 1001);
+
+    vector<vec3> v(n);
+    vector<GLfloat> x(n), y(n), z(n);
+    double exact[3] = { 0, 0, 0 };
+
+    for (int i = 0; i < n; i++) {
+        v[i] = vec3(coordinate(random), coordinate(random),
+            coordinate(random));
+        x[i] = v[i].x, y[i] = v[i].y, z[i] = v[i].z;
+
+        for (int j = 0; j < 3; j++)
+            exact[j] += v[i][j];
+    }
+
+    vec3 center;
+
+    measure(names[0], n, [&]() {
+        GLfloat limit[6] = { v[0].x, v[0].x, v[0].y, v[0].y, v[0].z, v[0].z };
+        center = vec3(0);
+
+        for (int i = 0; i < n; i++) {
+            center += v[i];
+
+            for (int j = 0; j < 3; j++) {
+                if (v[i][j] < limit[2 * j])
+                    limit[2 * j] = v[i][j];
+                if (v[i][j] > limit[2 * j + 1])
+                    limit[2 * j + 1] = v[i][j];
+            }
+        }
+
+        center /= n;
+        sink = limit[0];
+    });
+
+    PointBounds bounds;
+
+    measure(names[1], n, [&]() {
+        bounds = point_bounds(v.data(), n);
+    });
+
+    measure(names[2], n, [&]() {
+        sink = point_bounds(x.data(), y.data(), z.data(), n).min.x;
+    });
+
+    mat4 t = Translate(1, 2, 3) * RotY(0.5) * RotX(0.3);
+
+    measure(names[3], n, [&]() {
+        sink = point_bounds(v.data(), n, t).min.x;
+    });
+
+    if (string(names[4]).find(filter) == string::npos)
+        return true;
+
+    // Largest error of a coordinate of the centroid
+    double scalar_error = 0, error = 0;
+    PointBounds soa = point_bounds(x.data(), y.data(), z.data(), n);
+
+    for (int j = 0; j < 3; j++) {
+        double c = exact[j] / n;
+
+        scalar_error = max(scalar_error, fabs(center[j] - c));
+        error = max(error, max(fabs(bounds.centroid[j] - c),
+            fabs(soa.centroid[j] - c)));
+    }
+
+    bool same_box = soa.min.x == bounds.min.x && soa.max.z == bounds.max.z;
+    bool failed = error > tolerance || !same_box;
+
+    cout << left << setw(36) << names[4] << right << scientific <<
+        setprecision(2) << setw(14) << error << " error of " << n <<
+        " points (float sum " << scalar_error << ")" <<
+        (failed ? "  FAILED" : "") << fixed << endl;
+
+    return !failed;
+}
+
+// Print the volumes of the oriented box and the sphere of points relative to
+// their axis aligned box and the sphere around that box
+void volume_report(const string & name, const MeshBounds & bounds)
+{
+    const PointBounds & points = bounds.points;
+    const OrientedBox & box = bounds.box;
+    const BoundingSphere & sphere = bounds.sphere;
+
+    vec3 size = points.max - points.min;
+    double box_volume = (double) size.x * size.y * size.z;
+    double oriented = 8.0 * box.half.x * box.half.y * box.half.z;
+    double box_radius = length(size) / 2;
+
+    cout << left << setw(36) << "volumes/" + name << right <<
+        setprecision(1) << setw(10) << 100 * oriented / box_volume <<
+        " % of the box, sphere " << 100 * pow(sphere.radius / box_radius, 3) <<
+        " % of the box's" << endl;
+}
+
+void volume_report(const string & name, const Mesh & mesh)
+{
+    MeshBounds bounds;
+
+    bounds.points = mesh.world_bounds(mat4(1));
+    bounds.box = mesh.oriented_box();
+    bounds.sphere = mesh.tight_sphere();
+
+    volume_report(name, bounds);
+}
+
+// Oriented boxes and spheres: time of mesh_bounds() over a rotated
+// elongated cloud of points, which has to fit in both, and their volumes for
+// the cloud, a torus and the files. Returns false if a point is outside
+bool volume_benchmarks(int n, char **files)
+{
+    const int points = 1 << 22;
+    const double tolerance = 1e-4;
+
+    if (string("volumes/").find(filter) == string::npos &&
+        string(filter).find("volumes/") != 0)
+        return true;
+
+    // Box of 10 x 2 x 0.5 rotated about two axes
+    mt19937 random(1);
+    uniform_real_distribution<GLfloat> coordinate(-1, 1);
+    mat4 t = Translate(3, 2, 1) * RotY(0.5) * RotX(0.3) * RotZ(0.7);
+    vector<vec3> cloud(points);
+
+    for (int i = 0; i < points; i++)
+        cloud[i] = t * vec3(5 * coordinate(random), coordinate(random),
+            0.25 * coordinate(random));
+
+    MeshBounds bounds;
+
+    measure("volumes/fit", points, [&]() {
+        bounds = mesh_bounds(cloud.data(), points);
+    });
+
+    // Largest distance of a point outside the box or the sphere
+    const OrientedBox & box = bounds.box;
+    const BoundingSphere & sphere = bounds.sphere;
+    GLfloat outside = 0;
+
+    for (int i = 0; i < points; i++) {
+        vec3 d = cloud[i] - box.center;
+
+        for (int k = 0; k < 3; k++)
+            outside = max(outside, fabs(dot(d, box.axis[k])) - box.half[k]);
+
+        outside = max(outside,
+            length(cloud[i] - sphere.center) - sphere.radius);
+    }
+
+    bool failed = outside > tolerance;
+
+    cout << left << setw(36) << "volumes/contained" << right << scientific <<
+        setprecision(2) << setw(14) << outside << " outside" <<
+        (failed ? "  FAILED" : "") << fixed << endl;
+
+    volume_report("cloud", bounds);
+
+    volume_report("torus", PrimitiveMesh(Primitive::torus, 32));
+
+    Mesh::use_cache = false;
+
+    for (int i = 0; i < n; i++) {
+        string name = files[i];
+        name = name.substr(name.find_last_of('/') + 1);
+
+        Mesh file;
+        if (file.read_file(files[i]))
+            volume_report(name, file);
+    }
+
+    return !failed;
+}
+
+// The same icosphere read from .obj, binary STL and binary PLY files (without
+// the cache): time of read_file() and the throughput of reading and
+// converting the file (its read, parse and resolve phases) in MB/s. Corners
+// of the STL file have to weld back into the vertices of the sphere, corners
+// of both binary files have to keep their coordinates; returns false if a
+// file doesn't give the sphere back
+bool import_benchmarks()
+{
+    const int levels = 6;
+    const char *files[mesh_formats] = {
+        "bench_import.obj", "bench_import.stl", "bench_import.ply"
+    };
+
+    if (string("import/").find(filter) == string::npos &&
+        string(filter).find("import/") != 0)
+        return true;
+
+    Geometry sphere;
+    make_primitive(sphere, Primitive::icosphere, levels);
+
+    ObjWriter obj;
+    bool written = obj.open(files[0]);
+    obj.write_vertices(sphere.v, sphere.v_number);
+    obj.write_faces(sphere.f, sphere.f_number);
+
+    written = obj.close() && written &&
+        write_stl(files[1], sphere.v, sphere.f, sphere.f_number) &&
+        write_ply(files[2], sphere.v, sphere.v_number, sphere.f,
+            sphere.f_number);
+
+    bool failed = !written;
+
+    Mesh::use_cache = false;
+
+    for (int i = 0; i < mesh_formats && written; i++) {
+        string name = string("import/") + mesh_format_names[i];
+        Mesh mesh;
+        bool read = true;
+
+        measure(name, 1, [&]() {
+            read = mesh.read_file(files[i]) && read;
+        });
+
+        const LoadStats & stats = mesh.load_stats();
+        double time = stats.time[(int) LoadPhase::read] +
+            stats.time[(int) LoadPhase::parse] +
+            stats.time[(int) LoadPhase::resolve];
+
+        bool same = read && mesh_format(files[i]) == (MeshFormat) i &&
+            stats.vertices == sphere.v_number &&
+            stats.triangles == sphere.f_number;
+
+        // Binary files keep the coordinates, corners have to be where they
+        // were
+        if ((MeshFormat) i != MeshFormat::obj) {
+            MappedFile file;
+            ImportedMesh mesh;
+            LoadStats stats;
+            stats.name = files[i];
+
+            same = same && file.open(files[i]) &&
+                ((MeshFormat) i == MeshFormat::stl ?
+                import_stl(file, mesh, stats) : import_ply(file, mesh, stats));
+
+            for (int c = 0; same && c < 3 * sphere.f_number; c++) {
+                const vec3 & a = mesh.v[mesh.f[c]];
+                const vec3 & b = sphere.v[sphere.f[c]];
+
+                same = a.x == b.x && a.y == b.y && a.z == b.z;
+            }
+        }
+
+        failed = failed || !same;
+
+        cout << left << setw(36) << name + "/throughput" << right <<
+            setw(14) << stats.bytes / 1e3 / time << " MB/s, " <<
+            stats.bytes / 1e6 << " MB" << (same ? "" : "  FAILED") << endl;
+    }
+
+    for (int i = 0; i < mesh_formats; i++)
+        remove(files[i]);
+
+    if (!written)
+        cout << "import: files can't be written  FAILED" << endl;
+
+    return !failed;
+}
+
+// Job system on 1 to max_threads threads: cost of a job of an empty parallel
+// loop (run at once on one thread), bounds of the objects of a large scene
+// and reading of every file as a job, with a continuation summing up their
+// faces
+void job_benchmarks(int n, char **files, int max_threads)
+{
+    const int objects = 100000, jobs = 1024;
+    const char *names[3] = { "jobs/overhead/", "jobs/bounds/", "jobs/load/" };
+
+    // Names end with the number of threads, filters may include it
+    bool selected = false;
+    for (int i = 0; i < 3; i++)
+        selected = selected || string(names[i]).find(filter) != string::npos ||
+            string(filter).find(names[i]) == 0;
+
+    if (!selected)
+        return;
+
+    PrimitiveMesh box(Primitive::box, 0);
+    Scene scene;
+    scene.init(0, 1, 2);
+
+    Handle geometry = scene.add_geometry(box);
+
+    for (int i = 0; i < objects; i++)
+        scene.add_instance(geometry, Transform(vec3(i % 400 - 200, 0,
+            i / 400 - 125), quat(), vec3(1)), solarized);
+
+    scene.update_world();
+
+    for (int t = 1; t <= max_threads; t++) {
+        set_job_threads(t);
+
+        measure(names[0] + to_string(t), jobs, [&]() {
+            parallel_for(jobs, 1, [](int, int) {});
+        });
+
+        measure(names[1] + to_string(t), objects, [&]() {
+            scene.update_bounds();
+        });
+
+        if (n == 0)
+            continue;
+
+        measure(names[2] + to_string(t), 1, [&]() {
+            vector<Mesh> meshes(n);
+            vector<Job *> reads(n);
+            long long faces = 0;
+
+            Job sum([&]() {
+                for (int i = 0; i < n; i++)
+                    faces += meshes[i].load_stats().triangles;
+            });
+
+            for (int i = 0; i < n; i++) {
+                reads[i] = new Job([&, i]() {
+                    meshes[i].read_file(files[i]);
+                });
+                sum.depend_on(*reads[i]);
+            }
+
+            sum.submit();
+
+            for (int i = 0; i < n; i++)
+                reads[i] -> submit();
+
+            sum.wait();
+
+            for (int i = 0; i < n; i++) {
+                reads[i] -> wait();
+                delete reads[i];
+            }
+
+            sink = faces;
+        });
+    }
+
+    set_job_threads(0);
+}
+
+// Heap allocations of body in steady state: after a first call, which may
+// build things lazily, over repeated calls
+template <class F>
+long long count_allocations(const string & name, F body)
+{
+    const int calls = 100;
+
+    body();
+
+    AllocationScope scope;
+
+    for (int i = 0; i < calls; i++)
+        body();
+
+    long long n = scope.allocations();
+
+    cout << left << setw(36) << name << right << setw(14) << n <<
+        " allocations in " << calls << " calls" << (n > 0 ? "  FAILED" : "") <<
+        endl;
+
+    return n;
+}
+
+// Per-frame paths: drawing, camera updates and controller picking and
+// dragging; returns false if any of them allocates
+bool allocation_checks(Scene & scene)
+{
+    if (string("alloc/frame").find(filter) == string::npos)
+        return true;
+
+    long long n = 0;
+
+    scene.toogle_vertex_normals();
+    scene.toogle_face_normals();
+    scene.toogle_bounding_box();
+
+    n += count_allocations("alloc/draw", [&]() {
+        scene.draw();
+    });
+
+    n += count_allocations("alloc/interaction", [&]() {
+        scene.begin_interaction();
+        scene.draw();
+        scene.end_interaction();
+    });
+
+    n += count_allocations("alloc/camera", [&]() {
+        scene.update_camera_move(1, -1);
+        scene.update_camera_roll(1);
+        scene.update_camera_zoom(1);
+        scene.update_camera_spherical(1, 1);
+        scene.update_camera_spherical(-1, -1);
+        scene.update_camera_roll(-1);
+        scene.update_camera_zoom(-1);
+        scene.update_camera_move(-1, 1);
+    });
+
+    void (Scene::*controllers[3])() = { &Scene::activate_translation,
+        &Scene::activate_scaling, &Scene::activate_rotation };
+    const char *names[3] = { "translation", "scaling", "rotation" };
+
+    for (int i = 0; i < 3; i++) {
+        (scene.*controllers[i])();
+
+        n += count_allocations(string("alloc/") + names[i], [&]() {
+            scene.draw();
+            scene.local_transform(-1, 0, 0, 0.9, -0.9);
+            scene.local_transform(0, 0.001, 0, 0, 0);
+            scene.local_transform(0, -0.001, 0, 0, 0);
+        });
+    }
+
+    scene.deactivate_transformation();
+    scene.toogle_vertex_normals();
+    scene.toogle_face_normals();
+    scene.toogle_bounding_box();
+
+    return n == 0;
+}
+
+// Write results as JSON, one benchmark per line
+bool write_json(const char *json_file)
+{
+    ofstream file(json_file);
+
+    if (!file) {
+        cout << "Can't write " << json_file << endl;
+        return false;
+    }
+
+    file << fixed << setprecision(3);
+    file << "{" << endl;
+    file << "  \"warmup\": " << warmup << "," << endl;
+    file << "  \"repetitions\": " << repetitions << "," << endl;
+    file << "  \"benchmarks\": [" << endl;
+
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const Result & r = results[i];
+
+        file << "    {\"name\": \"" << r.name << "\", \"ops\": " << r.ops <<
+            ", \"median_ns\": " << r.median << ", \"mad_ns\": " << r.mad <<
+            ", \"min_ns\": " << r.min << "}" <<
+            (i + 1 < results.size() ? "," : "") << endl;
+    }
+
+    file << "  ]" << endl << "}" << endl;
+
+    return true;
+}
+
+// Value of "key" on a line of a file written by write_json
+static string json_value(const string & line, const string & key)
+{
+    size_t p = line.find("\"" + key + "\": ");
+
+    if (p == string::npos)
+        return "";
+
+    p += key.size() + 4;
+
+    if (line[p] == '"')
+        return line.substr(p + 1, line.find('"', p + 1) - p - 1);
+
+    return line.substr(p, line.find_first_of(",}", p) - p);
+}
+
+static bool read_json(const char *json_file, vector<Result> & read)
+{
+    ifstream file(json_file);
+    string line;
+
+    if (!file) {
+        cout << "Can't read " << json_file << endl;
+        return false;
+    }
+
+    while (getline(file, line)) {
+        Result r;
+        r.name = json_value(line, "name");
+
+        if (r.name.empty())
+            continue;
+
+        r.ops = atoi(json_value(line, "ops").c_str());
+        r.median = atof(json_value(line, "median_ns").c_str());
+        r.mad = atof(json_value(line, "mad_ns").c_str());
+        r.min = atof(json_value(line, "min_ns").c_str());
+
+        read.push_back(r);
+    }
+
+    return true;
+}
+
+// Print changes of the medians from base to current, returns the number of
+// regressions: slower by more than threshold (in percent) and by more than
+// twice the deviations of both runs
+int compare(const char *base_file, const char *current_file,
+    double threshold)
+{
+    vector<Result> base, current;
+
+    if (!read_json(base_file, base) || !read_json(current_file, current))
+        return -1;
+
+    int regressions = 0;
+
+    for (unsigned int i = 0; i < current.size(); i++) {
+        const Result & c = current[i];
+        const Result *b = 0;
+
+        for (unsigned int j = 0; j < base.size() && b == 0; j++)
+            if (base[j].name == c.name)
+                b = &base[j];
+
+        cout << left << setw(36) << c.name << right << fixed <<
+            setprecision(1);
+
+        if (b == 0) {
+            cout << setw(14) << c.median << " ns (new)" << endl;
+            continue;
+        }
+
+        double change = (c.median - b -> median) / b -> median * 100;
+        bool regression = change > threshold &&
+            c.median - b -> median > 2 * (c.mad + b -> mad);
+
+        cout << setw(14) << b -> median << " -> " << setw(14) << c.median <<
+            " ns " << showpos << setw(7) << change << noshowpos << "%" <<
+            (regression ? "  REGRESSION" : "") << endl;
+
+        regressions += regression;
+    }
+
+    cout << regressions << " regressions beyond " << threshold << "%" << endl;
+
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 3 && strcmp(argv[1], "--compare") == 0) {
+        double threshold = argc > 5 && strcmp(argv[4], "--threshold") == 0 ?
+            atof(argv[5]) : 10;
+
+        return compare(argv[2], argv[3], threshold) == 0 ?
+            EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    const char *json_file = 0;
+    int n = 0, max_threads = thread::hardware_concurrency();
+    char **files = new char *[argc];
+
+    // Options: --json <file>, --warmup <n>, --repetitions <n>,
+    // --filter <text>, --threads <n> (most threads of the job system), the
+    // rest are files to load
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            json_file = argv[++i];
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc)
+            repetitions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            max_threads = atoi(argv[++i]);
+        else if (argv[i][0] == '-') {
+            cerr << "Use: benchmark [--json file] [--warmup n] "
+                "[--repetitions n] [--filter text] [--threads n] "
+                "[file.obj ...]" << endl;
+            cerr << "     benchmark --compare base.json current.json "
+                "[--threshold percent]" << endl;
+            return EXIT_FAILURE;
+        } else
+            files[n++] = argv[i];
+
+    if (repetitions < 1)
+        repetitions = 1;
+    if (max_threads < 1)
+        max_threads = 1;
+
+    Scene scene;
+    scene.init(0, 1, 2);
+    scene.set_viewport(600, 600);
+    scene.add_primitive(Primitive::icosphere, 3, solarized);
+    scene.wait_lods();
+
+    loader_benchmarks(n, files);
+    math_benchmarks();
+    picking_benchmarks(scene);
+    list_benchmarks();
+    draw_benchmarks(scene);
+    scene_benchmarks();
+    hierarchy_benchmarks();
+    bool exact_bounds = bounds_benchmarks();
+    bool contained = volume_benchmarks(n, files);
+    bool imported = import_benchmarks();
+    job_benchmarks(n, files, max_threads);
+
+    bool no_allocations = allocation_checks(scene);
+    bool no_drift = drift_check();
+    bool no_lost_commands = command_checks();
+
+    delete[] files;
+
+    if (json_file != 0 && !write_json(json_file))
+        return EXIT_FAILURE;
+
+    return no_allocations && no_drift && no_lost_commands && exact_bounds &&
+        contained && imported ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,1067 @@
+#include "binary_mesh.hpp"
+#include "normals.hpp"
+#include "parallel.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+const char *mesh_format_names[mesh_formats] = { "obj", "stl", "ply" };
+
+// Sizes of the STL header (with the triangle count) and of its records
+const size_t stl_header = 84;
+const size_t stl_record = 50;
+
+// Largest number of triangles of a file, so that corners fit into int
+const long long max_import_faces = 0x7fffffff / 3;
+
+// Vertices and faces converted by one job of a parallel loop
+const int import_grain = 1 << 14;
+
+static bool big_endian_host()
+{
+    const uint16_t one = 1;
+    unsigned char first;
+
+    memcpy(&first, &one, 1);
+    return first == 0;
+}
+
+// Copy size bytes from p to q, reversed if swap
+static inline void load_bytes(void *q, const char *p, int size, bool swap)
+{
+    if (!swap) {
+        memcpy(q, p, size);
+        return;
+    }
+
+    unsigned char *b = static_cast<unsigned char *>(q);
+    for (int i = 0; i < size; i++)
+        b[i] = p[size - 1 - i];
+}
+
+static void print_error(const char *file, const string & message)
+{
+    cout << file << ": " << message << endl;
+}
+
+static string extension(const char *file)
+{
+    string name = file;
+    size_t dot = name.find_last_of('.');
+
+    if (dot == string::npos || name.find('/', dot) != string::npos)
+        return "";
+
+    string e = name.substr(dot + 1);
+    for (unsigned int i = 0; i < e.size(); i++)
+        e[i] = tolower(e[i]);
+
+    return e;
+}
+
+MeshFormat mesh_format(const char *file)
+{
+    char header[stl_header];
+    size_t read = 0;
+    long long size = -1;
+
+    FILE *fp = fopen(file, "rb");
+
+    if (fp != 0) {
+        read = fread(header, 1, stl_header, fp);
+        fclose(fp);
+    }
+
+    struct stat st;
+    if (stat(file, &st) == 0)
+        size = st.st_size;
+
+    if (read >= 4 && memcmp(header, "ply", 3) == 0 &&
+        (header[3] == '\n' || header[3] == '\r'))
+        return MeshFormat::ply;
+
+    if (read == stl_header) {
+        uint32_t count;
+        load_bytes(&count, header + 80, 4, big_endian_host());
+
+        if (size == (long long) (stl_header + stl_record * count))
+            return MeshFormat::stl;
+    }
+
+    string e = extension(file);
+
+    if (e == "stl")
+        return MeshFormat::stl;
+    if (e == "ply")
+        return MeshFormat::ply;
+
+    return MeshFormat::obj;
+}
+
+
+//
+// MappedFile
+//
+
+MappedFile::MappedFile() : data_(0), size_(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const char *file)
+{
+    close();
+
+    int fd = ::open(file, O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // Empty files have no pages, they are mapped as nothing
+    if (st.st_size == 0) {
+        ::close(fd);
+        return true;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+
+    void *data = mmap(0, st.st_size, PROT_READ, flags, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+#ifndef MAP_POPULATE
+    madvise(data, st.st_size, MADV_WILLNEED);
+#endif
+
+    data_ = static_cast<const char *>(data);
+    size_ = st.st_size;
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_ != 0)
+        munmap(const_cast<char *>(data_), size_);
+
+    data_ = 0;
+    size_ = 0;
+}
+
+
+//
+// ImportedMesh
+//
+
+ImportedMesh::ImportedMesh() : v(0), vn(0), f(0), v_number(0), f_number(0),
+    polygon_f(0), polygon_offset(0), polygon_number(0)
+{
+}
+
+ImportedMesh::~ImportedMesh()
+{
+    clear();
+}
+
+void ImportedMesh::clear()
+{
+    delete[] v;
+    delete[] vn;
+    delete[] f;
+    delete[] polygon_f;
+    delete[] polygon_offset;
+
+    v = vn = 0;
+    f = polygon_f = 0;
+    polygon_offset = 0;
+    v_number = f_number = polygon_number = 0;
+}
+
+
+//
+// STL
+//
+
+// Position of a corner as it is in the file (vec3 rounds tiny coordinates to
+// 0), corners are welded if their positions are equal bit for bit
+struct Position {
+    GLfloat x[3];
+};
+
+// Corner c of the triangles of an STL file, -0 is made 0
+static inline Position stl_corner(const char *records, int c, bool swap)
+{
+    const char *p = records + stl_record * (c / 3) + 12 + 12 * (c % 3);
+    Position position;
+
+    for (int k = 0; k < 3; k++) {
+        load_bytes(&position.x[k], p + 4 * k, 4, swap);
+        position.x[k] += 0.0f;
+    }
+
+    return position;
+}
+
+static inline bool same_position(const Position & a, const Position & b)
+{
+    return memcmp(&a, &b, sizeof(Position)) == 0;
+}
+
+// Fibonacci hashing of the bits of a position, high bits are the best mixed
+static inline unsigned long long position_hash(const Position & p)
+{
+    uint32_t x[3];
+    memcpy(x, &p, sizeof(x));
+
+    unsigned long long key = ((unsigned long long) x[0] << 32 | x[1]) *
+        0x9E3779B97F4A7C15ull;
+
+    return (key ^ x[2]) * 0x9E3779B97F4A7C15ull;
+}
+
+// Open addressing table of positions and their first corners, doubled when
+// it's half full. Positions are kept in the table, so that a probe reads
+// nothing else
+class WeldTable {
+
+    struct Slot {
+        Position position;
+        int first;              // -1 for empty slots
+    };
+
+    vector<Slot> slots_;
+    int bits_;
+    size_t used_;
+
+    // Slot of p: the one holding it or the empty one where it belongs
+    size_t find(const Position & p) const
+    {
+        size_t mask = slots_.size() - 1;
+        size_t slot = position_hash(p) >> (64 - bits_);
+
+        while (slots_[slot].first != -1 &&
+            !same_position(slots_[slot].position, p))
+            slot = (slot + 1) & mask;
+
+        return slot;
+    }
+
+    void resize(int bits)
+    {
+        vector<Slot> old(((size_t) 1 << bits));
+        old.swap(slots_);
+        bits_ = bits;
+
+        for (size_t i = 0; i < slots_.size(); i++)
+            slots_[i].first = -1;
+
+        for (size_t i = 0; i < old.size(); i++)
+            if (old[i].first != -1)
+                slots_[find(old[i].position)] = old[i];
+    }
+
+public:
+
+    // Room for about expected positions
+    explicit WeldTable(size_t expected) : bits_(0), used_(0)
+    {
+        int bits = 4;
+        while (((size_t) 1 << bits) < 2 * expected)
+            bits++;
+
+        resize(bits);
+    }
+
+    // First corner at the position p, c if there's none yet
+    int insert(const Position & p, int c)
+    {
+        size_t slot = find(p);
+
+        if (slots_[slot].first != -1)
+            return slots_[slot].first;
+
+        slots_[slot].position = p;
+        slots_[slot].first = c;
+
+        if (2 * ++used_ > slots_.size())
+            resize(bits_ + 1);
+
+        return c;
+    }
+
+    long long bytes() const
+    {
+        return slots_.size() * sizeof(Slot);
+    }
+};
+
+bool import_stl(const MappedFile & file, ImportedMesh & mesh,
+    LoadStats & stats)
+{
+    const char *name = stats.name.c_str();
+    const char *data = file.data();
+    bool swap = big_endian_host();
+
+    mesh.clear();
+
+    uint32_t count = 0;
+
+    if (file.size() >= stl_header)
+        load_bytes(&count, data + 80, 4, swap);
+
+    if (file.size() < stl_header ||
+        file.size() != stl_header + stl_record * count) {
+        print_error(name, file.size() >= 5 && memcmp(data, "solid", 5) == 0 ?
+            "ASCII STL files aren't supported" :
+            "size doesn't match the number of triangles");
+        return false;
+    }
+
+    if (count > max_import_faces) {
+        print_error(name, "too many triangles");
+        return false;
+    }
+
+    const char *records = data + stl_header;
+    int corners = 3 * count;
+    int threads = parallel_threads(corners);
+
+    // bucket[t * threads + b]: corners of the t-th range falling into the
+    // b-th bucket, every bucket is written by one thread only
+    vector< vector<int> > bucket(threads * threads);
+
+    parallel_for(corners, [&](int begin, int end, int t) {
+        for (int b = 0; b < threads; b++)
+            bucket[t * threads + b].reserve((end - begin) / threads + 16);
+
+        for (int c = begin; c < end; c++) {
+            unsigned long long h = position_hash(stl_corner(records, c, swap));
+            bucket[t * threads + (h >> 32) % threads].push_back(c);
+        }
+    });
+
+    stats.bytes = file.size();
+    stats.polygons = stats.triangles = count;
+    stats.lap(LoadPhase::parse);
+
+    mesh.f_number = count;
+    mesh.f = new GLuint[corners];
+
+    // f[c] is the first corner at the position of c for now; corners of a
+    // bucket come in increasing order, so the first one found is the first
+    // one of the file
+    vector<long long> table_bytes(threads);
+
+    parallel_for(threads, [&](int begin, int end, int) {
+        for (int b = begin; b < end; b++) {
+            size_t n = 0;
+            for (int t = 0; t < threads; t++)
+                n += bucket[t * threads + b].size();
+
+            // A vertex has about six corners in closed meshes
+            WeldTable table(n / 4);
+
+            for (int t = 0; t < threads; t++) {
+                const vector<int> & in = bucket[t * threads + b];
+
+                for (size_t j = 0; j < in.size(); j++)
+                    mesh.f[in[j]] = table.insert(stl_corner(records, in[j],
+                        swap), in[j]);
+            }
+
+            table_bytes[b] = table.bytes();
+        }
+    });
+
+    // Vertices are numbered in the order of their first corners: counted in
+    // every range, then numbered from the sum of the previous ranges
+    vector<int> vertices(threads + 1, 0);
+
+    parallel_for(corners, [&](int begin, int end, int t) {
+        for (int c = begin; c < end; c++)
+            if (mesh.f[c] == (GLuint) c)
+                vertices[t + 1]++;
+    });
+
+    for (int t = 0; t < threads; t++)
+        vertices[t + 1] += vertices[t];
+
+    mesh.v_number = vertices[threads];
+    mesh.v = new vec3[mesh.v_number];
+
+    // First corners get their vertex marked by the high bit (corners are
+    // below it), so that they are told from the others
+    const GLuint first = 0x80000000u;
+
+    parallel_for(corners, [&](int begin, int end, int t) {
+        for (int c = begin, i = vertices[t]; c < end; c++)
+            if (mesh.f[c] == (GLuint) c) {
+                Position p = stl_corner(records, c, swap);
+                vec3 & v = mesh.v[i];
+
+                v.x = p.x[0], v.y = p.x[1], v.z = p.x[2];
+                mesh.f[c] = first | i++;
+            }
+    });
+
+    // Other corners take the vertex of their first corner, then the marks
+    // are cleared
+    parallel_for(corners, import_grain, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+            if ((mesh.f[c] & first) == 0)
+                mesh.f[c] = mesh.f[mesh.f[c]] & ~first;
+    });
+
+    parallel_for(corners, import_grain, [&](int begin, int end) {
+        for (int c = begin; c < end; c++)
+            mesh.f[c] &= ~first;
+    });
+
+    long long buckets = 0;
+    for (int t = 0; t < threads * threads; t++)
+        buckets += bucket[t].capacity() * sizeof(int);
+    for (int b = 0; b < threads; b++)
+        buckets += table_bytes[b];
+
+    stats.vertices = mesh.v_number;
+    stats.peak_memory = file.size() + buckets;
+    stats.lap(LoadPhase::resolve);
+
+    return true;
+}
+
+
+//
+// PLY
+//
+
+const int ply_types = 8;
+
+// Types of properties: names (and their sized aliases) and sizes in bytes
+const char *ply_type_names[ply_types] = {
+    "char", "uchar", "short", "ushort", "int", "uint", "float", "double"
+};
+const char *ply_type_aliases[ply_types] = {
+    "int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64"
+};
+const int ply_type_size[ply_types] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+const int ply_float = 6;
+
+// Property of an element: a scalar of type, or a list of values of type
+// preceded by their number (of count_type, -1 for scalars)
+struct PlyProperty {
+    string name;
+    int type, count_type;
+    int offset;                 // In records of fixed size
+};
+
+// Element and its properties, records of fixed size have a stride (-1 for
+// records with lists); data is the first record
+struct PlyElement {
+    string name;
+    long long count;
+    vector<PlyProperty> properties;
+    int stride;
+    const char *data;
+};
+
+static int ply_type(const string & name)
+{
+    for (int i = 0; i < ply_types; i++)
+        if (name == ply_type_names[i] || name == ply_type_aliases[i])
+            return i;
+
+    return -1;
+}
+
+static inline double ply_value(const char *p, int type, bool swap)
+{
+    switch (type) {
+    case 0: { int8_t x; load_bytes(&x, p, 1, swap); return x; }
+    case 1: { uint8_t x; load_bytes(&x, p, 1, swap); return x; }
+    case 2: { int16_t x; load_bytes(&x, p, 2, swap); return x; }
+    case 3: { uint16_t x; load_bytes(&x, p, 2, swap); return x; }
+    case 4: { int32_t x; load_bytes(&x, p, 4, swap); return x; }
+    case 5: { uint32_t x; load_bytes(&x, p, 4, swap); return x; }
+    case 6: { float x; load_bytes(&x, p, 4, swap); return x; }
+    default: { double x; load_bytes(&x, p, 8, swap); return x; }
+    }
+}
+
+// Read the header up to end_header, elements get their properties and
+// strides; returns the start of the data or null (the error is printed)
+static const char * ply_header(const MappedFile & file, const char *name,
+    vector<PlyElement> & elements, bool & swap)
+{
+    const char *data = file.data();
+    const char *end = data + file.size();
+    const char *p = data;
+    bool format = false;
+
+    while (true) {
+        const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+
+        if (eol == 0) {
+            print_error(name, "PLY header has no end_header");
+            return 0;
+        }
+
+        istringstream line(string(p, eol));
+        string word;
+        line >> word;
+        p = eol + 1;
+
+        if (word == "end_header")
+            break;
+
+        if (word == "format") {
+            string type;
+            line >> type;
+
+            if (type == "ascii") {
+                print_error(name, "ASCII PLY files aren't supported");
+                return 0;
+            } else if (type == "binary_little_endian")
+                swap = big_endian_host();
+            else if (type == "binary_big_endian")
+                swap = !big_endian_host();
+            else {
+                print_error(name, "unknown PLY format " + type);
+                return 0;
+            }
+
+            format = true;
+        } else if (word == "element") {
+            PlyElement e;
+            e.count = -1;
+            line >> e.name >> e.count;
+            e.stride = 0;
+            e.data = 0;
+
+            if (e.count < 0) {
+                print_error(name, "wrong PLY element " + e.name);
+                return 0;
+            }
+
+            elements.push_back(e);
+        } else if (word == "property") {
+            PlyProperty property;
+            string type, count_type;
+            line >> type;
+
+            if (type == "list")
+                line >> count_type >> type;
+
+            line >> property.name;
+            property.type = ply_type(type);
+            property.count_type = count_type.empty() ? -1 :
+                ply_type(count_type);
+
+            if (elements.empty() || property.type < 0 ||
+                (!count_type.empty() && (property.count_type < 0 ||
+                property.count_type >= ply_float))) {
+                print_error(name, "wrong PLY property " + property.name);
+                return 0;
+            }
+
+            PlyElement & e = elements.back();
+
+            property.offset = e.stride;
+
+            if (property.count_type >= 0)
+                e.stride = -1;
+            else if (e.stride >= 0)
+                e.stride += ply_type_size[property.type];
+
+            e.properties.push_back(property);
+        }
+    }
+
+    if (!format) {
+        print_error(name, "PLY header has no format");
+        return 0;
+    }
+
+    return p;
+}
+
+
+// End of a record of e at p, or null if it passes end; the list of the
+// property list (if any) starts at *list_start
+static const char * ply_record_end(const PlyElement & e, const char *p,
+    const char *end, bool swap, int list = -1, const char **list_start = 0)
+{
+    for (int i = 0; i < (int) e.properties.size(); i++) {
+        const PlyProperty & property = e.properties[i];
+
+        if (i == list)
+            *list_start = p;
+
+        if (property.count_type < 0) {
+            p += ply_type_size[property.type];
+            continue;
+        }
+
+        if (end - p < ply_type_size[property.count_type])
+            return 0;
+
+        double n = ply_value(p, property.count_type, swap);
+        p += ply_type_size[property.count_type];
+
+        if (n < 0 || n * ply_type_size[property.type] > end - p)
+            return 0;
+
+        p += (long long) n * ply_type_size[property.type];
+    }
+
+    return p <= end ? p : 0;
+}
+
+static int ply_property(const PlyElement & e, const char *name)
+{
+    for (unsigned int i = 0; i < e.properties.size(); i++)
+        if (e.properties[i].name == name)
+            return i;
+
+    return -1;
+}
+
+// Convert vertices of e (records of fixed size) to mesh.v and mesh.vn,
+// returns false if they have no coordinates
+static bool ply_vertices(const PlyElement & e, ImportedMesh & mesh,
+    bool swap)
+{
+    const char *names[6] = { "x", "y", "z", "nx", "ny", "nz" };
+    int property[6];
+
+    for (int k = 0; k < 6; k++) {
+        property[k] = ply_property(e, names[k]);
+
+        if (property[k] >= 0 && e.properties[property[k]].count_type >= 0)
+            property[k] = -1;
+    }
+
+    if (e.stride < 0 || property[0] < 0 || property[1] < 0 ||
+        property[2] < 0)
+        return false;
+
+    bool normals = property[3] >= 0 && property[4] >= 0 && property[5] >= 0;
+    int coordinates = normals ? 6 : 3;
+
+    int offset[6], type[6];
+    for (int k = 0; k < coordinates; k++) {
+        offset[k] = e.properties[property[k]].offset;
+        type[k] = e.properties[property[k]].type;
+    }
+
+    mesh.v_number = e.count;
+    mesh.v = new vec3[mesh.v_number];
+    mesh.vn = normals ? new vec3[mesh.v_number] : 0;
+
+    // Records of nothing but three floats in the byte order of the host are
+    // the layout of vec3
+    if (!swap && !normals && e.stride == (int) sizeof(vec3) &&
+        offset[0] == 0 && offset[1] == 4 && offset[2] == 8 &&
+        type[0] == ply_float && type[1] == ply_float && type[2] == ply_float) {
+        memcpy(static_cast<void *>(mesh.v), e.data, e.count * sizeof(vec3));
+        return true;
+    }
+
+    parallel_for(mesh.v_number, import_grain, [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const char *p = e.data + (long long) e.stride * i;
+            GLfloat x[6];
+
+            for (int k = 0; k < coordinates; k++)
+                x[k] = ply_value(p + offset[k], type[k], swap);
+
+            mesh.v[i].x = x[0], mesh.v[i].y = x[1], mesh.v[i].z = x[2];
+
+            if (normals) {
+                vec3 n(x[3], x[4], x[5]);
+                mesh.vn[i] = length(n) > 0 ? normalize(n) : n;
+            }
+        }
+    });
+
+    return true;
+}
+
+// Convert faces of e to mesh.f (fans of triangles) and, if there are other
+// polygons than triangles, to mesh.polygon_f; polygons of fewer than three
+// corners are skipped. Returns false for records passing end or indices out
+// of range (the error is printed)
+static bool ply_faces(const PlyElement & e, const char *end,
+    ImportedMesh & mesh, bool swap, const char *name)
+{
+    int list = ply_property(e, "vertex_indices");
+    if (list < 0)
+        list = ply_property(e, "vertex_index");
+
+    if (list < 0 || e.properties[list].count_type < 0 ||
+        e.properties[list].type >= ply_float) {
+        print_error(name, "PLY faces have no list of vertex indices");
+        return false;
+    }
+
+    const PlyProperty & indices = e.properties[list];
+    int count_type = indices.count_type, index_type = indices.type;
+    int count_size = ply_type_size[count_type];
+    int index_size = ply_type_size[index_type];
+
+    // Records of triangles have a fixed size if the indices are the only
+    // list: stride and the offset of the list
+    bool fixed = true;
+    int stride = count_size + 3 * index_size, offset = 0;
+
+    for (int i = 0; i < (int) e.properties.size(); i++)
+        if (i != list) {
+            fixed = fixed && e.properties[i].count_type < 0;
+            stride += ply_type_size[e.properties[i].type];
+
+            if (i < list)
+                offset += ply_type_size[e.properties[i].type];
+        }
+
+    // Numbers of polygons, their corners and the triangles they are split
+    // into; records are of fixed size only if all of them are triangles
+    long long polygons = 0, corners = 0, triangles = 0;
+    const char *p = e.data, *start = 0;
+
+    for (long long i = 0; i < e.count; i++) {
+        const char *next = ply_record_end(e, p, end, swap, list, &start);
+
+        if (next == 0) {
+            print_error(name, "PLY faces pass the end of the file");
+            return false;
+        }
+
+        long long n = ply_value(start, count_type, swap);
+
+        fixed = fixed && n == 3;
+
+        if (n >= 3) {
+            polygons++;
+            corners += n;
+            triangles += n - 2;
+        }
+
+        p = next;
+    }
+
+    if (triangles > max_import_faces || corners > max_import_faces * 3) {
+        print_error(name, "too many triangles");
+        return false;
+    }
+
+    mesh.f_number = triangles;
+    mesh.f = new GLuint[3 * triangles];
+
+    GLuint v_number = mesh.v_number;
+    bool out_of_range = false;
+
+    auto index = [&](const char *q) {
+        double i = ply_value(q, index_type, swap);
+        return i >= 0 && i < v_number ? (GLuint) i : v_number;
+    };
+
+    if (fixed) {
+        vector<char> wrong(parallel_threads(mesh.f_number), 0);
+
+        parallel_for(mesh.f_number, [&](int begin, int end, int t) {
+            for (int i = begin; i < end; i++) {
+                const char *q = e.data + (long long) stride * i + offset +
+                    count_size;
+
+                for (int k = 0; k < 3; k++) {
+                    GLuint v = index(q + k * index_size);
+                    wrong[t] |= v == v_number;
+                    mesh.f[3 * i + k] = v;
+                }
+            }
+        });
+
+        for (unsigned int t = 0; t < wrong.size(); t++)
+            out_of_range = out_of_range || wrong[t];
+    } else {
+        // Polygons are kept if there are other ones than triangles
+        if (triangles != polygons) {
+            mesh.polygon_number = polygons;
+            mesh.polygon_f = new GLuint[corners];
+            mesh.polygon_offset = new int[polygons + 1];
+            mesh.polygon_offset[0] = 0;
+        }
+
+        p = e.data;
+
+        for (long long i = 0, polygon = 0, triangle = 0; i < e.count; i++) {
+            p = ply_record_end(e, p, end, swap, list, &start);
+
+            int n = ply_value(start, count_type, swap);
+            const char *q = start + count_size;
+
+            if (n < 3)
+                continue;
+
+            GLuint first = index(q), last = index(q + index_size);
+            out_of_range = out_of_range || first == v_number ||
+                last == v_number;
+
+            for (int k = 2; k < n; k++, triangle++) {
+                GLuint v = index(q + k * index_size);
+                out_of_range = out_of_range || v == v_number;
+
+                mesh.f[3 * triangle] = first;
+                mesh.f[3 * triangle + 1] = last;
+                mesh.f[3 * triangle + 2] = last = v;
+            }
+
+            if (mesh.polygon_f != 0) {
+                int o = mesh.polygon_offset[polygon];
+
+                for (int k = 0; k < n; k++)
+                    mesh.polygon_f[o + k] = index(q + k * index_size);
+
+                mesh.polygon_offset[++polygon] = o + n;
+            }
+        }
+    }
+
+    if (out_of_range) {
+        print_error(name, "PLY face index out of range");
+        return false;
+    }
+
+    return true;
+}
+
+bool import_ply(const MappedFile & file, ImportedMesh & mesh,
+    LoadStats & stats)
+{
+    const char *name = stats.name.c_str();
+    const char *end = file.data() + file.size();
+    vector<PlyElement> elements;
+    bool swap = false;
+
+    mesh.clear();
+
+    if (file.size() < 4 || memcmp(file.data(), "ply", 3) != 0) {
+        print_error(name, "not a PLY file");
+        return false;
+    }
+
+    const char *p = ply_header(file, name, elements, swap);
+
+    if (p == 0)
+        return false;
+
+    const PlyElement *vertices = 0, *faces = 0;
+
+    // Records of every element follow the previous ones, records with lists
+    // are walked to find their end; nothing after the vertices and faces is
+    // used, faces are walked when they are read
+    for (unsigned int i = 0; i < elements.size() && p != 0; i++) {
+        PlyElement & e = elements[i];
+        e.data = p;
+
+        if (e.name == "vertex" && vertices == 0)
+            vertices = &e;
+        else if (e.name == "face" && faces == 0)
+            faces = &e;
+
+        if (e.stride > 0 && e.count > (end - p) / e.stride) {
+            print_error(name, "PLY element " + e.name +
+                " passes the end of the file");
+            return false;
+        }
+
+        if (vertices != 0 && faces != 0)
+            break;
+
+        if (e.stride >= 0)
+            p += e.count * e.stride;
+        else
+            for (long long j = 0; j < e.count && p != 0; j++)
+                p = ply_record_end(e, p, end, swap);
+    }
+
+    if (p == 0) {
+        print_error(name, "PLY records pass the end of the file");
+        return false;
+    }
+
+    if (vertices == 0 || faces == 0) {
+        print_error(name, "PLY file has no vertices or faces");
+        return false;
+    }
+
+    if (vertices -> count > 0x7fffffff) {
+        print_error(name, "too many vertices");
+        return false;
+    }
+
+    if (!ply_vertices(*vertices, mesh, swap)) {
+        print_error(name, "PLY vertices have no coordinates");
+        mesh.clear();
+        return false;
+    }
+
+    if (!ply_faces(*faces, end, mesh, swap, name)) {
+        mesh.clear();
+        return false;
+    }
+
+    stats.bytes = file.size();
+    stats.vertices = mesh.v_number;
+    stats.normals = mesh.vn != 0 ? mesh.v_number : 0;
+    stats.polygons = mesh.polygon_f != 0 ? mesh.polygon_number :
+        mesh.f_number;
+    stats.triangles = mesh.f_number;
+    stats.peak_memory = file.size();
+    stats.lap(LoadPhase::parse);
+
+    return true;
+}
+
+
+//
+// Writers
+//
+
+// Put size bytes of x at p in little-endian order, returns the end
+static inline char * store_bytes(char *p, const void *x, int size)
+{
+    load_bytes(p, static_cast<const char *>(x), size, big_endian_host());
+    return p + size;
+}
+
+bool write_stl(const char *file, const vec3 *v, const GLuint *f,
+    int f_number)
+{
+    FILE *fp = fopen(file, "wb");
+
+    if (fp == 0)
+        return false;
+
+    char header[stl_header] = "binary STL";
+    uint32_t count = f_number;
+    store_bytes(header + 80, &count, 4);
+
+    bool ok = fwrite(header, stl_header, 1, fp) == 1;
+
+    // Records are written in blocks
+    const int block = 1 << 14;
+    char *buffer = new char[block * stl_record];
+    vec3 *normal = new vec3[block];
+
+    for (int first = 0; ok && first < f_number; first += block) {
+        int n = f_number - first < block ? f_number - first : block;
+        const GLuint *t = f + 3 * first;
+
+        face_normals(v, t, n, normal);
+
+        for (int i = 0; i < n; i++) {
+            char *p = buffer + stl_record * i;
+            const vec3 *x[4] = {
+                &normal[i], &v[t[3 * i]], &v[t[3 * i + 1]], &v[t[3 * i + 2]]
+            };
+
+            for (int j = 0; j < 4; j++)
+                for (int k = 0; k < 3; k++) {
+                    GLfloat c = (*x[j])[k];
+                    p = store_bytes(p, &c, 4);
+                }
+
+            p[0] = p[1] = 0;
+        }
+
+        ok = fwrite(buffer, stl_record, n, fp) == (size_t) n;
+    }
+
+    delete[] normal;
+    delete[] buffer;
+
+    return fclose(fp) == 0 && ok;
+}
+
+bool write_ply(const char *file, const vec3 *v, int v_number,
+    const GLuint *f, int f_number)
+{
+    FILE *fp = fopen(file, "wb");
+
+    if (fp == 0)
+        return false;
+
+    bool ok = fprintf(fp, "ply\nformat binary_little_endian 1.0\n"
+        "element vertex %d\nproperty float x\nproperty float y\n"
+        "property float z\nelement face %d\n"
+        "property list uchar int vertex_indices\nend_header\n",
+        v_number, f_number) > 0;
+
+    const int block = 1 << 14;
+    const int face_record = 13;
+    char *buffer = new char[block * face_record];
+
+    for (int first = 0; ok && first < v_number; first += block) {
+        int n = v_number - first < block ? v_number - first : block;
+
+        for (int i = 0; i < n; i++)
+            for (int k = 0; k < 3; k++) {
+                GLfloat x = v[first + i][k];
+                store_bytes(buffer + 12 * i + 4 * k, &x, 4);
+            }
+
+        ok = fwrite(buffer, 12, n, fp) == (size_t) n;
+    }
+
+    for (int first = 0; ok && first < f_number; first += block) {
+        int n = f_number - first < block ? f_number - first : block;
+
+        for (int i = 0; i < n; i++) {
+            char *p = buffer + face_record * i;
+            *p++ = 3;
+
+            for (int k = 0; k < 3; k++) {
+                int32_t index = f[3 * (first + i) + k];
+                p = store_bytes(p, &index, 4);
+            }
+        }
+
+        ok = fwrite(buffer, face_record, n, fp) == (size_t) n;
+    }
+
+    delete[] buffer;
+
+    return fclose(fp) == 0 && ok;
+}
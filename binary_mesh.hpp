@@ -0,0 +1,102 @@
+#ifndef BINARY_MESH_HPP
+#define BINARY_MESH_HPP
+
+#include <cstddef>
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+#include "load_stats.hpp"
+
+// Formats of mesh files: Wavefront .obj, binary STL and binary PLY
+enum class MeshFormat {
+    obj,
+    stl,
+    ply
+};
+
+const int mesh_formats = 3;
+
+// Names of the formats in the order of MeshFormat
+extern const char *mesh_format_names[mesh_formats];
+
+// Format of a file by its first bytes: a PLY header, or an STL header whose
+// triangle count matches the size of the file; other files by extension (.stl
+// and .ply, case insensitive), .obj for the rest. STL files starting with
+// "solid" are binary if the size matches, like the readers of CAD tools do
+MeshFormat mesh_format(const char *file);
+
+// Whole file mapped read-only, its pages are read ahead when it's opened
+class MappedFile {
+
+    const char *data_;
+    size_t size_;
+
+public:
+
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator = (const MappedFile &) = delete;
+
+    // Returns false if the file can't be opened or mapped
+    bool open(const char *file);
+    void close();
+
+    const char * data() const { return data_; }
+    size_t size() const { return size_; }
+};
+
+// Mesh read from a binary file: triangles, vertex normals if the file has
+// them and, for files with other polygons than triangles, the polygons
+// (corners of polygon i are polygon_f[polygon_offset[i]] ...
+// polygon_f[polygon_offset[i + 1] - 1]) split into fans of triangles in f.
+// Owns its arrays, the loader takes them
+struct ImportedMesh {
+
+    vec3 *v, *vn;
+    GLuint *f;
+    int v_number, f_number;
+
+    GLuint *polygon_f;
+    int *polygon_offset;
+    int polygon_number;
+
+    ImportedMesh();
+    ~ImportedMesh();
+
+    ImportedMesh(const ImportedMesh &) = delete;
+    ImportedMesh & operator = (const ImportedMesh &) = delete;
+
+    void clear();
+};
+
+// Binary STL: 80-byte header, triangle count and 50-byte records of a normal,
+// three corners and a two-byte attribute. Corners are read in parallel and
+// welded into shared vertices: corners of every range fall into buckets by a
+// hash of their position, every bucket is deduplicated by a hash table of its
+// own (positions equal bit for bit, -0 is 0), then vertices are numbered in
+// the order of their first corners, so the result doesn't depend on the
+// number of threads. Normals of the records are ignored. Parse and resolve
+// phases, sizes and peak memory go to stats; errors are printed and false is
+// returned
+bool import_stl(const MappedFile & file, ImportedMesh & mesh,
+    LoadStats & stats);
+
+// Binary PLY (either byte order): a vertex element with float or double x, y
+// and z and optionally nx, ny and nz, and a face element with a list of
+// vertex indices; other elements and properties are skipped. Vertices of
+// records of fixed size are converted in parallel, the common layout of
+// three little-endian floats is one copy; faces are read in order unless
+// all of them are triangles of fixed-size records. ASCII files are refused
+bool import_ply(const MappedFile & file, ImportedMesh & mesh,
+    LoadStats & stats);
+
+// Write triangles as binary STL (normals of the faces are computed) or binary
+// little-endian PLY, returns false if anything failed to be written
+bool write_stl(const char *file, const vec3 *v, const GLuint *f,
+    int f_number);
+bool write_ply(const char *file, const vec3 *v, int v_number,
+    const GLuint *f, int f_number);
+
+#endif
@@ -0,0 +1,762 @@
+#include "bounds.hpp"
+#include "parallel.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Points of a block, blocks are split between threads
+const int bounds_block = 1 << 16;
+
+// Box and sums of coordinates of a block of points
+struct BlockBounds {
+    GLfloat min[3], max[3];
+    double sum[3];
+};
+
+// Merge the bounds of the block b into a
+static void merge_blocks(BlockBounds & a, const BlockBounds & b)
+{
+    for (int j = 0; j < 3; j++) {
+        a.min[j] = b.min[j] < a.min[j] ? b.min[j] : a.min[j];
+        a.max[j] = b.max[j] > a.max[j] ? b.max[j] : a.max[j];
+        a.sum[j] += b.sum[j];
+    }
+}
+
+// Running bounds of a block, starting with one point: points are added as
+// the first three lanes of a SIMD register (the fourth is ignored), or as
+// three coordinates
+class BlockAccumulator {
+
+#ifdef __SSE2__
+    __m128 low_, high_;
+    __m128d xy_, zw_;
+#else
+    GLfloat low_[3], high_[3];
+    double sum_[3];
+#endif
+
+public:
+
+#ifdef __SSE2__
+    explicit BlockAccumulator(__m128 p) : low_(p), high_(p),
+        xy_(_mm_cvtps_pd(p)), zw_(_mm_cvtps_pd(_mm_movehl_ps(p, p)))
+    {
+    }
+
+    BlockAccumulator(GLfloat x, GLfloat y, GLfloat z) :
+        BlockAccumulator(_mm_set_ps(0, z, y, x))
+    {
+    }
+
+    void add(__m128 p)
+    {
+        low_ = _mm_min_ps(low_, p);
+        high_ = _mm_max_ps(high_, p);
+        xy_ = _mm_add_pd(xy_, _mm_cvtps_pd(p));
+        zw_ = _mm_add_pd(zw_, _mm_cvtps_pd(_mm_movehl_ps(p, p)));
+    }
+#else
+    BlockAccumulator(GLfloat x, GLfloat y, GLfloat z)
+    {
+        low_[0] = high_[0] = sum_[0] = x;
+        low_[1] = high_[1] = sum_[1] = y;
+        low_[2] = high_[2] = sum_[2] = z;
+    }
+#endif
+
+    void add(GLfloat x, GLfloat y, GLfloat z)
+    {
+#ifdef __SSE2__
+        add(_mm_set_ps(0, z, y, x));
+#else
+        GLfloat p[3] = { x, y, z };
+
+        for (int j = 0; j < 3; j++) {
+            low_[j] = p[j] < low_[j] ? p[j] : low_[j];
+            high_[j] = p[j] > high_[j] ? p[j] : high_[j];
+            sum_[j] += p[j];
+        }
+#endif
+    }
+
+    // Point at p, p[3] must be readable (it's the next point of an array)
+    void add(const GLfloat *p)
+    {
+#ifdef __SSE2__
+        add(_mm_loadu_ps(p));
+#else
+        add(p[0], p[1], p[2]);
+#endif
+    }
+
+    void store(BlockBounds & b) const
+    {
+#ifdef __SSE2__
+        GLfloat low[4], high[4];
+        double sum[4];
+
+        _mm_storeu_ps(low, low_);
+        _mm_storeu_ps(high, high_);
+        _mm_storeu_pd(sum, xy_);
+        _mm_storeu_pd(sum + 2, zw_);
+#else
+        const GLfloat *low = low_, *high = high_;
+        const double *sum = sum_;
+#endif
+
+        for (int j = 0; j < 3; j++) {
+            b.min[j] = low[j];
+            b.max[j] = high[j];
+            b.sum[j] = sum[j];
+        }
+    }
+};
+
+#ifdef __SSE2__
+// Point transformed by a matrix given by its columns
+static inline __m128 transform_point(const __m128 c[4], const vec3 & v)
+{
+    return _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(c[0], _mm_set1_ps(v.x)),
+        _mm_mul_ps(c[1], _mm_set1_ps(v.y))),
+        _mm_add_ps(_mm_mul_ps(c[2], _mm_set1_ps(v.z)), c[3]));
+}
+#endif
+
+// Bounds of blocks of n points (n > 0) merged into partial[0]: block(begin,
+// end, bounds) fills the bounds of the points in [begin, end), merge(a, b)
+// merges the bounds of b into a. Blocks are merged pairwise: neighbours, then
+// pairs of neighbours and so on
+template <class B, class F, class M>
+static void reduce_pairwise(int n, vector<B> & partial, F block, M merge)
+{
+    int blocks = (n - 1) / bounds_block + 1;
+    partial.resize(blocks);
+
+    parallel_for(blocks, 1, [&](int first, int last) {
+        for (int b = first; b < last; b++) {
+            int begin = b * bounds_block;
+            int end = n - begin > bounds_block ? begin + bounds_block : n;
+
+            block(begin, end, partial[b]);
+        }
+    });
+
+    for (int step = 1; step < blocks; step *= 2)
+        for (int b = 0; b + step < blocks; b += 2 * step)
+            merge(partial[b], partial[b + step]);
+}
+
+// Bounds of n points, block(begin, end, bounds) fills the bounds of the
+// points in [begin, end)
+template <class F>
+static PointBounds reduce_blocks(int n, F block)
+{
+    PointBounds bounds;
+
+    if (n <= 0) {
+        bounds.min = bounds.max = bounds.centroid = vec3(0);
+        return bounds;
+    }
+
+    vector<BlockBounds> partial;
+    reduce_pairwise(n, partial, block, merge_blocks);
+
+    const BlockBounds & all = partial[0];
+
+    bounds.min = vec3(all.min[0], all.min[1], all.min[2]);
+    bounds.max = vec3(all.max[0], all.max[1], all.max[2]);
+    bounds.centroid = vec3(all.sum[0] / n, all.sum[1] / n, all.sum[2] / n);
+
+    return bounds;
+}
+
+PointBounds point_bounds(const vec3 *v, int n)
+{
+    return reduce_blocks(n, [v](int begin, int end, BlockBounds & b) {
+        BlockAccumulator a(v[begin].x, v[begin].y, v[begin].z);
+
+        // Four floats are read at every point but the last one of a block
+        for (int i = begin + 1; i < end - 1; i++)
+            a.add(&v[i].x);
+
+        if (end - 1 > begin)
+            a.add(v[end - 1].x, v[end - 1].y, v[end - 1].z);
+
+        a.store(b);
+    });
+}
+
+PointBounds point_bounds(const GLfloat *x, const GLfloat *y, const GLfloat *z,
+    int n)
+{
+    return reduce_blocks(n, [=](int begin, int end, BlockBounds & b) {
+        int i = begin;
+        bool empty = true;
+
+#ifdef __SSE2__
+        // Four points at a time, every coordinate in its own registers
+        if (end - begin >= 4) {
+            const GLfloat *c[3] = { x, y, z };
+            __m128 low[3], high[3];
+            __m128d sum[3][2];
+
+            for (int j = 0; j < 3; j++) {
+                low[j] = high[j] = _mm_loadu_ps(c[j] + i);
+                sum[j][0] = sum[j][1] = _mm_setzero_pd();
+            }
+
+            for (; i + 4 <= end; i += 4)
+                for (int j = 0; j < 3; j++) {
+                    __m128 p = _mm_loadu_ps(c[j] + i);
+
+                    low[j] = _mm_min_ps(low[j], p);
+                    high[j] = _mm_max_ps(high[j], p);
+                    sum[j][0] = _mm_add_pd(sum[j][0], _mm_cvtps_pd(p));
+                    sum[j][1] = _mm_add_pd(sum[j][1],
+                        _mm_cvtps_pd(_mm_movehl_ps(p, p)));
+                }
+
+            for (int j = 0; j < 3; j++) {
+                GLfloat l[4], h[4];
+                double s[4];
+
+                _mm_storeu_ps(l, low[j]);
+                _mm_storeu_ps(h, high[j]);
+                _mm_storeu_pd(s, sum[j][0]);
+                _mm_storeu_pd(s + 2, sum[j][1]);
+
+                b.min[j] = l[0], b.max[j] = h[0], b.sum[j] = 0;
+
+                for (int k = 0; k < 4; k++) {
+                    b.min[j] = l[k] < b.min[j] ? l[k] : b.min[j];
+                    b.max[j] = h[k] > b.max[j] ? h[k] : b.max[j];
+                    b.sum[j] += s[k];
+                }
+            }
+
+            empty = false;
+        }
+#endif
+
+        // The rest of the points
+        if (i < end) {
+            BlockAccumulator a(x[i], y[i], z[i]);
+
+            for (i++; i < end; i++)
+                a.add(x[i], y[i], z[i]);
+
+            BlockBounds rest;
+            a.store(rest);
+
+            if (empty)
+                b = rest;
+            else
+                merge_blocks(b, rest);
+        }
+    });
+}
+
+PointBounds point_bounds(const vec3 *v, int n, const mat4 & t)
+{
+    return reduce_blocks(n, [&](int begin, int end, BlockBounds & b) {
+#ifdef __SSE2__
+        // Columns of the affine part of the transformation
+        __m128 c[4];
+        for (int j = 0; j < 4; j++)
+            c[j] = _mm_set_ps(0, t[2][j], t[1][j], t[0][j]);
+
+        BlockAccumulator a(transform_point(c, v[begin]));
+
+        for (int i = begin + 1; i < end; i++)
+            a.add(transform_point(c, v[i]));
+#else
+        vec3 p = t * v[begin];
+        BlockAccumulator a(p.x, p.y, p.z);
+
+        for (int i = begin + 1; i < end; i++) {
+            p = t * v[i];
+            a.add(p.x, p.y, p.z);
+        }
+#endif
+
+        a.store(b);
+    });
+}
+
+// Directions of extreme points: the axes and the diagonals
+const int extreme_directions = 7;
+
+// Moments and extreme points of a block: the smallest and the largest
+// projections of the points on the directions and the positions of those
+// points, sums of the coordinates and of their products (xx, xy, xz, yy, yz,
+// zz)
+struct BlockMoments {
+    GLfloat low[extreme_directions], high[extreme_directions];
+    int lowest[extreme_directions], highest[extreme_directions];
+    double sum[3], product[6];
+};
+
+// Position of the product of coordinates i and j in BlockMoments::product
+const int product_index[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+
+#ifdef __SSE2__
+// Projections of a point (x, y, z in the first lanes) on the diagonals: x + y
+// + z, x + y - z, x - y + z, -x + y + z
+static inline __m128 diagonals(__m128 p)
+{
+    const __m128 sign_x = _mm_set_ps(-0.0f, 0, 0, 0);
+    const __m128 sign_y = _mm_set_ps(0, -0.0f, 0, 0);
+    const __m128 sign_z = _mm_set_ps(0, 0, -0.0f, 0);
+
+    __m128 x = _mm_xor_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)),
+        sign_x);
+    __m128 y = _mm_xor_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)),
+        sign_y);
+    __m128 z = _mm_xor_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)),
+        sign_z);
+
+    return _mm_add_ps(_mm_add_ps(x, y), z);
+}
+
+// Take the position of the point in the lanes set in mask
+static inline void select(__m128i & position, __m128 mask, __m128i index)
+{
+    __m128i m = _mm_castps_si128(mask);
+
+    position = _mm_or_si128(_mm_and_si128(m, index),
+        _mm_andnot_si128(m, position));
+}
+
+// Extremes are kept without branches: the axes in the first three lanes of
+// one register (the fourth is ignored), the diagonals in another one
+static void block_moments(const vec3 *v, int begin, int end, BlockMoments & b)
+{
+    __m128 first = _mm_set_ps(0, v[begin].z, v[begin].y, v[begin].x);
+    __m128 low[2] = { first, diagonals(first) };
+    __m128 high[2] = { low[0], low[1] };
+    __m128i lowest[2], highest[2];
+    __m128d sum[2], product[3];
+
+    for (int k = 0; k < 2; k++)
+        lowest[k] = highest[k] = _mm_set1_epi32(begin);
+    for (int k = 0; k < 2; k++)
+        sum[k] = _mm_setzero_pd();
+    for (int k = 0; k < 3; k++)
+        product[k] = _mm_setzero_pd();
+
+    auto add = [&](__m128 p, int i) {
+        __m128 projection[2] = { p, diagonals(p) };
+        __m128i index = _mm_set1_epi32(i);
+
+        // The first point found keeps its place on ties
+        for (int k = 0; k < 2; k++) {
+            select(lowest[k], _mm_cmplt_ps(projection[k], low[k]), index);
+            select(highest[k], _mm_cmpgt_ps(projection[k], high[k]), index);
+            low[k] = _mm_min_ps(low[k], projection[k]);
+            high[k] = _mm_max_ps(high[k], projection[k]);
+        }
+
+        // Sums of x, y and z, w and of the products xx, yy; xy, yz; xz, zz
+        __m128d xy = _mm_cvtps_pd(p);
+        __m128d zw = _mm_cvtps_pd(_mm_movehl_ps(p, p));
+        __m128d yz = _mm_cvtps_pd(_mm_shuffle_ps(p, p,
+            _MM_SHUFFLE(3, 3, 2, 1)));
+        __m128d xz = _mm_cvtps_pd(_mm_shuffle_ps(p, p,
+            _MM_SHUFFLE(3, 3, 2, 0)));
+
+        sum[0] = _mm_add_pd(sum[0], xy);
+        sum[1] = _mm_add_pd(sum[1], zw);
+        product[0] = _mm_add_pd(product[0], _mm_mul_pd(xy, xy));
+        product[1] = _mm_add_pd(product[1], _mm_mul_pd(xy, yz));
+        product[2] = _mm_add_pd(product[2],
+            _mm_mul_pd(xz, _mm_unpacklo_pd(zw, zw)));
+    };
+
+    // Four floats are read at every point but the last one of a block
+    for (int i = begin; i < end - 1; i++)
+        add(_mm_loadu_ps(&v[i].x), i);
+
+    add(_mm_set_ps(0, v[end - 1].z, v[end - 1].y, v[end - 1].x), end - 1);
+
+    GLfloat l[8], h[8];
+    int lp[8], hp[8];
+    double s[4], q[6];
+
+    for (int k = 0; k < 2; k++) {
+        _mm_storeu_ps(l + 4 * k, low[k]);
+        _mm_storeu_ps(h + 4 * k, high[k]);
+        _mm_storeu_si128((__m128i *) (lp + 4 * k), lowest[k]);
+        _mm_storeu_si128((__m128i *) (hp + 4 * k), highest[k]);
+        _mm_storeu_pd(s + 2 * k, sum[k]);
+    }
+
+    for (int k = 0; k < 3; k++)
+        _mm_storeu_pd(q + 2 * k, product[k]);
+
+    // Lanes to directions, the fourth lane of the axes is skipped
+    for (int k = 0; k < extreme_directions; k++) {
+        int lane = k < 3 ? k : k + 1;
+
+        b.low[k] = l[lane];
+        b.high[k] = h[lane];
+        b.lowest[k] = lp[lane];
+        b.highest[k] = hp[lane];
+    }
+
+    for (int j = 0; j < 3; j++)
+        b.sum[j] = s[j];
+
+    b.product[0] = q[0];
+    b.product[1] = q[2];
+    b.product[2] = q[4];
+    b.product[3] = q[1];
+    b.product[4] = q[3];
+    b.product[5] = q[5];
+}
+#else
+static inline void project_extremes(const vec3 & p,
+    GLfloat d[extreme_directions])
+{
+    d[0] = p.x;
+    d[1] = p.y;
+    d[2] = p.z;
+    d[3] = p.x + p.y + p.z;
+    d[4] = p.x + p.y - p.z;
+    d[5] = p.x - p.y + p.z;
+    d[6] = -p.x + p.y + p.z;
+}
+static void block_moments(const vec3 *v, int begin, int end, BlockMoments & b)
+{
+    GLfloat d[extreme_directions];
+    double sum[3] = { 0, 0, 0 }, product[6] = { 0, 0, 0, 0, 0, 0 };
+
+    project_extremes(v[begin], d);
+
+    for (int k = 0; k < extreme_directions; k++) {
+        b.low[k] = b.high[k] = d[k];
+        b.lowest[k] = b.highest[k] = begin;
+    }
+
+    for (int i = begin; i < end; i++) {
+        const vec3 & p = v[i];
+
+        // The first point found keeps its place on ties
+        project_extremes(p, d);
+
+        for (int k = 0; k < extreme_directions; k++) {
+            if (d[k] < b.low[k])
+                b.low[k] = d[k], b.lowest[k] = i;
+            if (d[k] > b.high[k])
+                b.high[k] = d[k], b.highest[k] = i;
+        }
+
+        double x = p.x, y = p.y, z = p.z;
+
+        sum[0] += x;
+        sum[1] += y;
+        sum[2] += z;
+        product[0] += x * x;
+        product[1] += x * y;
+        product[2] += x * z;
+        product[3] += y * y;
+        product[4] += y * z;
+        product[5] += z * z;
+    }
+
+    for (int j = 0; j < 3; j++)
+        b.sum[j] = sum[j];
+    for (int j = 0; j < 6; j++)
+        b.product[j] = product[j];
+}
+#endif
+
+// Merge the moments of the block b (following a) into a
+static void merge_moments(BlockMoments & a, const BlockMoments & b)
+{
+    for (int k = 0; k < extreme_directions; k++) {
+        if (b.low[k] < a.low[k])
+            a.low[k] = b.low[k], a.lowest[k] = b.lowest[k];
+        if (b.high[k] > a.high[k])
+            a.high[k] = b.high[k], a.highest[k] = b.highest[k];
+    }
+
+    for (int j = 0; j < 3; j++)
+        a.sum[j] += b.sum[j];
+    for (int j = 0; j < 6; j++)
+        a.product[j] += b.product[j];
+}
+
+// Eigenvectors of a symmetric matrix a as columns of e, by cyclic Jacobi
+// rotations (a is diagonalised)
+static void eigenvectors(double a[3][3], double e[3][3])
+{
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            e[i][j] = i == j;
+
+    const int pairs[3][2] = { { 0, 1 }, { 0, 2 }, { 1, 2 } };
+
+    for (int sweep = 0; sweep < 32; sweep++) {
+        double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] +
+            a[1][2] * a[1][2];
+        double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] +
+            a[2][2] * a[2][2];
+
+        if (off <= 1e-24 * diagonal)
+            break;
+
+        for (int r = 0; r < 3; r++) {
+            int p = pairs[r][0], q = pairs[r][1];
+
+            if (a[p][q] == 0)
+                continue;
+
+            // Rotation zeroing a[p][q]: tangent of its angle is the smaller
+            // root of t^2 + 2 theta t - 1
+            double theta = (a[q][q] - a[p][p]) / (2 * a[p][q]);
+            double t = (theta >= 0 ? 1 : -1) /
+                (fabs(theta) + sqrt(theta * theta + 1));
+            double c = 1 / sqrt(t * t + 1), s = t * c;
+
+            for (int k = 0; k < 3; k++) {
+                double kp = a[k][p], kq = a[k][q];
+                a[k][p] = c * kp - s * kq;
+                a[k][q] = s * kp + c * kq;
+            }
+
+            for (int k = 0; k < 3; k++) {
+                double pk = a[p][k], qk = a[q][k];
+                a[p][k] = c * pk - s * qk;
+                a[q][k] = s * pk + c * qk;
+            }
+
+            for (int k = 0; k < 3; k++) {
+                double kp = e[k][p], kq = e[k][q];
+                e[k][p] = c * kp - s * kq;
+                e[k][q] = s * kp + c * kq;
+            }
+        }
+    }
+}
+
+// Sphere in double precision, grown by Ritter's method
+struct RitterSphere {
+    double center[3], radius;
+
+    // Move towards a point outside just enough to enclose it
+    void grow(const vec3 & p)
+    {
+        double d[3] = { p.x - center[0], p.y - center[1], p.z - center[2] };
+        double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+        if (d2 <= radius * radius)
+            return;
+
+        double distance = sqrt(d2);
+        double r = (radius + distance) / 2;
+
+        for (int j = 0; j < 3; j++)
+            center[j] += d[j] * (r - radius) / distance;
+
+        radius = r;
+    }
+
+    // Smallest sphere enclosing both spheres
+    void merge(const RitterSphere & s)
+    {
+        double d[3];
+        for (int j = 0; j < 3; j++)
+            d[j] = s.center[j] - center[j];
+
+        double distance = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+        if (distance + s.radius <= radius)
+            return;
+
+        if (distance + radius <= s.radius) {
+            *this = s;
+            return;
+        }
+
+        double r = (distance + radius + s.radius) / 2;
+
+        for (int j = 0; j < 3; j++)
+            center[j] += d[j] * (r - radius) / distance;
+
+        radius = r;
+    }
+};
+
+// Extents of a block along the axes of the oriented box and the sphere grown
+// over its points
+struct BlockExtents {
+    GLfloat low[3], high[3];
+    RitterSphere sphere;
+};
+
+static void merge_extents(BlockExtents & a, const BlockExtents & b)
+{
+    for (int j = 0; j < 3; j++) {
+        a.low[j] = b.low[j] < a.low[j] ? b.low[j] : a.low[j];
+        a.high[j] = b.high[j] > a.high[j] ? b.high[j] : a.high[j];
+    }
+
+    a.sphere.merge(b.sphere);
+}
+
+// Boxes are compared by volume, flat ones by area
+static bool smaller_box(const double a[3], const double b[3])
+{
+    double va = a[0] * a[1] * a[2], vb = b[0] * b[1] * b[2];
+
+    if (va != vb)
+        return va < vb;
+
+    return a[0] * a[1] + a[1] * a[2] + a[2] * a[0] <
+        b[0] * b[1] + b[1] * b[2] + b[2] * b[0];
+}
+
+MeshBounds mesh_bounds(const vec3 *v, int n)
+{
+    MeshBounds bounds;
+    PointBounds & points = bounds.points;
+    OrientedBox & box = bounds.box;
+    BoundingSphere & sphere = bounds.sphere;
+
+    box.axis[0] = vec3(1, 0, 0);
+    box.axis[1] = vec3(0, 1, 0);
+    box.axis[2] = vec3(0, 0, 1);
+
+    if (n <= 0) {
+        points.min = points.max = points.centroid = vec3(0);
+        box.center = box.half = sphere.center = vec3(0);
+        sphere.radius = 0;
+        return bounds;
+    }
+
+    // First pass: box, centroid, covariance and extreme points
+    vector<BlockMoments> moments;
+    reduce_pairwise(n, moments,
+        [v](int begin, int end, BlockMoments & b) {
+            block_moments(v, begin, end, b);
+        }, merge_moments);
+
+    const BlockMoments & all = moments[0];
+    double mean[3];
+
+    for (int j = 0; j < 3; j++) {
+        points.min[j] = all.low[j];
+        points.max[j] = all.high[j];
+        mean[j] = all.sum[j] / n;
+        points.centroid[j] = mean[j];
+    }
+
+    double covariance[3][3], e[3][3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            covariance[i][j] = all.product[product_index[i][j]] / n -
+                mean[i] * mean[j];
+
+    eigenvectors(covariance, e);
+
+    // Principal axes, the third one makes them right-handed
+    GLfloat axis[3][3];
+    for (int k = 0; k < 2; k++)
+        for (int j = 0; j < 3; j++)
+            axis[k][j] = e[j][k];
+
+    axis[2][0] = e[1][0] * e[2][1] - e[2][0] * e[1][1];
+    axis[2][1] = e[2][0] * e[0][1] - e[0][0] * e[2][1];
+    axis[2][2] = e[0][0] * e[1][1] - e[1][0] * e[0][1];
+
+    // Sphere through the farthest pair of extreme points
+    RitterSphere start;
+    double farthest = -1;
+
+    for (int k = 0; k < extreme_directions; k++) {
+        const vec3 & a = v[all.lowest[k]], & b = v[all.highest[k]];
+        double d[3] = { b.x - (double) a.x, b.y - (double) a.y,
+            b.z - (double) a.z };
+        double d2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+        if (d2 > farthest) {
+            farthest = d2;
+            start.center[0] = (a.x + (double) b.x) / 2;
+            start.center[1] = (a.y + (double) b.y) / 2;
+            start.center[2] = (a.z + (double) b.z) / 2;
+            start.radius = sqrt(d2) / 2;
+        }
+    }
+
+    // Second pass: extents along the principal axes and the sphere
+    vector<BlockExtents> extents;
+    reduce_pairwise(n, extents,
+        [&](int begin, int end, BlockExtents & b) {
+            for (int k = 0; k < 3; k++)
+                b.low[k] = b.high[k] = axis[k][0] * v[begin].x +
+                    axis[k][1] * v[begin].y + axis[k][2] * v[begin].z;
+
+            b.sphere = start;
+
+            for (int i = begin; i < end; i++) {
+                const vec3 & p = v[i];
+
+                for (int k = 0; k < 3; k++) {
+                    GLfloat d = axis[k][0] * p.x + axis[k][1] * p.y +
+                        axis[k][2] * p.z;
+
+                    b.low[k] = d < b.low[k] ? d : b.low[k];
+                    b.high[k] = d > b.high[k] ? d : b.high[k];
+                }
+
+                b.sphere.grow(p);
+            }
+        }, merge_extents);
+
+    const BlockExtents & measured = extents[0];
+    double principal[3], aligned[3];
+
+    for (int k = 0; k < 3; k++) {
+        principal[k] = (double) measured.high[k] - measured.low[k];
+        aligned[k] = (double) points.max[k] - points.min[k];
+    }
+
+    if (smaller_box(principal, aligned)) {
+        double center[3] = { 0, 0, 0 };
+
+        for (int k = 0; k < 3; k++) {
+            double middle = ((double) measured.low[k] + measured.high[k]) / 2;
+
+            for (int j = 0; j < 3; j++)
+                center[j] += axis[k][j] * middle;
+
+            box.axis[k] = vec3(axis[k][0], axis[k][1], axis[k][2]);
+            box.half[k] = principal[k] / 2;
+        }
+
+        box.center = vec3(center[0], center[1], center[2]);
+    } else {
+        box.center = (points.min + points.max) / 2;
+        box.half = (points.max - points.min) / 2;
+    }
+
+    // Rounding to floats may leave points just outside, the radius is
+    // enlarged by a few ulps of the coordinates
+    const RitterSphere & s = measured.sphere;
+    double scale = fabs(s.center[0]) + fabs(s.center[1]) + fabs(s.center[2]) +
+        s.radius;
+
+    sphere.center = vec3(s.center[0], s.center[1], s.center[2]);
+    sphere.radius = s.radius + 4 * FLT_EPSILON * scale;
+
+    return bounds;
+}
@@ -0,0 +1,57 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+#include "mat.hpp"
+
+// Bounding box and centroid of points, all zero for no points
+struct PointBounds {
+    vec3 min, max;
+    vec3 centroid;
+};
+
+// Bounds of an array of points (AoS), of points given by arrays of their
+// coordinates (SoA) and of points transformed by t (world coordinates of a
+// mesh). Blocks of points are reduced in parallel with SIMD minimum and
+// maximum where available; coordinates are summed in double per block and
+// the blocks pairwise, so the result doesn't depend on the number of threads
+PointBounds point_bounds(const vec3 *v, int n);
+PointBounds point_bounds(const GLfloat *x, const GLfloat *y, const GLfloat *z,
+    int n);
+PointBounds point_bounds(const vec3 *v, int n, const mat4 & t);
+
+// Box along its own axes (orthonormal, right-handed): points center + a *
+// axis[0] + b * axis[1] + c * axis[2] with |a| <= half.x, |b| <= half.y and
+// |c| <= half.z
+struct OrientedBox {
+    vec3 center;
+    vec3 axis[3];
+    vec3 half;
+};
+
+struct BoundingSphere {
+    vec3 center;
+    GLfloat radius;
+};
+
+// Bounds of the vertices of a mesh
+struct MeshBounds {
+    PointBounds points;
+    OrientedBox box;
+    BoundingSphere sphere;
+};
+
+// Box, centroid, oriented box and sphere of points in two passes over them,
+// blocks of points are reduced in parallel. The first pass sums coordinates
+// and their products and finds the extreme points along the axes and the
+// four diagonals (the box comes from the ones along the axes). The oriented
+// box is along the principal axes of the points (eigenvectors of their
+// covariance), or along the coordinate axes if that box is smaller; the
+// sphere is Ritter's, started from the farthest pair of extreme points. The
+// second pass measures the points along the axes and grows a sphere over
+// every block, the spheres of the blocks are merged. Results don't depend on
+// the number of threads
+MeshBounds mesh_bounds(const vec3 *v, int n);
+
+#endif
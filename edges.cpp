@@ -0,0 +1,201 @@
+#include "edges.hpp"
+#include "normals.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <vector>
+
+// Sorted pair of indices
+typedef unsigned long long EdgeKey;
+
+static inline EdgeKey edge_key(GLuint a, GLuint b)
+{
+    return a < b ? (EdgeKey) a << 32 | b : (EdgeKey) b << 32 | a;
+}
+
+// No edge has equal vertices
+const EdgeKey empty_key = 0;
+
+// Fibonacci hashing, high bits are the best mixed
+static inline EdgeKey edge_hash(EdgeKey key)
+{
+    return key * 0x9E3779B97F4A7C15ull;
+}
+
+// Edge of a face waiting for deduplication, corner is its first corner
+struct FaceEdge {
+    EdgeKey key;
+    int face, corner;
+};
+
+int mesh_edges(const GLuint *f, int f_number, Edge *&edges)
+{
+    return polygon_edges(f, 0, 3, f_number, edges, 0);
+}
+
+int polygon_edges(const GLuint *f, const int *offset, int sides,
+    int f_number, Edge *&edges, int *corner_edge)
+{
+    int threads = parallel_threads(f_number);
+
+    // bucket[t * threads + b]: edges of the t-th range of faces falling into
+    // the b-th bucket, every bucket is written by one thread only
+    std::vector< std::vector<FaceEdge> > bucket(threads * threads);
+
+    parallel_for(f_number, [&](int begin, int end, int t) {
+        for (int b = 0; b < threads; b++)
+            bucket[t * threads + b].reserve(3 * (end - begin) / threads + 16);
+
+        for (int i = begin; i < end; i++) {
+            int first = offset != 0 ? offset[i] : sides * i;
+            int n = offset != 0 ? offset[i + 1] - first : sides;
+
+            for (int k = 0; k < n; k++) {
+                GLuint a = f[first + k], b = f[first + (k + 1) % n];
+
+                // Degenerate faces
+                if (a == b) {
+                    if (corner_edge != 0)
+                        corner_edge[first + k] = -1;
+                    continue;
+                }
+
+                FaceEdge e;
+                e.key = edge_key(a, b);
+                e.face = i;
+                e.corner = first + k;
+
+                bucket[t * threads + (edge_hash(e.key) >> 32) % threads].
+                    push_back(e);
+            }
+        }
+    });
+
+    std::vector< std::vector<Edge> > merged(threads);
+
+    parallel_for(threads, [&](int begin, int end, int) {
+        for (int b = begin; b < end; b++) {
+            size_t count = 0;
+            for (int t = 0; t < threads; t++)
+                count += bucket[t * threads + b].size();
+
+            // Open addressing table of keys and their positions in
+            // merged[b], every edge is shared by two faces mostly, so the
+            // table ends up at most about half full
+            int bits = 4;
+            while (((size_t) 1 << bits) < count)
+                bits++;
+
+            size_t mask = ((size_t) 1 << bits) - 1;
+            std::vector<EdgeKey> keys(mask + 1, empty_key);
+            std::vector<int> position(mask + 1);
+
+            std::vector<Edge> & out = merged[b];
+            out.reserve(count / 2 + 1);
+
+            for (int t = 0; t < threads; t++) {
+                const std::vector<FaceEdge> & in = bucket[t * threads + b];
+
+                for (size_t j = 0; j < in.size(); j++) {
+                    EdgeKey key = in[j].key;
+                    size_t slot = edge_hash(key) >> (64 - bits);
+
+                    while (keys[slot] != empty_key && keys[slot] != key)
+                        slot = (slot + 1) & mask;
+
+                    if (keys[slot] == empty_key) {
+                        Edge e;
+                        e.a = key >> 32, e.b = key & 0xffffffff;
+                        e.face[0] = in[j].face, e.face[1] = -1;
+
+                        keys[slot] = key;
+                        position[slot] = out.size();
+                        out.push_back(e);
+                    } else {
+                        Edge & e = out[position[slot]];
+                        e.face[1] = e.face[1] == -1 ? in[j].face : -2;
+                    }
+
+                    // Position in merged[b] for now, made global below
+                    if (corner_edge != 0)
+                        corner_edge[in[j].corner] = position[slot];
+                }
+            }
+        }
+    });
+
+    // Edges of the b-th bucket start at first[b]
+    std::vector<int> first(threads + 1, 0);
+    for (int b = 0; b < threads; b++)
+        first[b + 1] = first[b] + merged[b].size();
+
+    int e_number = first[threads];
+
+    if (corner_edge != 0)
+        parallel_for(threads, [&](int begin, int end, int) {
+            for (int b = begin; b < end; b++)
+                for (int t = 0; t < threads; t++) {
+                    const std::vector<FaceEdge> & in = bucket[t * threads + b];
+
+                    for (size_t j = 0; j < in.size(); j++)
+                        corner_edge[in[j].corner] += first[b];
+                }
+        });
+
+    edges = new Edge[e_number];
+
+    for (int b = 0, n = 0; b < threads; b++)
+        for (size_t j = 0; j < merged[b].size(); j++)
+            edges[n++] = merged[b][j];
+
+    return e_number;
+}
+
+int wireframe_lines(const vec3 *v, const GLuint *f, int f_number,
+    GLfloat feature_angle, GLuint *&lines, int & features)
+{
+    Edge *edges;
+    int e_number = mesh_edges(f, f_number, edges);
+
+    wireframe_lines(v, f, f_number, edges, e_number, feature_angle, lines,
+        features);
+
+    delete[] edges;
+
+    return e_number;
+}
+
+void wireframe_lines(const vec3 *v, const GLuint *f, int f_number,
+    const Edge *edges, int e_number, GLfloat feature_angle, GLuint *&lines,
+    int & features)
+{
+    vec3 *normal = new vec3[f_number];
+    face_normals(v, f, f_number, normal);
+
+    GLfloat cos_feature = cos(feature_angle * pi / 180);
+
+    auto feature = [&](const Edge & e) {
+        return e.face[1] < 0 ||
+            dot(normal[e.face[0]], normal[e.face[1]]) < cos_feature;
+    };
+
+    features = 0;
+    for (int i = 0; i < e_number; i++)
+        if (feature(edges[i]))
+            features++;
+
+    lines = new GLuint[2 * (e_number + features)];
+
+    for (int i = 0, n = e_number; i < e_number; i++) {
+        lines[2 * i] = edges[i].a;
+        lines[2 * i + 1] = edges[i].b;
+
+        if (feature(edges[i])) {
+            lines[2 * n] = edges[i].a;
+            lines[2 * n + 1] = edges[i].b;
+            n++;
+        }
+    }
+
+    delete[] normal;
+}
@@ -0,0 +1,39 @@
+#ifndef EDGES_HPP
+#define EDGES_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+
+// Edge of a triangle mesh: its vertices (a < b) and faces on its sides,
+// face[1] is -1 for boundary edges and -2 for edges of more than two faces
+struct Edge {
+    GLuint a, b;
+    int face[2];
+};
+
+// Unique edges of faces. Edges of every face range are sorted into buckets by
+// a hash of the sorted pair of indices, then every bucket is deduplicated by a
+// hash table of its own, ranges and buckets are processed in parallel. edges
+// is allocated with new[], returns the number of edges
+int mesh_edges(const GLuint *f, int f_number, Edge *&edges);
+
+// Unique edges of polygons, the same way: corners of face i are f[offset[i]]
+// ... f[offset[i + 1] - 1], or sides corners from f[sides * i] if offset is
+// null. corner_edge (if not null, one per corner) gets the index of the edge
+// from every corner to the next one of its face, -1 for degenerate edges
+int polygon_edges(const GLuint *f, const int *offset, int sides,
+    int f_number, Edge *&edges, int *corner_edge);
+
+// Lines for the wireframe (pairs of indices, allocated with new[]): all the
+// unique edges followed by feature edges, that is boundary and non-manifold
+// edges and edges between faces whose normals differ by more than
+// feature_angle (in degrees); returns the number of unique edges
+int wireframe_lines(const vec3 *v, const GLuint *f, int f_number,
+    GLfloat feature_angle, GLuint *&lines, int & features);
+
+// The same for edges already known (faces of the edges are in f)
+void wireframe_lines(const vec3 *v, const GLuint *f, int f_number,
+    const Edge *edges, int e_number, GLfloat feature_angle, GLuint *&lines,
+    int & features);
+
+#endif
@@ -0,0 +1,95 @@
+// Generator of synthetic .obj files for tests at scale: a scene of objects
+// with about a given number of triangles in total (see synthetic.hpp),
+// written as it's generated (see obj_writer.hpp)
+
+#include "primitives.hpp"
+#include "synthetic.hpp"
+#include "obj_writer.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+int main(int argc, char **argv)
+{
+    long long triangles = 1000000;
+    int objects = 1, shape = -1;
+    unsigned int seed = 1;
+    GLfloat spacing = 3;
+    const char *obj_file = 0;
+
+    // Options: --triangles <n>, --objects <n>, --shape <name>, --seed <n>,
+    // --spacing <d>, the rest is a file
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--triangles") == 0 && i + 1 < argc)
+            triangles = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+            objects = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--shape") == 0 && i + 1 < argc) {
+            i++;
+            for (int j = 0; j < primitive_shapes; j++)
+                if (strcmp(argv[i], primitive_names[j]) == 0)
+                    shape = j;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--spacing") == 0 && i + 1 < argc)
+            spacing = atof(argv[++i]);
+        else
+            obj_file = argv[i];
+
+    if (obj_file == 0 || objects < 1 || triangles < 1) {
+        cerr << "Use: generate [--triangles n] [--objects n] "
+            "[--shape icosphere|uv_sphere|box|cylinder|torus|grid]" << endl;
+        cerr << "     [--seed n] [--spacing d] file.obj" << endl;
+        return EXIT_FAILURE;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    SyntheticObject *scene = new SyntheticObject[objects];
+    synthetic_scene(scene, objects, triangles, shape, seed, spacing);
+
+    ObjWriter writer;
+    if (!writer.open(obj_file))
+        return EXIT_FAILURE;
+
+    writer.comment("generate: " + to_string(objects) + " objects, " +
+        to_string(triangles) + " triangles, seed " + to_string(seed));
+
+    // Objects of the same shape have the same resolution, every shape is
+    // generated once
+    Geometry shapes[primitive_shapes];
+
+    for (int i = 0; i < objects; i++) {
+        const SyntheticObject & o = scene[i];
+        Geometry & g = shapes[(int) o.shape];
+
+        if (g.f == 0)
+            make_primitive(g, o.shape, o.resolution);
+
+        writer.object(string(primitive_names[(int) o.shape]) + "_" +
+            to_string(i));
+        writer.write_vertices(g.v, g.v_number,
+            o.transformation.matrix());
+        writer.write_faces(g.f, g.f_number);
+    }
+
+    delete[] scene;
+
+    if (!writer.close())
+        return EXIT_FAILURE;
+
+    double time = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+
+    cout << obj_file << ": " << objects << " objects, " << writer.vertices() <<
+        " vertices, " << writer.faces() << " triangles, " <<
+        writer.bytes() / 1e6 << " MB in " << time << " ms (" <<
+        writer.bytes() / 1e3 / time << " MB/s)" << endl;
+
+    return EXIT_SUCCESS;
+}
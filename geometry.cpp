@@ -0,0 +1,58 @@
+#include "geometry.hpp"
+
+Geometry::Geometry()
+{
+    v = 0, f = 0, e = 0;
+    v_number = 0, f_number = 0, e_number = 0, fe_number = 0;
+}
+
+Geometry::Geometry(Geometry && g)
+{
+    v = g.v, f = g.f, e = g.e;
+    v_number = g.v_number, f_number = g.f_number;
+    e_number = g.e_number, fe_number = g.fe_number;
+
+    g.v = 0, g.f = 0, g.e = 0;
+    g.v_number = 0, g.f_number = 0, g.e_number = 0, g.fe_number = 0;
+}
+
+Geometry::~Geometry()
+{
+    clear();
+}
+
+Geometry & Geometry::operator = (Geometry && g)
+{
+    if (this == &g)
+        return *this;
+
+    clear();
+
+    v = g.v, f = g.f, e = g.e;
+    v_number = g.v_number, f_number = g.f_number;
+    e_number = g.e_number, fe_number = g.fe_number;
+
+    g.v = 0, g.f = 0, g.e = 0;
+    g.v_number = 0, g.f_number = 0, g.e_number = 0, g.fe_number = 0;
+
+    return *this;
+}
+
+void Geometry::allocate(int vertices, int faces)
+{
+    clear();
+
+    v = new vec3[vertices];
+    f = new GLuint[faces * 3];
+    v_number = vertices, f_number = faces;
+}
+
+void Geometry::clear()
+{
+    delete[] v;
+    delete[] f;
+    delete[] e;
+
+    v = 0, f = 0, e = 0;
+    v_number = 0, f_number = 0, e_number = 0, fe_number = 0;
+}
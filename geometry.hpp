@@ -0,0 +1,36 @@
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+
+// Indexed triangle geometry: array of shared vertices and triplets of indices
+// into it. Owns its arrays, can be moved but not copied
+struct Geometry {
+
+    vec3 *v;            // Vertices
+    GLuint *f;          // Faces, the size of f is 3 * f_number
+    int v_number, f_number;
+
+    // Wireframe lines (pairs of indices, may be null): e_number unique edges
+    // followed by fe_number feature edges
+    GLuint *e;
+    int e_number, fe_number;
+
+    Geometry();
+    Geometry(Geometry && g);
+    ~Geometry();
+
+    Geometry & operator = (Geometry && g);
+
+    Geometry(const Geometry &) = delete;
+    Geometry & operator = (const Geometry &) = delete;
+
+    // Allocate (uninitialised) arrays, previous data is released
+    void allocate(int vertices, int faces);
+
+    // Release arrays (wireframe lines included)
+    void clear();
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include "gl_stub.hpp"
+
+GLStubCounters gl_stub = { 0, 0, 0 };
+
+// Last buffer and vertex array name given
+static GLuint last_name = 0;
+
+void glGenBuffers(GLsizei n, GLuint *buffers)
+{
+    gl_stub.state_calls++;
+    for (GLsizei i = 0; i < n; i++)
+        buffers[i] = ++last_name;
+}
+
+void glGenVertexArrays(GLsizei n, GLuint *arrays)
+{
+    gl_stub.state_calls++;
+    for (GLsizei i = 0; i < n; i++)
+        arrays[i] = ++last_name;
+}
+
+void glBufferData(GLenum, GLsizeiptr size, const void *, GLenum)
+{
+    gl_stub.state_calls++;
+    gl_stub.buffer_bytes += size;
+}
+
+void glBufferSubData(GLenum, GLintptr, GLsizeiptr size, const void *)
+{
+    gl_stub.state_calls++;
+    gl_stub.buffer_bytes += size;
+}
+
+void glDrawArrays(GLenum, GLint, GLsizei)
+{
+    gl_stub.draw_calls++;
+}
+
+void glDrawArraysInstanced(GLenum, GLint, GLsizei, GLsizei)
+{
+    gl_stub.draw_calls++;
+}
+
+void glDrawElements(GLenum, GLsizei, GLenum, const GLvoid *)
+{
+    gl_stub.draw_calls++;
+}
+
+void glBindBuffer(GLenum, GLuint) { gl_stub.state_calls++; }
+void glBindVertexArray(GLuint) { gl_stub.state_calls++; }
+void glDeleteBuffers(GLsizei, const GLuint *) { gl_stub.state_calls++; }
+void glDeleteVertexArrays(GLsizei, const GLuint *) { gl_stub.state_calls++; }
+void glEnableVertexAttribArray(GLuint) { gl_stub.state_calls++; }
+void glDisableVertexAttribArray(GLuint) { gl_stub.state_calls++; }
+void glVertexAttribDivisor(GLuint, GLuint) { gl_stub.state_calls++; }
+void glPointSize(GLfloat) { gl_stub.state_calls++; }
+void glPolygonMode(GLenum, GLenum) { gl_stub.state_calls++; }
+void glUniform1f(GLint, GLfloat) { gl_stub.state_calls++; }
+void glUniform3f(GLint, GLfloat, GLfloat, GLfloat) { gl_stub.state_calls++; }
+
+void glUniform3fv(GLint, GLsizei, const GLfloat *)
+{
+    gl_stub.state_calls++;
+}
+
+void glUniform4fv(GLint, GLsizei, const GLfloat *)
+{
+    gl_stub.state_calls++;
+}
+
+void glUniformMatrix4fv(GLint, GLsizei, GLboolean, const GLfloat *)
+{
+    gl_stub.state_calls++;
+}
+
+void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei,
+    const void *)
+{
+    gl_stub.state_calls++;
+}
@@ -0,0 +1,18 @@
+#ifndef GL_STUB_HPP
+#define GL_STUB_HPP
+
+#include "graphics_root.hpp"
+
+// Headless replacement of the GL functions used by meshes and scenes: calls
+// do nothing but count, buffers get fresh names. Linked instead of the GL
+// library by the benchmarks, so that draw submission is measured without a
+// context or a driver
+struct GLStubCounters {
+    long long draw_calls;       // glDrawArrays*, glDrawElements
+    long long state_calls;      // Everything else
+    long long buffer_bytes;     // Uploaded by glBufferData, glBufferSubData
+};
+
+extern GLStubCounters gl_stub;
+
+#endif
@@ -0,0 +1,139 @@
+#include "halfedge.hpp"
+#include "edges.hpp"
+#include "parallel.hpp"
+
+#include <vector>
+
+HalfEdges::HalfEdges(const GLuint *f, int f_number, int v_number)
+{
+    f_ = f;
+    f_number_ = f_number;
+    v_number_ = v_number;
+
+    twin_ = new int[f_number * 3];
+    outgoing_ = new int[v_number];
+
+    for (int h = 0; h < f_number * 3; h++)
+        twin_[h] = -1;
+
+    Edge *edges;
+    int e_number = mesh_edges(f, f_number, edges);
+
+    // Half-edge of a face between two vertices
+    auto find = [&](int face, GLuint a, GLuint b) {
+        for (int h = 3 * face; h < 3 * face + 3; h++)
+            if ((f[h] == a && f[next(h)] == b) ||
+                (f[h] == b && f[next(h)] == a))
+                return h;
+
+        return -1;
+    };
+
+    // Every edge sets twins of its own half-edges, so edges can be processed
+    // in parallel; counters are kept by every thread
+    int threads = parallel_threads(e_number);
+    std::vector<int> counter(threads * 3, 0);
+
+    parallel_for(e_number, [&](int begin, int end, int t) {
+        for (int i = begin; i < end; i++) {
+            const Edge & e = edges[i];
+
+            if (e.face[1] == -1)
+                counter[3 * t]++;
+            else if (e.face[1] == -2)
+                counter[3 * t + 1]++;
+            else {
+                int h0 = find(e.face[0], e.a, e.b);
+                int h1 = find(e.face[1], e.a, e.b);
+
+                // Both faces go along the edge in the same direction
+                if (f[h0] == f[h1])
+                    counter[3 * t + 2]++;
+                else
+                    twin_[h0] = h1, twin_[h1] = h0;
+            }
+        }
+    });
+
+    delete[] edges;
+
+    boundary_edges_ = non_manifold_edges_ = inconsistent_edges_ = 0;
+
+    for (int t = 0; t < threads; t++) {
+        boundary_edges_ += counter[3 * t];
+        non_manifold_edges_ += counter[3 * t + 1];
+        inconsistent_edges_ += counter[3 * t + 2];
+    }
+
+    // Boundary half-edges are preferred, rotating from them covers the whole
+    // fan of a vertex
+    int *valence = new int[v_number];
+
+    for (int i = 0; i < v_number; i++)
+        outgoing_[i] = -1, valence[i] = 0;
+
+    for (int h = 0; h < f_number * 3; h++) {
+        valence[f[h]]++;
+
+        if (outgoing_[f[h]] == -1 || twin_[h] == -1)
+            outgoing_[f[h]] = h;
+    }
+
+    // Vertices whose fans don't cover all of their faces
+    threads = parallel_threads(v_number);
+    counter.assign(threads, 0);
+
+    parallel_for(v_number, [&](int begin, int end, int t) {
+        for (int i = begin; i < end; i++) {
+            if (outgoing_[i] == -1)
+                continue;
+
+            int n = 0, h = outgoing_[i];
+
+            do {
+                n++;
+                h = rotate(h);
+            } while (h != -1 && h != outgoing_[i] && n <= valence[i]);
+
+            if (n != valence[i])
+                counter[t]++;
+        }
+    });
+
+    non_manifold_vertices_ = 0;
+    for (int t = 0; t < threads; t++)
+        non_manifold_vertices_ += counter[t];
+
+    delete[] valence;
+}
+
+HalfEdges::~HalfEdges()
+{
+    delete[] twin_;
+    delete[] outgoing_;
+}
+
+int HalfEdges::boundary_edges() const
+{
+    return boundary_edges_;
+}
+
+int HalfEdges::non_manifold_edges() const
+{
+    return non_manifold_edges_;
+}
+
+int HalfEdges::inconsistent_edges() const
+{
+    return inconsistent_edges_;
+}
+
+int HalfEdges::non_manifold_vertices() const
+{
+    return non_manifold_vertices_;
+}
+
+size_t HalfEdges::bytes() const
+{
+    return ((size_t) f_number_ * 3 + v_number_) * sizeof(int);
+}
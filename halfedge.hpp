@@ -0,0 +1,67 @@
+#ifndef HALFEDGE_HPP
+#define HALFEDGE_HPP
+
+#include <cstddef>
+
+#include "graphics_root.hpp"
+
+// Half-edge connectivity of a triangle mesh in flat arrays. Half-edge h is the
+// edge of face h / 3 going from its vertex f[h] to the next one, so next,
+// previous, face and origin are implicit and only twins and one outgoing
+// half-edge per vertex are stored. Twins are matched through unique edges
+// (see edges.hpp), edges that can't have twins (shared by more than two
+// faces, or by two faces of opposite orientation) are counted and left
+// unmatched like boundaries
+class HalfEdges {
+
+    const GLuint *f_;
+    int f_number_, v_number_;
+
+    // Twin of every half-edge, -1 if there is none
+    int *twin_;
+
+    // Outgoing half-edge of every vertex, a boundary one for boundary
+    // vertices, -1 for unused vertices
+    int *outgoing_;
+
+    int boundary_edges_, non_manifold_edges_, inconsistent_edges_;
+    int non_manifold_vertices_;
+
+public:
+
+    // Faces are referenced, not copied
+    HalfEdges(const GLuint *f, int f_number, int v_number);
+    ~HalfEdges();
+
+    HalfEdges(const HalfEdges &) = delete;
+    HalfEdges & operator = (const HalfEdges &) = delete;
+
+    int next(int h) const { return h - h % 3 + (h + 1) % 3; }
+    int prev(int h) const { return h - h % 3 + (h + 2) % 3; }
+    int face(int h) const { return h / 3; }
+
+    GLuint origin(int h) const { return f_[h]; }
+    GLuint target(int h) const { return f_[next(h)]; }
+
+    int twin(int h) const { return twin_[h]; }
+    int outgoing(GLuint v) const { return outgoing_[v]; }
+
+    // Next outgoing half-edge around the origin of h, -1 on boundary. Starting
+    // from outgoing(v) visits all the faces of a manifold vertex v
+    int rotate(int h) const { return twin_[prev(h)]; }
+
+    int half_edges() const { return f_number_ * 3; }
+
+    // Edges with a single face, edges that couldn't be matched (shared by
+    // more than two faces, or by faces of opposite orientation) and vertices
+    // whose faces don't form a single fan
+    int boundary_edges() const;
+    int non_manifold_edges() const;
+    int inconsistent_edges() const;
+    int non_manifold_vertices() const;
+
+    // Size of the structure (faces not included)
+    size_t bytes() const;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include "jobs.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+
+using namespace std;
+
+// Queue of a fixed size, so queueing never allocates: a ring buffer guarded
+// by a mutex. The owner takes jobs from the back, thieves from the front
+class JobQueue {
+
+    static const int capacity = 1024;
+
+    mutex mutex_;
+    Job *jobs_[capacity];
+    int first_, size_;
+
+public:
+
+    JobQueue() : first_(0), size_(0) {}
+
+    // Returns false if the queue is full
+    bool push(Job *job)
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        if (size_ == capacity)
+            return false;
+
+        jobs_[(first_ + size_++) % capacity] = job;
+        return true;
+    }
+
+    Job * pop_back()
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        return size_ > 0 ? jobs_[(first_ + --size_) % capacity] : 0;
+    }
+
+    // Oldest job, or the oldest bounded one
+    Job * pop_front(bool bounded)
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        int k = 0;
+
+        while (bounded && k < size_ &&
+            !jobs_[(first_ + k) % capacity] -> bounded())
+            k++;
+
+        if (k == size_)
+            return 0;
+
+        Job *job = jobs_[(first_ + k) % capacity];
+
+        // Older jobs move one place up
+        for (; k > 0; k--)
+            jobs_[(first_ + k) % capacity] =
+                jobs_[(first_ + k - 1) % capacity];
+
+        first_ = (first_ + 1) % capacity;
+        size_--;
+
+        return job;
+    }
+};
+
+// Queues of threads that aren't workers: they take one on their first use
+// of the pool and give it back when they end. The last one is shared by the
+// threads that find all of them taken
+const int external_queues = 32;
+
+static atomic<bool> external_taken[external_queues - 1];
+
+struct ExternalQueue {
+    int index;
+
+    ExternalQueue()
+    {
+        index = external_queues - 1;
+
+        for (int i = 0; i < external_queues - 1; i++)
+            if (!external_taken[i].exchange(true)) {
+                index = i;
+                break;
+            }
+    }
+
+    ~ExternalQueue()
+    {
+        if (index < external_queues - 1)
+            external_taken[index] = false;
+    }
+};
+
+// Workers and their queues, followed by the queues of the other threads
+class JobPool {
+
+    vector<JobQueue *> queues_;
+    vector<thread> workers_;
+
+    // Idle workers sleep until a job is queued, queued_ is increased under
+    // the mutex so that they don't miss it
+    mutex sleep_mutex_;
+    condition_variable wake_;
+    atomic<int> queued_;
+    bool stop_;
+
+    void work(int index);
+
+    // Queue of the calling thread
+    int own_queue() const;
+
+public:
+
+    JobPool();
+
+    // Start workers for n threads in total (one per core for 0), and stop
+    // them
+    void start(int n);
+    void stop();
+
+    int threads() const;
+
+    // Queue a job on the queue of the calling thread, or run it if it's full
+    void push(Job *job);
+
+    // Job of the queue of the calling thread, or stolen from another one
+    // (only a bounded one by threads that aren't workers, unless there are
+    // no workers); null if there are none
+    Job * take();
+
+    // Run jobs on the calling thread until there are none or the time is
+    // up, returns their number
+    int help(double ms);
+};
+
+// Position of the queue of a worker, -1 for other threads
+static thread_local int worker_index = -1;
+
+int JobPool::own_queue() const
+{
+    if (worker_index >= 0)
+        return worker_index;
+
+    static thread_local ExternalQueue external;
+
+    return workers_.size() + external.index;
+}
+
+// The pool is never destroyed: meshes destroyed at exit may still wait for
+// jobs
+static JobPool & pool()
+{
+    static JobPool *instance = new JobPool;
+    return *instance;
+}
+
+JobPool::JobPool() : queued_(0), stop_(false)
+{
+    start(0);
+}
+
+void JobPool::start(int n)
+{
+    if (n < 1)
+        n = thread::hardware_concurrency();
+    if (n < 1)
+        n = 1;
+
+    for (int i = 0; i < n - 1 + external_queues; i++)
+        queues_.push_back(new JobQueue);
+
+    stop_ = false;
+
+    for (int i = 0; i < n - 1; i++)
+        workers_.push_back(thread(&JobPool::work, this, i));
+}
+
+void JobPool::stop()
+{
+    {
+        lock_guard<mutex> lock(sleep_mutex_);
+        stop_ = true;
+    }
+
+    wake_.notify_all();
+
+    for (unsigned int i = 0; i < workers_.size(); i++)
+        workers_[i].join();
+
+    for (unsigned int i = 0; i < queues_.size(); i++)
+        delete queues_[i];
+
+    workers_.clear();
+    queues_.clear();
+}
+
+int JobPool::threads() const
+{
+    return workers_.size() + 1;
+}
+
+void JobPool::work(int index)
+{
+    worker_index = index;
+
+    while (true) {
+        Job *job = take();
+
+        if (job != 0) {
+            job -> run();
+            continue;
+        }
+
+        unique_lock<mutex> lock(sleep_mutex_);
+
+        if (stop_)
+            break;
+
+        if (queued_ == 0)
+            wake_.wait(lock);
+    }
+}
+
+void JobPool::push(Job *job)
+{
+    if (!queues_[own_queue()] -> push(job)) {
+        job -> run();
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(sleep_mutex_);
+        queued_++;
+    }
+
+    wake_.notify_one();
+}
+
+Job * JobPool::take()
+{
+    int n = queues_.size();
+    int own = own_queue();
+
+    // Newest job of its own queue is the one it has just split off and its
+    // data is in cache, stolen ones are the oldest (the largest) ones. Other
+    // threads take only short jobs of the others, workers run the rest
+    Job *job = queues_[own] -> pop_back();
+    bool bounded = worker_index < 0 && !workers_.empty();
+
+    for (int k = 1; job == 0 && k < n; k++)
+        job = queues_[(own + k) % n] -> pop_front(bounded);
+
+    if (job != 0)
+        queued_--;
+
+    return job;
+}
+
+int JobPool::help(double ms)
+{
+    chrono::steady_clock::time_point end = chrono::steady_clock::now() +
+        chrono::microseconds((long long) (ms * 1000));
+
+    int n = 0;
+
+    while (chrono::steady_clock::now() < end) {
+        Job *job = take();
+
+        if (job == 0)
+            break;
+
+        job -> run();
+        n++;
+    }
+
+    return n;
+}
+
+
+//
+// Job
+//
+
+Job::Job(const function<void()> & function, bool bounded) :
+    function_(function), waiting_(1), done_(false), finished_(false),
+    bounded_(bounded)
+{
+}
+
+void Job::depend_on(Job & job)
+{
+    lock_guard<mutex> lock(job.mutex_);
+
+    if (!job.done_) {
+        waiting_++;
+        job.continuations_.push_back(this);
+    }
+}
+
+void Job::submit()
+{
+    if (--waiting_ == 0)
+        pool().push(this);
+}
+
+void Job::wait()
+{
+    while (!finished_.load(memory_order_acquire)) {
+        Job *job = pool().take();
+
+        if (job != 0)
+            job -> run();
+        else
+            this_thread::yield();
+    }
+}
+
+bool Job::finished() const
+{
+    return finished_.load(memory_order_acquire);
+}
+
+bool Job::bounded() const
+{
+    return bounded_;
+}
+
+void Job::run()
+{
+    function_();
+
+    vector<Job *> continuations;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+        done_ = true;
+        continuations.swap(continuations_);
+    }
+
+    for (unsigned int i = 0; i < continuations.size(); i++)
+        if (--continuations[i] -> waiting_ == 0)
+            pool().push(continuations[i]);
+
+    finished_.store(true, memory_order_release);
+}
+
+
+int job_threads()
+{
+    return pool().threads();
+}
+
+void set_job_threads(int n)
+{
+    pool().stop();
+    pool().start(n);
+}
+
+int help_jobs(double ms)
+{
+    return pool().help(ms);
+}
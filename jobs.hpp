@@ -0,0 +1,84 @@
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+class JobPool;
+
+// Work-stealing job system: a pool of worker threads (one less than cores,
+// the thread that waits for jobs is the last one), each with a queue of
+// jobs. Workers run the newest jobs of their own queue and steal the oldest
+// ones of the others. Threads that aren't workers (GL thread, threads
+// building levels of detail) get a queue of their own too, and steal only
+// bounded jobs of the others. A thread waiting for a job runs queued jobs
+// meanwhile, so jobs may wait for jobs, and GL thread can run them between
+// frames (help_jobs()) without taking a large share of another thread's
+// loop. Jobs may depend on other jobs and are started when those are done
+class Job {
+
+private:
+
+    std::function<void()> function_;
+
+    // Unfinished jobs it depends on, and one more until it's submitted
+    std::atomic<int> waiting_;
+
+    // Jobs depending on it, kept until it's done
+    std::mutex mutex_;
+    std::vector<Job *> continuations_;
+    bool done_;
+
+    // Set after the last access of the job system to it
+    std::atomic<bool> finished_;
+
+    // Short enough to be run by any thread
+    bool bounded_;
+
+    // Run the function and queue the continuations
+    void run();
+
+    friend class JobPool;
+
+public:
+
+    // Job running a function; functions capturing one pointer or reference
+    // don't allocate memory, so jobs on the stack of the thread waiting for
+    // them don't either. Bounded jobs (a few milliseconds at most, like
+    // ranges of grain items of parallel_for()) may be stolen by threads that
+    // aren't workers, the others only by workers
+    explicit Job(const std::function<void()> & function,
+        bool bounded = false);
+
+    Job(const Job &) = delete;
+    Job & operator = (const Job &) = delete;
+
+    // Start the job when another one is done (a continuation of it), called
+    // before submit()
+    void depend_on(Job & job);
+
+    // Queue the job, or wait for the jobs it depends on first. Queues are of
+    // a fixed size, jobs that don't fit are run at once
+    void submit();
+
+    // Wait for a submitted job, running queued jobs meanwhile; it can be
+    // destroyed then
+    void wait();
+    bool finished() const;
+    bool bounded() const;
+};
+
+// Number of threads running jobs: the workers and the waiting thread
+int job_threads();
+
+// Replace the workers to run jobs on n threads in total (one per core for
+// 0), nothing may be queued or running
+void set_job_threads(int n);
+
+// Run queued jobs on the calling thread for up to ms milliseconds (jobs
+// aren't interrupted), returns their number
+int help_jobs(double ms);
+
+#endif
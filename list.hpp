@@ -1,11 +1,15 @@
 #ifndef LIST_HPP
 #define LIST_HPP
 
-// Generic, oredered, doubly linked list
+#include "node_allocator.hpp"
+
+// Generic, oredered, doubly linked list. Nodes come from an allocator
+// (node_allocator.hpp): one heap allocation per node by default, a NodePool
+// or a NodeArena cut them from blocks and release them all at once
 
 using namespace std;
 
-template <class D>
+template <class D, template <class> class Allocator = HeapNodes>
 class List {
 
 private:
@@ -23,6 +27,11 @@ private:
     Node* current_;     // Inner iterator
     unsigned int n_;             // Number of elements
 
+    Allocator<Node> allocator_;
+
+    Node * new_node(const D & x);
+    void delete_node(Node *p);
+
 public:
 
     //
@@ -31,7 +40,13 @@ public:
 
     List();
 
-    // O(n)
+    // Lists own their nodes, they are moved but not copied
+    List(List && list);
+    List(const List &) = delete;
+    List & operator = (const List &) = delete;
+
+    // O(n), O(1) for allocators releasing all nodes and elements without
+    // destructors
     ~List();
 
     //
@@ -59,16 +74,23 @@ public:
     // Removes i-th element
     void remove_by_index(unsigned int i);
 
+    // Remove all elements, O(n); O(1) for allocators releasing all nodes and
+    // elements without destructors
+    void clear();
+
     // ???
     // Check if the list contains an element, O(N)
     bool contains(const D& x);
 
     // Return the i-j-slice of the list (including both ends), O(n)
-    List<D> slice(int i, int j);
+    List slice(int i, int j);
 
     // Length, O(1)
     int length();
 
+    // Size of the nodes in bytes (of the blocks of pools and arenas), O(1)
+    long long bytes();
+
     // Tail, O(1)
     D & tail();
 
@@ -82,7 +104,7 @@ public:
     // Indexing operator, O(N)
     D & operator [] (unsigned int i);
 
-    friend istream & operator >> (istream& in, List<D> & list)
+    friend istream & operator >> (istream& in, List & list)
     {
         D element;
         in >> element;
@@ -90,7 +112,7 @@ public:
         return in;
     }
 
-    friend ostream & operator << (ostream& out, List<D> & list)
+    friend ostream & operator << (ostream& out, List & list)
     {
         out << list.pop();
         return out;
@@ -102,54 +124,93 @@ public:
 // Implementation
 //
 
-template <class D>
-List<D>::List()
+template <class D, template <class> class Allocator>
+List<D, Allocator>::List()
 {
-    root_ = 0, tail_ = 0, n_ = 0;
+    root_ = 0, tail_ = 0, current_ = 0, n_ = 0;
 }
 
-template <class D>
-List<D>::~List()
+template <class D, template <class> class Allocator>
+List<D, Allocator>::List(List && list) :
+    root_(list.root_), tail_(list.tail_), current_(list.current_),
+    n_(list.n_), allocator_(std::move(list.allocator_))
 {
-   Node *p = root_, *prev;
-   while (p) {
-       prev = p, p = p -> next;
-       delete prev;
-   }
+    list.root_ = 0, list.tail_ = 0, list.n_ = 0;
+}
+
+template <class D, template <class> class Allocator>
+List<D, Allocator>::~List()
+{
+    clear();
+}
+
+template <class D, template <class> class Allocator>
+typename List<D, Allocator>::Node *
+List<D, Allocator>::new_node(const D & x)
+{
+    return new (allocator_.allocate()) Node(x);
+}
+
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::delete_node(Node *p)
+{
+    p -> ~Node();
+    allocator_.free(p);
 }
 
-template <class D>
-void List<D>::set_iterator()
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::clear()
+{
+    // Nodes released together only need their elements destroyed
+    if (!Allocator<Node>::release_all ||
+        !is_trivially_destructible<D>::value) {
+        Node *p = root_, *prev;
+        while (p) {
+            prev = p, p = p -> next;
+
+            if (Allocator<Node>::release_all)
+                prev -> ~Node();
+            else
+                delete_node(prev);
+        }
+    }
+
+    allocator_.release();
+    root_ = 0, tail_ = 0, n_ = 0;
+}
+
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::set_iterator()
 {
     current_ = root_;
 }
 
-template <class D>
-bool List<D>::iterator()
+template <class D, template <class> class Allocator>
+bool List<D, Allocator>::iterator()
 {
     return current_ != 0 ? true : false;
 }
 
-template <class D>
-void List<D>::iterate()
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::iterate()
 {
     current_ = current_ -> next;
 }
 
-template <class D>
-D & List<D>::get_iterator()
+template <class D, template <class> class Allocator>
+D & List<D, Allocator>::get_iterator()
 {
     return current_ -> var;
 }
 
-template <class D>
-void List<D>::push(const D & x)
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::push(const D & x)
 {
     if (root_ == 0) {
-        root_ = new Node(x);
+        root_ = new_node(x);
         tail_ = root_;
     } else {
-        tail_ -> next = new Node(x);
+        tail_ -> next = new_node(x);
         tail_ -> next -> prev = tail_;
         tail_ = tail_ -> next;
     }
@@ -157,14 +218,14 @@ void List<D>::push(const D & x)
     n_++;
 }
 
-template <class D>
-void List<D>::push_head(const D & x)
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::push_head(const D & x)
 {
    if (root_ == 0) {
-       root_ = new Node(x);
+       root_ = new_node(x);
        tail_ = root_;
    } else {
-       Node *p = new Node(x);
+       Node *p = new_node(x);
        p -> next = root_;
        root_ -> prev = p;
        root_ = p;
@@ -173,43 +234,43 @@ void List<D>::push_head(const D & x)
    n_++;
 }
 
-template <class D>
-D List<D>::pop()
+template <class D, template <class> class Allocator>
+D List<D, Allocator>::pop()
 {
     if (root_ == 0)
         return 0;
 
     D tmp = tail_ -> var;
     tail_ = tail_ -> prev;
-    delete tail_ -> next;
+    delete_node(tail_ -> next);
     tail_ -> next = 0;
     n_--;
     return tmp;
 }
 
-template <class D>
-D List<D>::pop_head()
+template <class D, template <class> class Allocator>
+D List<D, Allocator>::pop_head()
 {
     if (root_ == 0)
         return 0;
 
     D tmp = root_ -> var;
     if (root_ -> next == 0) {
-        delete root_;
+        delete_node(root_);
         root_ = 0, tail_ = 0;
     } else {
         Node *p = root_;
         root_ = root_ -> next;
         root_ -> prev = 0;
-        delete p;
+        delete_node(p);
     }
 
     n_--;
     return tmp;
 }
 
-template <class D>
-void List<D>::remove_by_index(unsigned int i)
+template <class D, template <class> class Allocator>
+void List<D, Allocator>::remove_by_index(unsigned int i)
 {
     if (i >= n_)
         return;
@@ -222,16 +283,16 @@ void List<D>::remove_by_index(unsigned int i)
 
     if (p == root_ && p != tail_) {
         root_ = root_ -> next;
-        delete root_ -> prev;
+        delete_node(root_ -> prev);
         root_ -> prev = 0;
         return;
     } else if (p == tail_ && p != root_) {
         tail_ = p -> prev;
         p -> prev -> next = 0;
-        delete p;
+        delete_node(p);
         return;
     } else if (p == tail_ && p == root_) {
-        delete root_;
+        delete_node(root_);
         root_ = 0;
         tail_ = 0;
         return;
@@ -239,11 +300,11 @@ void List<D>::remove_by_index(unsigned int i)
 
    p -> prev -> next = p -> next;
    p -> next -> prev = p -> prev;
-   delete p;
+   delete_node(p);
 }
 
-template <class D>
-bool List<D>::contains(const D& x)
+template <class D, template <class> class Allocator>
+bool List<D, Allocator>::contains(const D& x)
 {
     Node *p = root_;
     while (p) {
@@ -256,10 +317,10 @@ bool List<D>::contains(const D& x)
     return false;
 }
 
-template <class D>
-List<D> List<D>::slice(int i, int j)
+template <class D, template <class> class Allocator>
+List<D, Allocator> List<D, Allocator>::slice(int i, int j)
 {
-    List<D> new_list;
+    List new_list;
     Node *p = root_;
 
     // Variable p points to the i-th element
@@ -273,26 +334,32 @@ List<D> List<D>::slice(int i, int j)
     return new_list;
 }
 
-template <class D>
-int List<D>::length()
+template <class D, template <class> class Allocator>
+int List<D, Allocator>::length()
 {
     return n_;
 }
 
-template <class D>
-D & List<D>::tail()
+template <class D, template <class> class Allocator>
+long long List<D, Allocator>::bytes()
+{
+    return allocator_.bytes(n_);
+}
+
+template <class D, template <class> class Allocator>
+D & List<D, Allocator>::tail()
 {
     return tail_ -> var;
 }
 
-template <class D>
-D & List<D>::root()
+template <class D, template <class> class Allocator>
+D & List<D, Allocator>::root()
 {
     return root_ -> var;
 }
 
-template <class D>
-D & List<D>::operator [] (unsigned int i)
+template <class D, template <class> class Allocator>
+D & List<D, Allocator>::operator [] (unsigned int i)
 {
     Node *p = root_;
     for (unsigned int j = 0; j < i; j++)
@@ -0,0 +1,90 @@
+#include "load_stats.hpp"
+
+using namespace std;
+
+const char *load_phase_names[load_phases] = {
+    "read", "parse", "resolve", "bounds", "normals", "optimize", "wireframe",
+    "upload"
+};
+
+LoadStats::LoadStats()
+{
+    files = 0;
+    cached = false;
+    bytes = vertices = normals = polygons = triangles = 0;
+    peak_memory = gpu_bytes = 0;
+
+    for (int i = 0; i < load_phases; i++)
+        time[i] = 0;
+
+    mark_ = chrono::steady_clock::now();
+}
+
+void LoadStats::start()
+{
+    mark_ = chrono::steady_clock::now();
+}
+
+void LoadStats::lap(LoadPhase phase)
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    time[(int) phase] += chrono::duration<double, milli>(now - mark_).count();
+    mark_ = now;
+}
+
+double LoadStats::total_time() const
+{
+    double total = 0;
+
+    for (int i = 0; i < load_phases; i++)
+        total += time[i];
+
+    return total;
+}
+
+LoadStats & LoadStats::operator += (const LoadStats & stats)
+{
+    files += stats.files;
+    cached = cached || stats.cached;
+
+    bytes += stats.bytes;
+    vertices += stats.vertices;
+    normals += stats.normals;
+    polygons += stats.polygons;
+    triangles += stats.triangles;
+
+    for (int i = 0; i < load_phases; i++)
+        time[i] += stats.time[i];
+
+    if (stats.peak_memory > peak_memory)
+        peak_memory = stats.peak_memory;
+
+    gpu_bytes += stats.gpu_bytes;
+
+    return *this;
+}
+
+void LoadStats::print(ostream & out) const
+{
+    double total = total_time();
+    streamsize precision = out.precision(3);
+
+    out << name << ": " << bytes / 1e6 << " MB" << (cached ? " (cache)" : "") <<
+        ", " << vertices << " v, " << normals << " vn, " << polygons <<
+        " f, " << triangles << " triangles;";
+
+    // Phases that weren't run are left out
+    for (int i = 0; i < load_phases; i++)
+        if (time[i] > 0)
+            out << " " << load_phase_names[i] << " " << time[i];
+
+    out << " ms, total " << total << " ms (" << bytes / 1e3 / total <<
+        " MB/s), peak temporary " << peak_memory / 1e6 << " MB";
+
+    if (gpu_bytes > 0)
+        out << ", uploaded " << gpu_bytes / 1e6 << " MB";
+
+    out << endl;
+    out.precision(precision);
+}
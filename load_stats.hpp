@@ -0,0 +1,67 @@
+#ifndef LOAD_STATS_HPP
+#define LOAD_STATS_HPP
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// Phases of loading a mesh: reading the file (or the cache), tokenizing it,
+// resolving indices into arrays, bounding box and pivot, vertex normals,
+// vertex cache optimisation, wireframe lines and upload to the GPU
+enum class LoadPhase {
+    read,
+    parse,
+    resolve,
+    bounds,
+    normals,
+    optimize,
+    wireframe,
+    upload
+};
+
+const int load_phases = 8;
+
+// Names of the phases in the order of LoadPhase
+extern const char *load_phase_names[load_phases];
+
+// Statistics of loading one file, filled by the loaders of Mesh. Statistics
+// of several files can be added up, peak memory is then the largest one
+struct LoadStats {
+
+    std::string name;
+    int files;
+    bool cached;                // Read from the binary cache
+
+    // Bytes read and numbers of records: v, vn and f lines (polygons) and the
+    // triangles they are split into
+    long long bytes;
+    long long vertices, normals, polygons, triangles;
+
+    // Wall time of every phase in milliseconds
+    double time[load_phases];
+
+    // Peak size of temporary data (file contents and lists of records),
+    // estimated from the numbers of elements, and bytes uploaded to the GPU
+    long long peak_memory;
+    long long gpu_bytes;
+
+    LoadStats();
+
+    // Start timing, lap() adds the time since the last start() or lap() to a
+    // phase
+    void start();
+    void lap(LoadPhase phase);
+
+    double total_time() const;
+
+    LoadStats & operator += (const LoadStats & stats);
+
+    // One line: sizes, phases that were run, total time and throughput
+    void print(std::ostream & out) const;
+
+private:
+
+    std::chrono::steady_clock::time_point mark_;
+};
+
+#endif
@@ -1,4 +1,10 @@
 #include "graphics.hpp"
+#include "jobs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 
 using namespace std;
 
@@ -11,6 +17,18 @@ GLuint Camera, Local, Color;
 // Main graphics and geometry handler
 Scene my_scene;
 
+// Input mesh file
+const char *obj_file = 0;
+
+// Generated object, shown when shown_resolution isn't negative
+Primitive shown_primitive = Primitive::icosphere;
+int shown_resolution = -1;
+
+// Synthetic scene of synthetic_objects objects (if there are any) and about
+// synthetic_triangles triangles
+int synthetic_objects = 0;
+long long synthetic_triangles = 0;
+
 void Init(int argc, char **argv)
 {
     // Load shaders and use the resulting shader program
@@ -25,8 +43,19 @@ void Init(int argc, char **argv)
     Color = glGetUniformLocation(program, "color");
 
     my_scene.init(Color, Camera, Local);
-
-    my_scene.add_direct(argv[1], solarized);
+    my_scene.set_dequantization(
+        glGetUniformLocation(program, "position_offset"),
+        glGetUniformLocation(program, "position_scale"),
+        glGetUniformLocation(program, "normal_length"));
+
+    if (obj_file != 0)
+        my_scene.add_direct(obj_file, solarized);
+    if (shown_resolution >= 0)
+        my_scene.add_primitive(shown_primitive, shown_resolution,
+            solarized);
+    if (synthetic_objects > 0)
+        my_scene.add_synthetic(synthetic_objects, synthetic_triangles, 1,
+            solarized);
 
     glEnableVertexAttribArray(loc);
     glVertexAttribPointer(loc, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
@@ -37,15 +66,45 @@ void Init(int argc, char **argv)
 }
 
 
+// Frame timers: the GPU time of a frame is read frame_queries frames later,
+// when it's long done, so that timing doesn't stall the pipeline. The frame
+// takes the longer of its draw submission and its GPU time
+const int frame_queries = 4;
+GLuint frame_query[frame_queries];
+double frame_submission[frame_queries];
+bool frame_timed[frame_queries];
+int frame_slot = 0;
+
 // Default vieport size
 const GLint Width = 600, Height = 600;
 GLsizei CurrentWidth = 960, CurrentHeight = 600;
 
 void display(void)
 {
+    // Changes posted by other threads, uploads aren't counted in frame time
+    my_scene.apply_commands();
+
+    // Report the oldest timed frame before its query is reused
+    if (frame_timed[frame_slot]) {
+        GLuint64 gpu_ns = 0;
+        glGetQueryObjectui64v(frame_query[frame_slot], GL_QUERY_RESULT,
+            &gpu_ns);
+        my_scene.frame_time(max(frame_submission[frame_slot], gpu_ns / 1e6));
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, frame_query[frame_slot]);
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     my_scene.draw();
 //    DrawInterface(Color);
+
+    glEndQuery(GL_TIME_ELAPSED);
+    frame_submission[frame_slot] = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+    frame_timed[frame_slot] = true;
+    frame_slot = (frame_slot + 1) % frame_queries;
+
     glutSwapBuffers();
 }
 
@@ -54,11 +113,35 @@ void reshape(GLsizei w, GLsizei h)
 {
     CurrentWidth = w, CurrentHeight = h;
     glViewport((w - Width) / 2, (h - Height) / 2, Width, Height);
+    my_scene.set_viewport(Width, Height);
 }
 
 bool alt_key;
 bool ctrl_key;
 
+const char *wireframe_names[] = { "polygons", "edges", "features" };
+
+// Cycle wireframe modes: polygons, unique edges, feature edges
+void switch_wireframe()
+{
+    Mesh::wireframe = (Mesh::Wireframe) (((int) Mesh::wireframe + 1) % 3);
+
+    cout << "wireframe: " << wireframe_names[(int) Mesh::wireframe] << endl;
+}
+
+const char *bounding_volume_names[] = { "box", "oriented", "sphere", "all" };
+
+// Cycle bounding volumes drawn with the bounding box: axis aligned box,
+// oriented box, sphere, all of them
+void switch_bounding_volume()
+{
+    Mesh::bounding_volume =
+        (Mesh::BoundingVolume) (((int) Mesh::bounding_volume + 1) % 4);
+
+    cout << "bounding volume: " <<
+        bounding_volume_names[(int) Mesh::bounding_volume] << endl;
+}
+
 void keyboard(unsigned char key, int x, int y)
 {
     if (key == 033) {
@@ -70,10 +153,12 @@ void keyboard(unsigned char key, int x, int y)
 
     if (key == 'v')
         my_scene.toogle_vertex_normals();
-//    if (key == 'f')
-//        my_mesh_1.toogle_face_normals();
+    if (key == 'f')
+        my_scene.toogle_face_normals();
     if (key == 'b')
         my_scene.toogle_bounding_box();
+    if (key == 'B')
+        switch_bounding_volume();
     if (key == '[')
         my_scene.previous_camera();
     if (key == ']')
@@ -86,6 +171,8 @@ void keyboard(unsigned char key, int x, int y)
         my_scene.previous_object();
     if (key == '0')
         my_scene.next_object();
+    if (key == 'x')
+        my_scene.delete_active_object();
     if (key == 'w')
         my_scene.activate_translation();
     if (key == 'r')
@@ -94,6 +181,12 @@ void keyboard(unsigned char key, int x, int y)
         my_scene.activate_rotation();
     if (key == 'p')
         my_scene.switch_projection();
+    if (key == 'l')
+        switch_wireframe();
+    if (key == '+' || key == '=')
+        my_scene.finer_subdivision();
+    if (key == '-')
+        my_scene.coarser_subdivision();
 
     glutPostRedisplay();
 }
@@ -107,6 +200,64 @@ int axis = -1;
 
 int x_prev, y_prev;             // Previous pointer's coordinates
 
+// Time (in milliseconds) of idle input after which proxies used during
+// interaction are refined back to full detail
+int refine_delay = 250;
+
+int last_input = 0;             // Time of the last interaction event
+bool refine_pending = false;    // Refinement timer is running
+
+void refine(int)
+{
+    int idle = glutGet(GLUT_ELAPSED_TIME) - last_input;
+
+    if (idle < refine_delay) {
+        glutTimerFunc(refine_delay - idle, refine, 0);
+        return;
+    }
+
+    refine_pending = false;
+    my_scene.end_interaction();
+    glutPostRedisplay();
+}
+
+// Period (in milliseconds) of memory dumps, none if it's 0
+int memory_dump = 0;
+
+void dump_memory(int)
+{
+    my_scene.memory_report();
+    glutTimerFunc(memory_dump, dump_memory, 0);
+}
+
+// Period (in milliseconds) of checking for changes posted to the scene by
+// other threads, a frame is drawn when there are some. Queued jobs are run
+// meanwhile for a few milliseconds, the GL thread is one of the job threads
+const int command_poll = 50;
+const double job_help = 5;
+
+void poll_commands(int)
+{
+    help_jobs(job_help);
+
+    if (my_scene.commands_pending())
+        glutPostRedisplay();
+
+    glutTimerFunc(command_poll, poll_commands, 0);
+}
+
+// Switch scene to coarse proxies until input is idle
+void interaction()
+{
+    last_input = glutGet(GLUT_ELAPSED_TIME);
+    my_scene.begin_interaction();
+
+    if (!refine_pending) {
+        refine_pending = true;
+        glutTimerFunc(refine_delay, refine, 0);
+    }
+}
+
 void mouse(int button, int state, int x, int y)
 {
     glutGetModifiers() == GLUT_ACTIVE_ALT  ?  alt_key = true :  alt_key = false;
@@ -139,6 +290,12 @@ void mouse_motion(int x, int y)
     x_prev = x;
     y_prev = y;
 
+    // Camera controls and controller drags are drawn with proxies
+    if ((alt_key && (left_button || right_button || middle_button)) ||
+        (ctrl_key && left_button) ||
+        (my_scene.transformation_is_active() && left_button))
+        interaction();
+
     // Spherical rotation
     if (alt_key && left_button)
         my_scene.update_camera_spherical(delta_x, delta_y);
@@ -164,10 +321,69 @@ void mouse_motion(int x, int y)
     glutPostRedisplay();
 }
 
-
 int main(int argc, char **argv)
 {
     glutInit(&argc, argv);
+
+    // Options: --refine-delay <ms>, --frame-budget <ms>, --optimize,
+    // --lod-report, --quantize, --crease <deg>, --wireframe <mode>,
+    // --feature-angle <deg>, --bounding-volume <volume>, --primitive <shape>
+    // <resolution>, --synthetic <objects> <triangles>, --memory-dump <s>, the
+    // rest is a file
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--refine-delay") == 0 && i + 1 < argc)
+            refine_delay = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--memory-dump") == 0 && i + 1 < argc)
+            memory_dump = atof(argv[++i]) * 1000;
+        else if (strcmp(argv[i], "--frame-budget") == 0 && i + 1 < argc)
+            my_scene.set_frame_budget(atof(argv[++i]));
+        else if (strcmp(argv[i], "--optimize") == 0)
+            Mesh::optimize_on_load = true;
+        else if (strcmp(argv[i], "--lod-report") == 0)
+            my_scene.set_lod_report(true);
+        else if (strcmp(argv[i], "--quantize") == 0)
+            Mesh::quantize_vertices = true;
+        else if (strcmp(argv[i], "--crease") == 0 && i + 1 < argc)
+            Mesh::crease_angle = atof(argv[++i]);
+        else if (strcmp(argv[i], "--wireframe") == 0 && i + 1 < argc) {
+            i++;
+            for (int j = 0; j < 3; j++)
+                if (strcmp(argv[i], wireframe_names[j]) == 0)
+                    Mesh::wireframe = (Mesh::Wireframe) j;
+        } else if (strcmp(argv[i], "--bounding-volume") == 0 &&
+            i + 1 < argc) {
+            i++;
+            for (int j = 0; j < 4; j++)
+                if (strcmp(argv[i], bounding_volume_names[j]) == 0)
+                    Mesh::bounding_volume = (Mesh::BoundingVolume) j;
+        } else if (strcmp(argv[i], "--feature-angle") == 0 && i + 1 < argc)
+            Mesh::feature_angle = atof(argv[++i]);
+        else if (strcmp(argv[i], "--primitive") == 0 && i + 2 < argc) {
+            i++;
+            for (int j = 0; j < primitive_shapes; j++)
+                if (strcmp(argv[i], primitive_names[j]) == 0)
+                    shown_primitive = (Primitive) j;
+            shown_resolution = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--synthetic") == 0 && i + 2 < argc) {
+            synthetic_objects = atoi(argv[++i]);
+            synthetic_triangles = atoll(argv[++i]);
+        } else
+            obj_file = argv[i];
+
+    if (obj_file == 0 && shown_resolution < 0 && synthetic_objects < 1) {
+        cerr << "Use: program [--refine-delay ms] [--frame-budget ms] "
+            "[--optimize] [--quantize] [--crease deg]" << endl;
+        cerr << "     [--wireframe polygons|edges|features] "
+            "[--feature-angle deg] [--memory-dump s] [--lod-report]" << endl;
+        cerr << "     [--bounding-volume box|oriented|sphere|all] file.obj" <<
+            endl;
+        cerr << "     program [options] --primitive icosphere|uv_sphere|box|"
+            "cylinder|torus|grid resolution [file.obj]" << endl;
+        cerr << "     program [options] --synthetic objects triangles "
+            "[file.obj]" << endl;
+        cerr << "Files are .obj, binary .stl or binary .ply" << endl;
+        return EXIT_FAILURE;
+    }
     glutInitDisplayMode(GLUT_3_2_CORE_PROFILE | GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
 
     glutInitWindowSize(960, 600);
@@ -187,6 +403,11 @@ int main(int argc, char **argv)
 
     Init(argc, argv);
 
+    if (memory_dump > 0)
+        glutTimerFunc(memory_dump, dump_memory, 0);
+
+    glutTimerFunc(command_poll, poll_commands, 0);
+
     glutMainLoop();
 
     return 0;
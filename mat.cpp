@@ -422,26 +422,68 @@ const vec4 & mat4::operator [] (const unsigned int i) const
 
 mat4 operator * (const mat4 & A, const mat4 & B)
 {
+    // Rows are combinations of the rows of B, elements are accessed directly
+    // (indexing operators of vectors aren't inlined here)
+    const vec4 *b = B.M_;
     mat4 C;
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 4; j++)
-            C[i][j] =
-                A[i][0] * B[0][j] +
-                A[i][1] * B[1][j] +
-                A[i][2] * B[2][j] +
-                A[i][3] * B[3][j];
+
+    for (int i = 0; i < 4; i++) {
+        const vec4 & a = A.M_[i];
+        vec4 & c = C.M_[i];
+
+        c.x = a.x * b[0].x + a.y * b[1].x + a.z * b[2].x + a.w * b[3].x;
+        c.y = a.x * b[0].y + a.y * b[1].y + a.z * b[2].y + a.w * b[3].y;
+        c.z = a.x * b[0].z + a.y * b[1].z + a.z * b[2].z + a.w * b[3].z;
+        c.w = a.x * b[0].w + a.y * b[1].w + a.z * b[2].w + a.w * b[3].w;
+    }
 
     return C;
 }
 
+mat4 affine_inverse(const mat4 & A)
+{
+    // Inverse of the linear part is its adjugate divided by the determinant
+    mat3 L(
+        A[0][0], A[0][1], A[0][2],
+        A[1][0], A[1][1], A[1][2],
+        A[2][0], A[2][1], A[2][2]
+    );
+
+    GLfloat d = det(L);
+
+    mat3 I(
+        L[1][1] * L[2][2] - L[1][2] * L[2][1],
+        L[0][2] * L[2][1] - L[0][1] * L[2][2],
+        L[0][1] * L[1][2] - L[0][2] * L[1][1],
+        L[1][2] * L[2][0] - L[1][0] * L[2][2],
+        L[0][0] * L[2][2] - L[0][2] * L[2][0],
+        L[0][2] * L[1][0] - L[0][0] * L[1][2],
+        L[1][0] * L[2][1] - L[1][1] * L[2][0],
+        L[0][1] * L[2][0] - L[0][0] * L[2][1],
+        L[0][0] * L[1][1] - L[0][1] * L[1][0]
+    );
+    I /= d;
+
+    // Translation is moved back by the inverse
+    vec3 t = -(I * vec3(A[0][3], A[1][3], A[2][3]));
+
+    return mat4(
+        I[0][0], I[0][1], I[0][2], t.x,
+        I[1][0], I[1][1], I[1][2], t.y,
+        I[2][0], I[2][1], I[2][2], t.z,
+        0, 0, 0, 1
+    );
+}
+
 vec4 operator * (const mat4& A, const vec4& v)
 {
-    vec4 u;
-    for (int i = 0; i < 4; i++)
-            u[i] =
-                A[i][0] * v.x + A[i][1] * v.y + A[i][2] * v.z + A[i][3] * v.w;
+    const vec4 *a = A.M_;
 
-    return u;
+    return vec4(
+        a[0].x * v.x + a[0].y * v.y + a[0].z * v.z + a[0].w * v.w,
+        a[1].x * v.x + a[1].y * v.y + a[1].z * v.z + a[1].w * v.w,
+        a[2].x * v.x + a[2].y * v.y + a[2].z * v.z + a[2].w * v.w,
+        a[3].x * v.x + a[3].y * v.y + a[3].z * v.z + a[3].w * v.w);
 }
 
 vec3 operator * (const mat4& A, const vec3& v)
@@ -586,3 +628,147 @@ mat4 Scale(const GLfloat a, const GLfloat b, const GLfloat c)
         0, 0, 0, 1
     );
 }
+
+mat4 Rotate(const quat & q)
+{
+    GLfloat xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    GLfloat xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    GLfloat wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+    return mat4(
+        1 - 2 * (yy + zz),     2 * (xy - wz),     2 * (xz + wy), 0,
+            2 * (xy + wz), 1 - 2 * (xx + zz),     2 * (yz - wx), 0,
+            2 * (xz - wy),     2 * (yz + wx), 1 - 2 * (xx + yy), 0,
+                        0,                 0,                 0, 1
+    );
+}
+
+
+//
+// Transformation by components
+//
+
+Transform::Transform() : translation(0), rotation(), scale(1)
+{
+}
+
+Transform::Transform(const vec3 & t, const quat & r, const vec3 & s) :
+    translation(t), rotation(r), scale(s)
+{
+}
+
+Transform::Transform(const mat4 & A) : translation(A[0][3], A[1][3], A[2][3])
+{
+    // Columns of the linear part are the scaled axes, a reflection is put
+    // into the scale of x
+    vec3 c[3];
+    int zero = 0;
+
+    for (int j = 0; j < 3; j++) {
+        c[j] = vec3(A[0][j], A[1][j], A[2][j]);
+        scale[j] = length(c[j]);
+
+        if (scale[j] > 0)
+            c[j] /= scale[j];
+        else
+            zero++;
+    }
+
+    // Axes scaled to zero have no direction, they are completed to a
+    // rotation by the others
+    if (zero == 1) {
+        int j = scale[0] == 0 ? 0 : scale[1] == 0 ? 1 : 2;
+        vec3 n = c[(j + 1) % 3] * c[(j + 2) % 3];
+
+        if (length(n) > 0)
+            c[j] = normalize(n);
+        else
+            zero = 2;
+    }
+
+    if (zero == 2) {
+        // Another axis square to the longest one and the world axis farthest
+        // from it, the third one square to both
+        int j = scale[0] >= scale[1] && scale[0] >= scale[2] ? 0 :
+            scale[1] >= scale[2] ? 1 : 2;
+        int a = (j + 1) % 3, b = (j + 2) % 3;
+
+        vec3 e(0);
+        GLfloat x = fabs(c[j].x), y = fabs(c[j].y), z = fabs(c[j].z);
+        e[x <= y && x <= z ? 0 : y <= z ? 1 : 2] = 1;
+
+        c[a] = normalize(c[j] * e);
+        c[b] = c[j] * c[a];
+    }
+
+    if (zero == 3) {
+        c[0] = vec3(1, 0, 0);
+        c[1] = vec3(0, 1, 0);
+        c[2] = vec3(0, 0, 1);
+    }
+
+    if (dot(c[0] * c[1], c[2]) < 0) {
+        scale.x = -scale.x;
+        c[0] = -c[0];
+    }
+
+    // Quaternion of the rotation matrix from its largest component
+    GLfloat trace = c[0].x + c[1].y + c[2].z;
+
+    if (trace > 0) {
+        GLfloat s = 2 * sqrt(1 + trace);
+        rotation = quat((c[1].z - c[2].y) / s, (c[2].x - c[0].z) / s,
+            (c[0].y - c[1].x) / s, s / 4);
+    } else if (c[0].x > c[1].y && c[0].x > c[2].z) {
+        GLfloat s = 2 * sqrt(1 + c[0].x - c[1].y - c[2].z);
+        rotation = quat(s / 4, (c[1].x + c[0].y) / s, (c[2].x + c[0].z) / s,
+            (c[1].z - c[2].y) / s);
+    } else if (c[1].y > c[2].z) {
+        GLfloat s = 2 * sqrt(1 + c[1].y - c[0].x - c[2].z);
+        rotation = quat((c[1].x + c[0].y) / s, s / 4, (c[2].y + c[1].z) / s,
+            (c[2].x - c[0].z) / s);
+    } else {
+        GLfloat s = 2 * sqrt(1 + c[2].z - c[0].x - c[1].y);
+        rotation = quat((c[2].x + c[0].z) / s, (c[2].y + c[1].z) / s, s / 4,
+            (c[0].y - c[1].x) / s);
+    }
+
+    rotation = normalize(rotation);
+}
+
+void Transform::rotate_about(const quat & q, const vec3 & point)
+{
+    translation = point + ::rotate(q, translation - point);
+    rotation = normalize(q * rotation);
+}
+
+void Transform::scale_about(const GLfloat s, const vec3 & point)
+{
+    translation = point + s * (translation - point);
+    scale *= s;
+}
+
+void Transform::scale_axis(const unsigned int axis, const GLfloat s,
+    const vec3 & point)
+{
+    // The point is moved by the scaling and moved back after rotation
+    vec3 shift(0);
+    shift[axis] = scale[axis] * point[axis] * (1 - s);
+
+    translation += ::rotate(rotation, shift);
+    scale[axis] *= s;
+}
+
+mat4 Transform::matrix() const
+{
+    mat4 A = Rotate(rotation);
+
+    for (int i = 0; i < 3; i++) {
+        A[i][0] *= scale.x;
+        A[i][1] *= scale.y;
+        A[i][2] *= scale.z;
+        A[i][3] = translation[i];
+    }
+
+    return A;
+}
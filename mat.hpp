@@ -214,6 +214,9 @@ struct mat4 {
     friend ostream& operator << (ostream& os, const mat4 & A);
 };
 
+// Inverse of an affine transformation (the last row is 0 0 0 1)
+mat4 affine_inverse(const mat4 & A);
+
 // Rotation matrices generators
 mat4 RotX(const GLfloat theta);
 mat4 RotY(const GLfloat theta);
@@ -238,4 +241,39 @@ mat4 Translate(const GLfloat x, const GLfloat y, const GLfloat z);
 mat4 Translate(const vec3 & v);
 mat4 Translate(const vec4 & v);
 
+// Rotation matrix of a unit quaternion
+mat4 Rotate(const quat & q);
+
+//
+// Transformation by components: scaling, then rotation and translation
+// (T * R * S). Rotations are accumulated in the quaternion, so many small
+// changes stay a rotation, while products of matrices drift into shear
+//
+struct Transform {
+    vec3 translation;
+    quat rotation;
+    vec3 scale;
+
+    // Identity
+    Transform();
+    Transform(const vec3 & t, const quat & r, const vec3 & s);
+
+    // Decomposition of an affine matrix, shear is lost. Axes scaled to zero
+    // keep zero scale, their directions complete the rotation
+    explicit Transform(const mat4 & A);
+
+    // Rotation and uniform scaling about a point of the space the
+    // transformation maps into
+    void rotate_about(const quat & q, const vec3 & point);
+    void scale_about(const GLfloat s, const vec3 & point);
+
+    // Scaling along an axis (0, 1, 2) of the space the transformation maps
+    // from, keeping a point of that space in place
+    void scale_axis(const unsigned int axis, const GLfloat s,
+        const vec3 & point);
+
+    // Matrix T * R * S
+    mat4 matrix() const;
+};
+
 #endif
@@ -0,0 +1,151 @@
+#include "memory_account.hpp"
+
+using namespace std;
+
+const char *memory_category_names[memory_categories] = {
+    "vertices", "faces", "normals", "wireframe", "control", "levels",
+    "temporary", "containers", "gpu_mesh", "gpu_normals", "gpu_helpers"
+};
+
+atomic<long long> MemoryAccount::all_bytes_[memory_categories];
+atomic<long long> MemoryAccount::all_peak_[memory_categories];
+atomic<long long> MemoryAccount::all_peak_total_(0);
+
+// Raise a high-water mark shared by threads to a value
+static void raise_peak(atomic<long long> & peak, long long value)
+{
+    long long old = peak.load(memory_order_relaxed);
+
+    while (value > old &&
+        !peak.compare_exchange_weak(old, value, memory_order_relaxed))
+        ;
+}
+
+MemoryAccount::MemoryAccount()
+{
+    for (int i = 0; i < memory_categories; i++)
+        bytes_[i] = peak_[i] = 0;
+
+    peak_total_ = 0;
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    for (int i = 0; i < memory_categories; i++)
+        all_bytes_[i] -= bytes_[i];
+}
+
+void MemoryAccount::allocate(MemoryCategory category, long long bytes)
+{
+    int c = (int) category;
+
+    bytes_[c] += bytes;
+    raise_peak(all_peak_[c], all_bytes_[c] += bytes);
+
+    if (bytes_[c] > peak_[c])
+        peak_[c] = bytes_[c];
+
+    long long sum = total();
+    if (sum > peak_total_)
+        peak_total_ = sum;
+
+    raise_peak(all_peak_total_, all_total());
+}
+
+void MemoryAccount::release(MemoryCategory category, long long bytes)
+{
+    bytes_[(int) category] -= bytes;
+    all_bytes_[(int) category] -= bytes;
+}
+
+void MemoryAccount::set(MemoryCategory category, long long bytes)
+{
+    long long change = bytes - bytes_[(int) category];
+
+    if (change > 0)
+        allocate(category, change);
+    else
+        release(category, -change);
+}
+
+long long MemoryAccount::bytes(MemoryCategory category) const
+{
+    return bytes_[(int) category];
+}
+
+long long MemoryAccount::peak(MemoryCategory category) const
+{
+    return peak_[(int) category];
+}
+
+long long MemoryAccount::total() const
+{
+    long long sum = 0;
+
+    for (int i = 0; i < memory_categories; i++)
+        sum += bytes_[i];
+
+    return sum;
+}
+
+long long MemoryAccount::peak_total() const
+{
+    return peak_total_;
+}
+
+long long MemoryAccount::all_bytes(MemoryCategory category)
+{
+    return all_bytes_[(int) category];
+}
+
+long long MemoryAccount::all_peak(MemoryCategory category)
+{
+    return all_peak_[(int) category];
+}
+
+long long MemoryAccount::all_total()
+{
+    long long sum = 0;
+
+    for (int i = 0; i < memory_categories; i++)
+        sum += all_bytes_[i];
+
+    return sum;
+}
+
+long long MemoryAccount::all_peak_total()
+{
+    return all_peak_total_;
+}
+
+// Line of print() and print_all()
+static void print_line(ostream & out, const string & name,
+    const long long *bytes, const long long *peak, long long total,
+    long long peak_total)
+{
+    out << name << ": " << total / 1024 << " / " << peak_total / 1024 << " KB";
+
+    for (int i = 0; i < memory_categories; i++)
+        if (peak[i] > 0)
+            out << ", " << memory_category_names[i] << " " << bytes[i] / 1024 <<
+                " / " << peak[i] / 1024;
+
+    out << endl;
+}
+
+void MemoryAccount::print(ostream & out, const string & name) const
+{
+    print_line(out, name, bytes_, peak_, total(), peak_total_);
+}
+
+void MemoryAccount::print_all(ostream & out)
+{
+    long long bytes[memory_categories], peak[memory_categories];
+
+    for (int i = 0; i < memory_categories; i++) {
+        bytes[i] = all_bytes_[i];
+        peak[i] = all_peak_[i];
+    }
+
+    print_line(out, "total", bytes, peak, all_total(), all_peak_total_);
+}
@@ -0,0 +1,81 @@
+#ifndef MEMORY_ACCOUNT_HPP
+#define MEMORY_ACCOUNT_HPP
+
+#include <atomic>
+#include <iostream>
+#include <string>
+
+// What memory is used for: arrays of a mesh (vertices, faces, vertex normals,
+// wireframe lines, control mesh of subdivision, simplified levels), temporary
+// data of loading and of the background simplification, containers of the
+// scene, and GL buffers of meshes, of their normal lines and of the scene's
+// helpers (grid, gizmos, cameras)
+enum class MemoryCategory {
+    vertices,
+    faces,
+    normals,
+    wireframe,
+    control,
+    levels,
+    temporary,
+    containers,
+    gpu_mesh,
+    gpu_normals,
+    gpu_helpers
+};
+
+const int memory_categories = 11;
+
+// Names of the categories in the order of MemoryCategory
+extern const char *memory_category_names[memory_categories];
+
+// Bytes owned by one object (a mesh or the scene) in every category and
+// their high-water marks. Accounts also add up to totals of all of them, an
+// account gives its bytes back when it's destroyed. Counters are changed only
+// where memory is allocated and freed. An account is used by one thread at a
+// time (meshes may be built by workers, see Scene::post_add_object()), the
+// totals are atomic
+class MemoryAccount {
+
+    long long bytes_[memory_categories];
+    long long peak_[memory_categories];
+    long long peak_total_;
+
+    // Totals of all the accounts
+    static std::atomic<long long> all_bytes_[memory_categories];
+    static std::atomic<long long> all_peak_[memory_categories];
+    static std::atomic<long long> all_peak_total_;
+
+public:
+
+    MemoryAccount();
+    ~MemoryAccount();
+
+    MemoryAccount(const MemoryAccount &) = delete;
+    MemoryAccount & operator = (const MemoryAccount &) = delete;
+
+    void allocate(MemoryCategory category, long long bytes);
+    void release(MemoryCategory category, long long bytes);
+
+    // Set the size of a category: the difference is allocated or released
+    void set(MemoryCategory category, long long bytes);
+
+    long long bytes(MemoryCategory category) const;
+    long long peak(MemoryCategory category) const;
+
+    // Sum of all the categories and its high-water mark
+    long long total() const;
+    long long peak_total() const;
+
+    // The same for all the accounts
+    static long long all_bytes(MemoryCategory category);
+    static long long all_peak(MemoryCategory category);
+    static long long all_total();
+    static long long all_peak_total();
+
+    // One line: total and every category ever used, current / peak in KB
+    void print(std::ostream & out, const std::string & name) const;
+    static void print_all(std::ostream & out);
+};
+
+#endif
@@ -1,7 +1,63 @@
 #include "mesh.hpp"
+#include "simplify.hpp"
+#include "vcache.hpp"
+#include "edges.hpp"
+#include "halfedge.hpp"
+#include "subdivision.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
 
 using namespace std;
 
+// Fractions of faces kept by the simplified levels of detail
+const double lod_ratio[Mesh::lod_levels] = { 1.0, 0.5, 0.25, 0.1 };
+
+// Local transformation of everything drawn after a mesh
+static const mat4 identity(1);
+
+// Meshes smaller than this are not simplified
+const int lod_min_faces = 64;
+
+// Subdivision levels above this number of triangles are refused
+const long long max_subdivision_faces = 1 << 25;
+
+GLfloat Mesh::lod_pixels_per_triangle = 8;
+GLfloat Mesh::crease_angle = 180;
+
+Mesh::Wireframe Mesh::wireframe = Mesh::Wireframe::edges;
+GLfloat Mesh::feature_angle = 30;
+
+Mesh::BoundingVolume Mesh::bounding_volume = Mesh::BoundingVolume::box;
+
+bool Mesh::optimize_on_load = false;
+bool Mesh::use_cache = true;
+bool Mesh::quantize_vertices = false;
+
+// Simplified levels are built by a separate thread from its own copy of the
+// mesh, so the mesh itself can be changed or destroyed meanwhile
+struct Mesh::LodJob {
+    thread worker;
+    atomic<bool> done, cancel;
+    Geometry source;
+    Geometry levels[lod_levels];
+
+    LodJob(): done(false), cancel(false) {}
+};
+
+// Stream reading from memory, the file is read at once and then tokenized
+struct MemoryBuffer : streambuf {
+    MemoryBuffer(char *data, size_t n) {
+        setg(data, data, data + n);
+    }
+};
+
 struct Triplet {
     unsigned int a, b, c;
     Triplet(unsigned int i = 0, unsigned int j = 0, unsigned int k = 0) {
@@ -11,77 +67,152 @@ struct Triplet {
 
 Mesh::Mesh()
 {
-    f_ = vn_ = 0;
-    f_number_ = 0;
+    v_ = vn_ = 0;
+    f_ = e_ = 0;
+    v_number_ = f_number_ = 0;
+    e_number_ = fe_number_ = 0;
+    subdivision_ = 0;
+    control_v_ = control_vn_ = 0;
+    control_f_ = 0;
+    control_offset_ = 0;
+    control_v_number_ = control_f_number_ = 0;
+    lod_number_ = 1;
+    lod_job_ = 0;
+    sphere_radius_ = 0;
     color_ = 0;
-    set_colorscheme(solarized);
-    draw_mode_[0] = draw_mode_[1] = draw_mode_[2] = false;
-    mesh_vbo_ = 0;
-    active = true;
+    mesh_vbo_ = mesh_ebo_ = 0;
+    quantized_ = false;
+    vertex_normals_vbo_ = face_normals_vbo_ = 0;
+    position_offset_ = position_scale_ = normal_length_ = 0;
     local_transform_ = 0;
-    transformation = mat4(1);
     pivot = 0;
 }
 
 Mesh::Mesh(const Mesh& mesh)
 {
-    if (f_ == 0) {
-        f_ = vn_ = 0;
-        f_number_ = 0;
-        color_ = 0;
-        set_colorscheme(solarized);
-        draw_mode_[0] = draw_mode_[1] = draw_mode_[2] = false;
-        mesh_vbo_ = 0;
-        active = true;
-        local_transform_ = 0;
-        transformation = mat4(1);
-        pivot = 0;
+    v_ = vn_ = 0;
+    f_ = e_ = 0;
+    v_number_ = f_number_ = 0;
+    e_number_ = fe_number_ = 0;
+    subdivision_ = 0;
+    control_v_ = control_vn_ = 0;
+    control_f_ = 0;
+    control_offset_ = 0;
+    control_v_number_ = control_f_number_ = 0;
+    lod_number_ = 1;
+    lod_job_ = 0;
+    sphere_radius_ = 0;
+    color_ = 0;
+    mesh_vbo_ = mesh_ebo_ = 0;
+    quantized_ = false;
+    vertex_normals_vbo_ = face_normals_vbo_ = 0;
+    position_offset_ = position_scale_ = normal_length_ = 0;
+    local_transform_ = 0;
+    pivot = 0;
+
+    if (mesh.f_ == 0)
         return;
-    }
 
+    v_number_ = mesh.v_number_;
     f_number_ = mesh.f_number_;
 
-    for (int i = 0; i < 24; i++)
-        bounding_box_[i] = mesh.bounding_box_[i];
+    for (int i = 0; i < 6; i++)
+        box_limit_[i] = mesh.box_limit_[i];
+    for (int i = 0; i < volume_vertices; i++)
+        volume_lines_[i] = mesh.volume_lines_[i];
+
+    oriented_box_ = mesh.oriented_box_;
+    tight_sphere_ = mesh.tight_sphere_;
 
-    f_ = new vec3[f_number_ * 3];
+    sphere_center_ = mesh.sphere_center_;
+    sphere_radius_ = mesh.sphere_radius_;
 
+    v_ = new vec3[v_number_];
+    for (int i = 0; i < v_number_; i++)
+        v_[i] = mesh.v_[i];
+
+    f_ = new GLuint[f_number_ * 3];
     for (int i = 0; i < f_number_ * 3; i++)
         f_[i] = mesh.f_[i];
 
     if (mesh.vn_ != 0) {
-        vn_ = new vec3[f_number_ * 6];
-        for (int i = 0; i < f_number_ * 6; i++)
+        vn_ = new vec3[v_number_];
+        for (int i = 0; i < v_number_; i++)
             vn_[i] = mesh.vn_[i];
-    } else
-        vn_ = 0;
+    }
+
+    if (mesh.e_ != 0) {
+        e_number_ = mesh.e_number_;
+        fe_number_ = mesh.fe_number_;
+
+        e_ = new GLuint[(e_number_ + fe_number_) * 2];
+        for (int i = 0; i < (e_number_ + fe_number_) * 2; i++)
+            e_[i] = mesh.e_[i];
+    }
+
+    if (mesh.control_f_ != 0) {
+        subdivision_ = mesh.subdivision_;
+        control_v_number_ = mesh.control_v_number_;
+        control_f_number_ = mesh.control_f_number_;
+
+        control_v_ = new vec3[control_v_number_];
+        for (int i = 0; i < control_v_number_; i++)
+            control_v_[i] = mesh.control_v_[i];
+
+        if (mesh.control_vn_ != 0) {
+            control_vn_ = new vec3[control_v_number_];
+            for (int i = 0; i < control_v_number_; i++)
+                control_vn_[i] = mesh.control_vn_[i];
+        }
+
+        int corners = control_f_number_ * 3;
+
+        if (mesh.control_offset_ != 0) {
+            control_offset_ = new int[control_f_number_ + 1];
+            for (int i = 0; i <= control_f_number_; i++)
+                control_offset_[i] = mesh.control_offset_[i];
+
+            corners = control_offset_[control_f_number_];
+        }
+
+        control_f_ = new GLuint[corners];
+        for (int i = 0; i < corners; i++)
+            control_f_[i] = mesh.control_f_[i];
+    }
+
+    name_ = mesh.name_;
+    load_stats_ = mesh.load_stats_;
 
     color_ = mesh.color_;
     local_transform_ = mesh.local_transform_;
+    position_offset_ = mesh.position_offset_;
+    position_scale_ = mesh.position_scale_;
+    normal_length_ = mesh.normal_length_;
 
-    transformation = mesh.transformation;
-
-    set_colorscheme(mesh.colorscheme_);
+    pivot = mesh.pivot;
 
-    for (int i = 0; i < 3; i++)
-        draw_mode_[i] = mesh.draw_mode_[i];
+    account_arrays();
 
     set_main_buffer();
+    build_lods();
 }
 
 Mesh::~Mesh()
 {
+    cancel_lods();
+
+    delete[] v_;
     delete[] f_;
     delete[] vn_;
+    delete[] e_;
+
+    clear_control();
+    release_normals();
 
     if (mesh_vbo_ > 0)
         glDeleteBuffers(1, &mesh_vbo_);
-}
-
-void Mesh::set_colorscheme(const ColorScheme & colorscheme)
-{
-    for (int i = 0; i < 9; i++)
-        colorscheme_[i] = colorscheme[i];
+    if (mesh_ebo_ > 0)
+        glDeleteBuffers(1, &mesh_ebo_);
 }
 
 void Mesh::set_attributes(GLuint color_location, GLuint local_transform)
@@ -90,35 +221,125 @@ void Mesh::set_attributes(GLuint color_location, GLuint local_transform)
     local_transform_ = local_transform;
 }
 
+void Mesh::set_dequantization(GLuint position_offset, GLuint position_scale,
+    GLuint normal_length)
+{
+    position_offset_ = position_offset;
+    position_scale_ = position_scale;
+    normal_length_ = normal_length;
+}
+
 void Mesh::load_file(const char* obj_file) {
-    // Clear previous data
+    if (read_file(obj_file))
+        upload();
+}
+
+void Mesh::upload()
+{
+    load_stats_.start();
+    set_main_buffer();
+    load_stats_.lap(LoadPhase::upload);
+
+    build_lods();
+}
+
+void Mesh::clear()
+{
+    cancel_lods();
+
     if (f_ != 0) {
+        delete[] v_;
         delete[] f_;
         delete[] vn_;
+        delete[] e_;
+        v_ = vn_ = 0;
+        f_ = e_ = 0;
+        e_number_ = fe_number_ = 0;
+
+        clear_control();
+
+        for (int i = 1; i < lod_levels; i++)
+            levels_[i].clear();
+
+        lod_number_ = 1;
+
+        account_arrays();
+    }
+}
+
+bool Mesh::read_file(const char* obj_file) {
+    // Clear previous data
+    clear();
+
+    name_ = obj_file;
+    pivot = 0;
+
+    load_stats_ = LoadStats();
+    load_stats_.name = obj_file;
+    load_stats_.files = 1;
+
+    // Processed mesh from the previous run
+    if (optimize_on_load && use_cache && read_cache()) {
+        load_stats_.lap(LoadPhase::read);
 
-        if (mesh_vbo_ != 0)
-            glDeleteBuffers(1, &mesh_vbo_);
+        load_stats_.cached = true;
+        load_stats_.vertices = v_number_;
+        load_stats_.triangles = f_number_;
+
+        build_wireframe();
+        load_stats_.lap(LoadPhase::wireframe);
+
+        account_arrays();
+
+        return true;
     }
 
-    ifstream file(obj_file);
-    string word, A, B, C;
+    MeshFormat format = mesh_format(obj_file);
+
+    if (format != MeshFormat::obj)
+        return import_file(format);
 
-    if (!file) {
+    ifstream input(obj_file, ios::binary | ios::ate);
+
+    if (!input) {
         cout << "Wrong name of .obj file" << endl;
-        return;
+        return false;
     }
 
-    // Temporary variables used for reading .obj file
+    // The whole file is read first, so that I/O and tokenizing are timed
+    // separately
+    size_t bytes = input.tellg();
+    char *contents = new char[bytes];
+
+    input.seekg(0);
+    input.read(contents, bytes);
+    input.close();
+
+    memory_.allocate(MemoryCategory::temporary, bytes);
 
-    List <vec3> vertices_list;
-    List <vec3> normals_list;
-    List <Triplet> faces_indeces;
-    List <Triplet> normals_indeces;
+    load_stats_.bytes = bytes;
+    load_stats_.lap(LoadPhase::read);
 
-    vec3 *vertices, *normals;
-    unsigned int vertices_number, normals_number;
+    MemoryBuffer buffer(contents, bytes);
+    istream file(&buffer);
+    string word, line, corner;
+
+    // Temporary variables used for reading .obj file: lists only grow while
+    // parsing and are emptied once, their nodes are released at once
+
+    List <vec3, NodeArena> vertices_list;
+    List <vec3, NodeArena> normals_list;
+    List <Triplet, NodeArena> faces_indeces;
+    List <Triplet, NodeArena> normals_indeces;
+
+    // Number of corners of every polygon and corners of the current one
+    List <int, NodeArena> polygon_sizes;
+    bool polygons = false;
+    vector<unsigned int> vertex_corners, normal_corners;
+
+    vec3 *normals;
+    unsigned int normals_number;
 
-    // Assuming only triangular polygons
     while (file >> word)
         if (word[0] == '#')                 // Comment line (skip)
             getline(file, word);
@@ -126,175 +347,1303 @@ void Mesh::load_file(const char* obj_file) {
             file >> vertices_list;
         else if (word == "vn")              // Vertex normals
             file >> normals_list;
-        else if (word == "f") {             // Faces (only triangles)
-            Triplet f_triplet, n_triplet;
+        else if (word == "f") {             // Faces (polygons)
+            getline(file, line);
+            stringstream corners(line);
 
-            file >> A >> B >> C;
-            stringstream X(A), Y(B), Z(C);
-            X >> f_triplet.a, Y >> f_triplet.b, Z >> f_triplet.c;
+            vertex_corners.clear();
+            normal_corners.clear();
 
-            // Indeces of vertices of a current face
-            faces_indeces.push(f_triplet);
+            // Corners are v, v/vt, v//vn or v/vt/vn, 0 stands for no normal
+            while (corners >> corner) {
+                stringstream X(corner);
+                unsigned int v = 0, t = 0, n = 0;
 
-            if (X.peek() == '/' && Y.peek() == '/' && Z.peek() == '/') {
-                X.get(), Y.get(), Z.get();
+                X >> v;
 
-                if (X.peek() == '/' && Y.peek() == '/' && Z.peek() == '/')
-                    X.get(), Y.get(), Z.get();
+                if (X.peek() == '/') {
+                    X.get();
 
-                X >> n_triplet.a, Y >> n_triplet.b, Z >> n_triplet.c;
+                    if (X.peek() != '/')
+                        X >> t;
 
-                // Indeces of normals of a current face's vertices
-                normals_indeces.push(n_triplet);
+                    if (X.peek() == '/')
+                        X.get(), X >> n;
+                }
+
+                vertex_corners.push_back(v);
+                normal_corners.push_back(n);
             }
-        }
 
-    // x_min, x_max, y_min, y_max, z_min, z_max
-    GLfloat box_limit[6];
-    for (int i = 0; i < 3; i++) {
-        box_limit[2 * i] = vertices_list[0][i];
-        box_limit[2 * i + 1] = vertices_list[0][i];
-    }
+            int size = vertex_corners.size();
 
-    // Array of vertices
-    vertices_number = vertices_list.length();
-    vertices = new vec3[vertices_number];
-    for (unsigned int i = 0; i < vertices_number; i++) {
-        vertices[i] = vertices_list.pop_head();
-
-        // Center of a model
-        pivot += vertices[i];
-
-        // Check bounding box limits
-        for (int j = 0; j < 3; j++) {
-            if (vertices[i][j] < box_limit[2 * j])
-                box_limit[2 * j] = vertices[i][j];
-            if (vertices[i][j] > box_limit[2 * j + 1])
-                box_limit[2 * j + 1] = vertices[i][j];
+            if (size < 3)
+                continue;
+
+            bool normals = true;
+            for (int k = 0; k < size; k++)
+                normals = normals && normal_corners[k] != 0;
+
+            // Indeces of vertices (and normals) of a fan of triangles
+            for (int k = 2; k < size; k++) {
+                faces_indeces.push(Triplet(vertex_corners[0],
+                    vertex_corners[k - 1], vertex_corners[k]));
+
+                if (normals)
+                    normals_indeces.push(Triplet(normal_corners[0],
+                        normal_corners[k - 1], normal_corners[k]));
+            }
+
+            polygon_sizes.push(size);
+            polygons = polygons || size != 3;
         }
-    }
 
-    // Calculating center of a model
-    pivot /= vertices_number;
+    load_stats_.vertices = vertices_list.length();
+    load_stats_.normals = normals_list.length();
+    load_stats_.polygons = polygon_sizes.length();
+    load_stats_.triangles = faces_indeces.length();
 
-    build_box(box_limit);
+    // Largest temporary data: the file and the lists at the end of parsing,
+    // or the lists of faces with arrays of normals during resolution
+    long long lists = faces_indeces.bytes() + normals_indeces.bytes() +
+        polygon_sizes.bytes();
+
+    load_stats_.peak_memory = bytes + lists + vertices_list.bytes() +
+        normals_list.bytes();
+
+    // Lists only grow while parsing, they are accounted at their final size
+    memory_.allocate(MemoryCategory::temporary, load_stats_.peak_memory - bytes);
+
+    delete[] contents;
+    memory_.release(MemoryCategory::temporary, bytes);
+
+    load_stats_.lap(LoadPhase::parse);
+
+    // Array of vertices
+    v_number_ = vertices_list.length();
+    v_ = new vec3[v_number_];
+    for (int i = 0; i < v_number_; i++)
+        v_[i] = vertices_list.pop_head();
+    vertices_list.clear();
 
     // Array of vertex normals
     normals_number = normals_list.length();
     normals = new vec3[normals_number];
     for (unsigned int i = 0; i < normals_number; i++)
         normals[i] = normals_list.pop_head();
+    normals_list.clear();
 
     f_number_ = faces_indeces.length();
-    f_ = new vec3[f_number_ * 3];
+    f_ = new GLuint[f_number_ * 3];
+
+    // Indices of normals of faces' vertices, used only if every face has
+    // them (normal triplets are kept for faces with normals at all corners)
+    GLuint *fn = normals_number != 0 &&
+        normals_indeces.length() == faces_indeces.length() ?
+        new GLuint[f_number_ * 3] : 0;
+
+    long long resolution_memory = lists + normals_number * sizeof(vec3) +
+        (fn != 0 ? f_number_ * 3 * sizeof(GLuint) : 0);
 
-    if (normals_number != 0)
-        vn_ = new vec3[f_number_ * 6];
+    if (resolution_memory > load_stats_.peak_memory)
+        load_stats_.peak_memory = resolution_memory;
+
+    memory_.set(MemoryCategory::temporary, resolution_memory);
+
+    bool normals_valid = true;
 
     for (int i = 0; i < f_number_ * 3; i += 3) {
 
         Triplet t = faces_indeces.pop_head();
 
         // Filling faces array
-        f_[i]     = vertices[t.a - 1];
-        f_[i + 1] = vertices[t.b - 1];
-        f_[i + 2] = vertices[t.c - 1];
-
-        // Filling vertex normals array
-        if (normals_number != 0) {
+        f_[i]     = t.a - 1;
+        f_[i + 1] = t.b - 1;
+        f_[i + 2] = t.c - 1;
 
+        if (fn != 0) {
             Triplet y = normals_indeces.pop_head();
 
-            vn_[2 * i]     = f_[i];
-            vn_[2 * i + 1] = f_[i]     + normals[y.a - 1] / 20;
-            vn_[2 * i + 2] = f_[i + 1];
-            vn_[2 * i + 3] = f_[i + 1] + normals[y.b - 1] / 20;
-            vn_[2 * i + 4] = f_[i + 2];
-            vn_[2 * i + 5] = f_[i + 2] + normals[y.c - 1] / 20;
+            fn[i]     = y.a - 1;
+            fn[i + 1] = y.b - 1;
+            fn[i + 2] = y.c - 1;
+
+            for (int k = 0; k < 3; k++)
+                normals_valid = normals_valid && fn[i + k] < normals_number;
         }
     }
 
-    set_main_buffer();
+    faces_indeces.clear();
+    normals_indeces.clear();
+
+    // Files with normal indices out of range get generated normals
+    if (!normals_valid) {
+        delete[] fn;
+        fn = 0;
+    }
+
+    // Files with other polygons than triangles keep them as the control mesh
+    // for subdivision, corners of a polygon are the first triangle of its fan
+    // and the last corners of the following ones
+    if (polygons) {
+        control_v_number_ = v_number_;
+        control_f_number_ = polygon_sizes.length();
+
+        control_v_ = new vec3[v_number_];
+        for (int i = 0; i < v_number_; i++)
+            control_v_[i] = v_[i];
+
+        control_offset_ = new int[control_f_number_ + 1];
+        control_offset_[0] = 0;
+        for (int i = 0; i < control_f_number_; i++)
+            control_offset_[i + 1] = control_offset_[i] +
+                polygon_sizes.pop_head();
+
+        control_f_ = new GLuint[control_offset_[control_f_number_]];
+
+        for (int i = 0, t = 0; i < control_f_number_; i++) {
+            int first = control_offset_[i];
+            int size = control_offset_[i + 1] - first;
+
+            for (int k = 0; k < 3; k++)
+                control_f_[first + k] = f_[3 * t + k];
+            for (int k = 3; k < size; k++)
+                control_f_[first + k] = f_[3 * (t + k - 2) + 2];
+
+            t += size - 2;
+        }
+    }
+
+    load_stats_.lap(LoadPhase::resolve);
+
+    // Center of a model and the bounding volumes
+    pivot = fit_box();
+
+    load_stats_.lap(LoadPhase::bounds);
+
+    // Filling vertex normals array, normals of all the corners of a vertex
+    // are averaged; files without normals at every corner get generated ones
+    if (fn != 0) {
+        vn_ = new vec3[v_number_];
+
+        for (int i = 0; i < v_number_; i++)
+            vn_[i] = vec3(0);
+        for (int i = 0; i < f_number_ * 3; i++)
+            vn_[f_[i]] += normals[fn[i]];
+        for (int i = 0; i < v_number_; i++)
+            if (length(vn_[i]) > 0)
+                vn_[i] = normalize(vn_[i]);
+
+        if (polygons) {
+            control_vn_ = new vec3[v_number_];
+            for (int i = 0; i < v_number_; i++)
+                control_vn_[i] = vn_[i];
+        }
+    } else
+        compute_normals(crease_angle, NormalWeight::angle);
 
-    delete[] vertices;
+    delete[] fn;
     delete[] normals;
+
+    memory_.set(MemoryCategory::temporary, 0);
+
+    load_stats_.lap(LoadPhase::normals);
+
+    finish_read();
+
+    return true;
 }
 
-void Mesh::set_main_buffer()
+bool Mesh::import_file(MeshFormat format)
 {
-    // Create buffer
-    glGenBuffers(1, &mesh_vbo_);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+    MappedFile file;
+
+    if (!file.open(name_.c_str())) {
+        cout << "Wrong name of ." << mesh_format_names[(int) format] <<
+            " file" << endl;
+        return false;
+    }
+
+    // Pages of the mapping are read ahead, so that I/O is timed apart from
+    // conversion, as for .obj files
+    memory_.allocate(MemoryCategory::temporary, file.size());
+    load_stats_.lap(LoadPhase::read);
+
+    ImportedMesh mesh;
+    bool ok = format == MeshFormat::stl ? import_stl(file, mesh, load_stats_) :
+        import_ply(file, mesh, load_stats_);
+
+    file.close();
+
+    // Temporary data at its largest (the mapping and the buckets of welding)
+    // is accounted once, all of it is released by now
+    memory_.set(MemoryCategory::temporary, load_stats_.peak_memory);
+    memory_.set(MemoryCategory::temporary, 0);
+
+    if (!ok)
+        return false;
+
+    v_ = mesh.v, vn_ = mesh.vn, f_ = mesh.f;
+    v_number_ = mesh.v_number, f_number_ = mesh.f_number;
+
+    // Polygons are the control mesh for subdivision, as for .obj files
+    if (mesh.polygon_f != 0) {
+        control_v_number_ = v_number_;
+        control_f_number_ = mesh.polygon_number;
+        control_f_ = mesh.polygon_f;
+        control_offset_ = mesh.polygon_offset;
+
+        control_v_ = new vec3[v_number_];
+        for (int i = 0; i < v_number_; i++)
+            control_v_[i] = v_[i];
+
+        if (vn_ != 0) {
+            control_vn_ = new vec3[v_number_];
+            for (int i = 0; i < v_number_; i++)
+                control_vn_[i] = vn_[i];
+        }
+    }
+
+    mesh.v = mesh.vn = 0;
+    mesh.f = mesh.polygon_f = 0;
+    mesh.polygon_offset = 0;
+
+    pivot = fit_box();
+
+    load_stats_.lap(LoadPhase::bounds);
+
+    if (vn_ == 0)
+        compute_normals(crease_angle, NormalWeight::angle);
+
+    load_stats_.lap(LoadPhase::normals);
+
+    finish_read();
+
+    return true;
+}
+
+void Mesh::finish_read()
+{
+    if (optimize_on_load) {
+        optimize();
+        load_stats_.lap(LoadPhase::optimize);
+    }
+
+    // Cache keeps triangles only
+    if (optimize_on_load && use_cache && control_offset_ == 0)
+        write_cache();
+
+    load_stats_.start();
+    build_wireframe();
+    load_stats_.lap(LoadPhase::wireframe);
+
+    account_arrays();
+}
+
+void Mesh::set_geometry(Geometry && geometry, const string & name,
+    GLfloat crease)
+{
+    clear();
+
+    name_ = name;
+
+    load_stats_ = LoadStats();
+    load_stats_.name = name;
+    load_stats_.files = 1;
+    load_stats_.vertices = geometry.v_number;
+    load_stats_.polygons = load_stats_.triangles = geometry.f_number;
+
+    v_ = geometry.v, f_ = geometry.f;
+    v_number_ = geometry.v_number, f_number_ = geometry.f_number;
+
+    geometry.v = 0, geometry.f = 0;
+    geometry.clear();
+
+    pivot = fit_box();
+
+    load_stats_.lap(LoadPhase::bounds);
+
+    compute_normals(crease, NormalWeight::angle);
+
+    load_stats_.lap(LoadPhase::normals);
+
+    if (optimize_on_load) {
+        optimize();
+        load_stats_.lap(LoadPhase::optimize);
+    }
+
+    build_wireframe();
+
+    load_stats_.lap(LoadPhase::wireframe);
+
+    account_arrays();
+}
+
+vec3 Mesh::fit_box()
+{
+    MeshBounds bounds = mesh_bounds(v_, v_number_);
+
+    for (int i = 0; i < 3; i++) {
+        box_limit_[2 * i] = bounds.points.min[i];
+        box_limit_[2 * i + 1] = bounds.points.max[i];
+    }
+
+    oriented_box_ = bounds.box;
+    tight_sphere_ = bounds.sphere;
+    build_box(box_limit_);
+
+    return bounds.points.centroid;
+}
+
+void Mesh::account_arrays()
+{
+    long long levels = 0;
+
+    for (int i = 1; i < lod_number_; i++)
+        levels += levels_[i].v_number * sizeof(vec3) +
+            (levels_[i].f_number * 3 +
+            (levels_[i].e_number + levels_[i].fe_number) * 2) * sizeof(GLuint);
+
+    long long control = control_f_ == 0 ? 0 :
+        control_v_number_ * sizeof(vec3) * (control_vn_ != 0 ? 2 : 1) +
+        (control_offset_ != 0 ? (control_offset_[control_f_number_] +
+        control_f_number_ + 1) * sizeof(GLuint) :
+        control_f_number_ * 3 * sizeof(GLuint));
+
+    memory_.set(MemoryCategory::vertices, v_number_ * sizeof(vec3));
+    memory_.set(MemoryCategory::faces, f_number_ * 3 * sizeof(GLuint));
+    memory_.set(MemoryCategory::normals,
+        vn_ != 0 ? v_number_ * sizeof(vec3) : 0);
+    memory_.set(MemoryCategory::wireframe,
+        (e_number_ + fe_number_) * 2 * sizeof(GLuint));
+    memory_.set(MemoryCategory::control, control);
+    memory_.set(MemoryCategory::levels, levels);
+}
+
+void Mesh::clear_control()
+{
+    delete[] control_v_;
+    delete[] control_vn_;
+    delete[] control_f_;
+    delete[] control_offset_;
+
+    control_v_ = control_vn_ = 0;
+    control_f_ = 0;
+    control_offset_ = 0;
+    control_v_number_ = control_f_number_ = 0;
+    subdivision_ = 0;
+}
+
+void Mesh::set_subdivision(int level)
+{
+    if (f_ == 0 || level < 0 || level > max_subdivision ||
+        level == subdivision_)
+        return;
+
+    // Every step splits triangles into four, Catmull-Clark makes two
+    // triangles of every corner at the first step
+    long long faces = control_f_ == 0 ? f_number_ : control_offset_ == 0 ?
+        control_f_number_ : control_offset_[control_f_number_] / 2;
+
+    if ((faces << 2 * level) > max_subdivision_faces) {
+        cout << name_ << ": subdivision level " << level <<
+            " has too many triangles" << endl;
+        return;
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    // Triangle meshes become the control mesh when first subdivided
+    if (control_f_ == 0) {
+        control_v_ = v_, control_vn_ = vn_, control_f_ = f_;
+        control_v_number_ = v_number_, control_f_number_ = f_number_;
+    } else {
+        delete[] v_;
+        delete[] vn_;
+        delete[] f_;
+    }
+
+    v_ = vn_ = 0;
+    f_ = 0;
 
-    // Put vertex normals in buffer if they exist
-    if (vn_ != 0) {
-        glBufferData(GL_ARRAY_BUFFER,
-            (f_number_ * 9 + 24) * sizeof(vec3), f_, GL_STATIC_DRAW);
+    if (level == 0 && control_offset_ == 0) {
+        v_ = control_v_, vn_ = control_vn_, f_ = control_f_;
+        v_number_ = control_v_number_, f_number_ = control_f_number_;
 
-        glBufferSubData(GL_ARRAY_BUFFER, (f_number_ * 3 + 24) * sizeof(vec3),
-            f_number_ * 6 * sizeof(vec3), vn_);
+        control_v_ = control_vn_ = 0;
+        control_f_ = 0;
+        control_v_number_ = control_f_number_ = 0;
+
+        build_wireframe();
     } else {
-        glBufferData(GL_ARRAY_BUFFER, (f_number_ * 3 + 24) * sizeof(vec3),
-            f_, GL_STATIC_DRAW);
+        Edge *edges;
+        int e_number;
+
+        v_number_ = subdivide(control_v_, control_v_number_, control_f_,
+            control_offset_, control_f_number_, level, v_, f_, f_number_,
+            edges, e_number);
+
+        // Edges come with the surface, lines stay valid when vertices are
+        // split for creases. Faces and vertices aren't reordered for the
+        // caches, that would invalidate them
+        delete[] e_;
+        e_number_ = e_number;
+        wireframe_lines(v_, f_, f_number_, edges, e_number, feature_angle, e_,
+            fe_number_);
+
+        delete[] edges;
+
+        if (level == 0 && control_vn_ != 0) {
+            vn_ = new vec3[v_number_];
+            for (int i = 0; i < v_number_; i++)
+                vn_[i] = control_vn_[i];
+        } else
+            compute_normals(crease_angle, NormalWeight::angle);
+    }
+
+    subdivision_ = level;
+
+    // Subdivision surfaces shrink into the control mesh
+    fit_box();
+
+    // Levels of detail of the previous surface
+    cancel_lods();
+
+    for (int i = 1; i < lod_levels; i++)
+        levels_[i].clear();
+
+    lod_number_ = 1;
+
+    account_arrays();
+
+    cout << name_ << ": subdivision level " << level << ", " << f_number_ <<
+        " triangles in " << chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count() << " ms" << endl;
+
+    if (mesh_vbo_ != 0) {
+        set_main_buffer();
+        build_lods();
+    }
+}
+
+int Mesh::subdivision() const
+{
+    return subdivision_;
+}
+
+void Mesh::optimize()
+{
+    CacheStats before = vertex_cache_stats(f_, f_number_, v_number_);
+
+    // Faces order for the post-transform cache, then vertices order for the
+    // pre-transform (fetch) cache
+    optimize_vertex_cache(v_, v_number_, f_, f_number_, vn_);
+
+    CacheStats after = vertex_cache_stats(f_, f_number_, v_number_);
+
+    cout << name_ << ": ACMR " << before.acmr << " -> " << after.acmr <<
+        ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+}
+
+void Mesh::generate_normals(GLfloat crease_angle, NormalWeight weight)
+{
+    if (f_ == 0)
+        return;
+
+    compute_normals(crease_angle, weight);
+    build_wireframe();
+    account_arrays();
+
+    if (mesh_vbo_ != 0)
+        set_main_buffer();
+}
+
+void Mesh::compute_normals(GLfloat crease_angle, NormalWeight weight)
+{
+    delete[] vn_;
+
+    if (crease_angle >= 180) {
+        vn_ = new vec3[v_number_];
+        vertex_normals(v_, v_number_, f_, f_number_, vn_, weight);
+    } else {
+        vec3 *v;
+        int v_number = crease_normals(v_, v_number_, f_, f_number_,
+            crease_angle, weight, v, vn_);
+
+        delete[] v_;
+        v_ = v;
+        v_number_ = v_number;
+    }
+}
+
+// Cache file layout: header, vertices, faces, vertex normals. The source
+// file and the options the data depend on (crease angle of generated
+// normals, cache size of the optimiser) are checked before it's used
+struct CacheHeader {
+    char magic[8];
+    long long source_size, source_time;
+    GLfloat crease_angle;
+    int optimizer_cache;
+    int v_number, f_number, normals;
+    GLfloat box_limit[6];
+    GLfloat pivot[3];
+    OrientedBox box;
+    BoundingSphere sphere;
+};
+
+const char cache_magic[8] = { 'M', 'E', 'S', 'H', 'C', 'A', 'C', '5' };
+
+// Size and modification time of a file, used to invalidate cache
+static bool source_stamp(const string & file, long long & size,
+    long long & time)
+{
+    struct stat st;
+
+    if (stat(file.c_str(), &st) != 0)
+        return false;
+
+    size = st.st_size;
+    time = st.st_mtime;
+    return true;
+}
+
+bool Mesh::read_cache()
+{
+    CacheHeader header;
+    long long size, time, cache_size, cache_time;
+    string cache = name_ + ".mcache";
+
+    if (!source_stamp(name_, size, time) ||
+        !source_stamp(cache, cache_size, cache_time))
+        return false;
+
+    FILE *fp = fopen(cache.c_str(), "rb");
+
+    if (fp == 0)
+        return false;
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, cache_magic, 8) != 0 ||
+        header.source_size != size || header.source_time != time ||
+        header.crease_angle != crease_angle ||
+        header.optimizer_cache != forsyth_cache_size) {
+        fclose(fp);
+        return false;
+    }
+
+    // Counts of a damaged file aren't allocated, they have to match its size
+    long long v_number = header.v_number, f_number = header.f_number;
+    long long data_size = v_number * (1 + (header.normals != 0)) *
+        (long long) sizeof(vec3) + f_number * 3 * (long long) sizeof(GLuint);
+
+    if (v_number < 0 || f_number < 0 ||
+        cache_size != (long long) sizeof(header) + data_size) {
+        fclose(fp);
+        return false;
+    }
+
+    v_number_ = header.v_number;
+    f_number_ = header.f_number;
+
+    v_ = new vec3[v_number_];
+    f_ = new GLuint[f_number_ * 3];
+    vn_ = header.normals ? new vec3[v_number_] : 0;
+
+    bool ok =
+        fread(v_, sizeof(vec3), v_number_, fp) == (size_t) v_number_ &&
+        fread(f_, sizeof(GLuint), f_number_ * 3, fp) ==
+            (size_t) f_number_ * 3 &&
+        (vn_ == 0 || fread(vn_, sizeof(vec3), v_number_, fp) ==
+            (size_t) v_number_);
+
+    load_stats_.bytes = ftell(fp);
+    fclose(fp);
+
+    // Indices of a damaged payload would be read out of bounds later
+    for (int i = 0; ok && i < f_number_ * 3; i++)
+        ok = f_[i] < (GLuint) v_number_;
+
+    if (!ok) {
+        delete[] v_;
+        delete[] f_;
+        delete[] vn_;
+        v_ = vn_ = 0;
+        f_ = 0;
+        v_number_ = f_number_ = 0;
+        return false;
     }
 
-    // Bounding box
-    glBufferSubData(GL_ARRAY_BUFFER, f_number_ * 3 * sizeof(vec3),
-        24 * sizeof(vec3), bounding_box_);
+    for (int i = 0; i < 6; i++)
+        box_limit_[i] = header.box_limit[i];
+
+    pivot = vec3(header.pivot[0], header.pivot[1], header.pivot[2]);
+    oriented_box_ = header.box;
+    tight_sphere_ = header.sphere;
+    build_box(box_limit_);
+
+    return true;
+}
+
+void Mesh::write_cache()
+{
+    CacheHeader header;
+
+    memcpy(header.magic, cache_magic, 8);
+
+    if (!source_stamp(name_, header.source_size, header.source_time))
+        return;
+
+    header.crease_angle = crease_angle;
+    header.optimizer_cache = forsyth_cache_size;
+    header.v_number = v_number_;
+    header.f_number = f_number_;
+    header.normals = vn_ != 0;
+
+    for (int i = 0; i < 6; i++)
+        header.box_limit[i] = box_limit_[i];
+    for (int i = 0; i < 3; i++)
+        header.pivot[i] = pivot[i];
+
+    header.box = oriented_box_;
+    header.sphere = tight_sphere_;
+
+    FILE *fp = fopen((name_ + ".mcache").c_str(), "wb");
+
+    if (fp == 0)
+        return;
+
+    fwrite(&header, sizeof(header), 1, fp);
+    fwrite(v_, sizeof(vec3), v_number_, fp);
+    fwrite(f_, sizeof(GLuint), f_number_ * 3, fp);
+
+    if (vn_ != 0)
+        fwrite(vn_, sizeof(vec3), v_number_, fp);
+
+    fclose(fp);
 }
 
-void Mesh::draw() {
+void Mesh::set_main_buffer()
+{
+    // Layout of the vertex buffer: vertices, bounding volumes, vertices of the
+    // simplified levels
+    quantized_ = quantize_vertices;
+
+    int vertices = v_number_ + volume_vertices;
+    int indices = f_number_ * 3 + (e_number_ + fe_number_) * 2;
+
+    for (int i = 1; i < lod_number_; i++) {
+        vertices += levels_[i].v_number;
+        indices += levels_[i].f_number * 3 +
+            (levels_[i].e_number + levels_[i].fe_number) * 2;
+    }
+
+    GLsizeiptr stride = quantized_ ? sizeof(QVertex) : sizeof(vec3);
+
+    load_stats_.gpu_bytes = vertices * stride + indices * sizeof(GLuint);
+    memory_.set(MemoryCategory::gpu_mesh, load_stats_.gpu_bytes);
+
+    if (quantized_)
+        build_quantization();
+
+    // Face centres depend on the layout, rebuilt when drawn next time
+    release_normals();
+
+    // Create buffers
+    if (mesh_vbo_ == 0)
+        glGenBuffers(1, &mesh_vbo_);
+    if (mesh_ebo_ == 0)
+        glGenBuffers(1, &mesh_ebo_);
+
     glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-    mat4 id(1);
+    glBufferData(GL_ARRAY_BUFFER, vertices * stride, 0, GL_STATIC_DRAW);
 
-    // Drawing model
+    upload_vertices(0, v_, v_number_);
+
+    // Bounding volumes
+    upload_vertices(v_number_, volume_lines_, volume_vertices);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_ebo_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices * sizeof(GLuint), 0,
+        GL_STATIC_DRAW);
+
+    // Faces and lines of every level, indices of the simplified levels are
+    // shifted to the level's vertices
+    int vertex_offset = v_number_ + volume_vertices;
+    int index_offset = 0;
 
-    glUniformMatrix4fv(local_transform_, 1, true ,(GLfloat*) & transformation);
+    for (int i = 0; i < lod_number_; i++) {
+        const Geometry & g = levels_[i];
 
-    if (!active) {
-        draw_mode_[0] = false, draw_mode_[1] = false, draw_mode_[2] = false;
+        const GLuint *f = i == 0 ? f_ : g.f, *e = i == 0 ? e_ : g.e;
+        int faces = i == 0 ? f_number_ : g.f_number;
+        int lines = i == 0 ? e_number_ + fe_number_ : g.e_number + g.fe_number;
+        GLuint shift = i == 0 ? 0 : vertex_offset;
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        glUniform4fv(color_, 1, (GLfloat*) & colorscheme_[8]);
-        glDrawArrays(GL_TRIANGLES, 0, f_number_ * 3);
-        glUniformMatrix4fv(local_transform_, 1, true ,(GLfloat*) & id);
+        if (i > 0) {
+            upload_vertices(vertex_offset, g.v, g.v_number);
+            vertex_offset += g.v_number;
+        }
+
+        lod_offset_[i] = index_offset;
+        upload_indices(index_offset, f, faces * 3, shift);
+        index_offset += faces * 3;
+
+        line_offset_[i] = index_offset;
+        upload_indices(index_offset, e, lines * 2, shift);
+        index_offset += lines * 2;
+    }
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::upload_vertices(int first, const vec3 *v, int n)
+{
+    if (!quantized_) {
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(vec3),
+            n * sizeof(vec3), v);
         return;
     }
 
+    QVertex *q = new QVertex[n];
+    for (int i = 0; i < n; i++)
+        q[i] = quantization_.encode(v[i]);
+
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(QVertex),
+        n * sizeof(QVertex), q);
+
+    delete[] q;
+}
+
+void Mesh::upload_indices(int first, const GLuint *indices, int n,
+    GLuint shift)
+{
+    if (shift == 0) {
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(GLuint),
+            n * sizeof(GLuint), indices);
+        return;
+    }
+
+    GLuint *shifted = new GLuint[n];
+    for (int i = 0; i < n; i++)
+        shifted[i] = indices[i] + shift;
+
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * sizeof(GLuint),
+        n * sizeof(GLuint), shifted);
+
+    delete[] shifted;
+}
+
+void Mesh::build_wireframe()
+{
+    delete[] e_;
+
+    e_number_ = wireframe_lines(v_, f_, f_number_, feature_angle, e_,
+        fe_number_);
+}
+
+void Mesh::build_quantization()
+{
+    quantization_ = Quantization();
+    quantization_.include(v_, v_number_);
+    quantization_.include(volume_lines_, volume_vertices);
+
+    for (int i = 1; i < lod_number_; i++)
+        quantization_.include(levels_[i].v, levels_[i].v_number);
+}
+
+void Mesh::footprint_report()
+{
+    build_quantization();
+
+    long long vertices = v_number_ + volume_vertices;
+
+    for (int i = 1; i < lod_number_; i++)
+        vertices += levels_[i].v_number;
+
+    long long float_size = vertices * sizeof(vec3);
+    long long quantized_size = vertices * sizeof(QVertex);
+
+    // Largest errors of positions (relative to the box) and of the octahedral
+    // normals of normal lines, which are stored apart from the vertices
+    double position_error = 0, normal_error = 0;
+
+    for (int i = 0; i < v_number_; i++) {
+        double e = length(quantization_.decode(quantization_.encode(v_[i])) -
+            v_[i]);
+
+        if (e > position_error)
+            position_error = e;
+    }
+
+    for (int i = 0; vn_ != 0 && i < v_number_; i++) {
+        if (length(vn_[i]) == 0)
+            continue;
+
+        GLbyte q[2];
+        encode_normal(vn_[i], q);
+
+        double c = dot(vn_[i], decode_normal(q));
+        double e = acos(c > 1 ? 1 : c) * 180 / pi;
+
+        if (e > normal_error)
+            normal_error = e;
+    }
+
+    cout << name_ << ": vertex buffer " << float_size / 1024 << " KB -> " <<
+        quantized_size / 1024 << " KB quantised (" <<
+        (double) float_size / quantized_size << "x), max position error " <<
+        position_error / length(quantization_.scale()) <<
+        " of the box, max normal line error " << normal_error << " deg" <<
+        endl;
+}
+
+void Mesh::normals_report()
+{
+    int v_number = v_number_;
+    double time[3];
+
+    // Smooth normals weighted by area and by angle, normals with creases
+    for (int i = 0; i < 3; i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        compute_normals(i < 2 ? 180 : 30,
+            i == 0 ? NormalWeight::area : NormalWeight::angle);
+
+        time[i] = chrono::duration<double, milli>(
+            chrono::steady_clock::now() - start).count();
+    }
+
+    cout << name_ << ": " << f_number_ << " triangles, normals by area " <<
+        time[0] << " ms, by angle " << time[1] << " ms, with creases of 30 "
+        "deg " << time[2] << " ms (" << v_number << " -> " << v_number_ <<
+        " vertices)" << endl;
+}
+
+void Mesh::wireframe_report()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    build_wireframe();
+
+    double time = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+
+    cout << name_ << ": " << f_number_ << " triangles, " << f_number_ * 3 <<
+        " polygon lines, " << e_number_ << " unique edges, " << fe_number_ <<
+        " feature edges (" << feature_angle << " deg), found in " << time <<
+        " ms" << endl;
+}
+
+void Mesh::topology_report()
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    HalfEdges half_edges(f_, f_number_, v_number_);
+
+    double time = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - start).count();
+
+    cout << name_ << ": " << f_number_ << " triangles, half-edges built in " <<
+        time << " ms, " << (double) half_edges.bytes() / f_number_ <<
+        " bytes per triangle, " << half_edges.boundary_edges() <<
+        " boundary edges, " << half_edges.non_manifold_edges() <<
+        " non-manifold edges, " << half_edges.inconsistent_edges() <<
+        " inconsistently oriented edges, " <<
+        half_edges.non_manifold_vertices() << " non-manifold vertices" << endl;
+}
+
+void Mesh::subdivision_report()
+{
+    for (int level = 1; level <= max_subdivision; level++)
+        set_subdivision(level);
+
+    set_subdivision(0);
+}
+
+void Mesh::build_lods()
+{
+    if (f_number_ < lod_min_faces)
+        return;
+
+    lod_job_ = new LodJob;
+
+    Geometry & source = lod_job_ -> source;
+    source.allocate(v_number_, f_number_);
+
+    for (int i = 0; i < v_number_; i++)
+        source.v[i] = v_[i];
+    for (int i = 0; i < f_number_ * 3; i++)
+        source.f[i] = f_[i];
+
+    memory_.allocate(MemoryCategory::temporary,
+        v_number_ * sizeof(vec3) + f_number_ * 3 * sizeof(GLuint));
+
+    LodJob *job = lod_job_;
+
+    job -> worker = thread([job]() {
+        Simplifier simplifier(job -> source.v, job -> source.v_number,
+            job -> source.f, job -> source.f_number);
+
+        int previous = job -> source.f_number;
+
+        for (int i = 1; i < lod_levels; i++) {
+            int faces = simplifier.simplify(
+                (int) (job -> source.f_number * lod_ratio[i]), &job -> cancel);
+
+            // Nothing left to simplify
+            if (job -> cancel || faces >= previous)
+                break;
+
+            Geometry & level = job -> levels[i];
+            simplifier.extract(level);
+
+            if (optimize_on_load)
+                optimize_vertex_cache(level.v, level.v_number, level.f,
+                    level.f_number);
+
+            level.e_number = wireframe_lines(level.v, level.f, level.f_number,
+                feature_angle, level.e, level.fe_number);
+
+            previous = faces;
+        }
+
+        job -> done = true;
+    });
+}
+
+void Mesh::cancel_lods()
+{
+    if (lod_job_ == 0)
+        return;
+
+    lod_job_ -> cancel = true;
+    lod_job_ -> worker.join();
+
+    release_lod_job();
+}
+
+void Mesh::release_lod_job()
+{
+    const Geometry & source = lod_job_ -> source;
+
+    memory_.release(MemoryCategory::temporary,
+        source.v_number * sizeof(vec3) + source.f_number * 3 * sizeof(GLuint));
+
+    delete lod_job_;
+    lod_job_ = 0;
+}
+
+void Mesh::finish_lods()
+{
+    lod_job_ -> worker.join();
+
+    lod_number_ = 1;
+    for (int i = 1; i < lod_levels && lod_job_ -> levels[i].f_number > 0; i++)
+        levels_[lod_number_++] = std::move(lod_job_ -> levels[i]);
+
+    release_lod_job();
+    account_arrays();
+
+    cout << name_ << ": levels of detail " << f_number_;
+    for (int i = 1; i < lod_number_; i++)
+        cout << " / " << levels_[i].f_number;
+    cout << " triangles" << endl;
+
+    set_main_buffer();
+}
+
+void Mesh::wait_lods()
+{
+    if (lod_job_ != 0)
+        finish_lods();
+}
+
+void Mesh::draw(const mat4 & transformation, const vec4 *colorscheme,
+    unsigned int flags, int level)
+{
+    if (lod_job_ != 0 && lod_job_ -> done)
+        finish_lods();
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_ebo_);
+
+    if (quantized_) {
+        vec3 offset = quantization_.offset(), scale = quantization_.scale();
+
+        glUniform3fv(position_offset_, 1, (GLfloat*) & offset);
+        glUniform3fv(position_scale_, 1, (GLfloat*) & scale);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+            sizeof(QVertex), 0);
+    } else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    // Proxy: coarsest level, or bounding box if there are no levels yet
+    bool proxy = (flags & draw_proxy) != 0;
+    bool box_proxy = proxy && lod_job_ != 0;
+
+    if (proxy || level >= lod_number_)
+        level = proxy ? lod_number_ - 1 : 0;
+
+    GLvoid *faces = (GLvoid *) (lod_offset_[level] * sizeof(GLuint));
+    int faces_number = level == 0 ? f_number_ : levels_[level].f_number;
+
+    // Feature edges follow unique edges
+    int edges_number = level == 0 ? e_number_ : levels_[level].e_number;
+    int features_number = level == 0 ? fe_number_ : levels_[level].fe_number;
+    bool features = wireframe == Wireframe::features;
+
+    GLvoid *lines = (GLvoid *) ((line_offset_[level] +
+        (features ? edges_number * 2 : 0)) * sizeof(GLuint));
+    int lines_number = features ? features_number : edges_number;
+
+    // Drawing model
+
+    glUniformMatrix4fv(local_transform_, 1, true,
+        (const GLfloat *) & transformation);
+
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glUniform4fv(color_, 1, (GLfloat*) & colorscheme_[3]);
-    glDrawArrays(GL_TRIANGLES, 0, f_number_ * 3);
+    glUniform4fv(color_, 1,
+        (const GLfloat *) & colorscheme[flags & draw_active ? 3 : 8]);
+
+    if (box_proxy)
+        glDrawArrays(GL_LINES, v_number_, 24);
+    else if (wireframe == Wireframe::polygons)
+        glDrawElements(GL_TRIANGLES, faces_number * 3, GL_UNSIGNED_INT, faces);
+    else
+        glDrawElements(GL_LINES, lines_number * 2, GL_UNSIGNED_INT, lines);
+
+    // Drawing vertex and face normals (skipped for proxies)
+    if (vn_ != 0 && (flags & draw_vertex_normals) && !proxy) {
+        if (vertex_normals_vbo_ == 0)
+            build_vertex_normals();
+
+        glUniform4fv(color_, 1, (const GLfloat *) & colorscheme[1]);
+        draw_normals(mesh_vbo_, vertex_normals_vbo_, 0, v_number_);
+    }
+
+    if ((flags & draw_face_normals) && !proxy) {
+        if (face_normals_vbo_ == 0)
+            build_face_normals();
 
-    // Drawing vertex normals
-    if (vn_ != 0 && draw_mode_[0] == true) {
-        glUniform4fv(color_, 1, (GLfloat*) & colorscheme_[1]);
-        glDrawArrays(GL_LINES, f_number_ * 3 + 24, f_number_ * 6);
+        GLintptr stride = quantized_ ? sizeof(QVertex) : sizeof(vec3);
+
+        glUniform4fv(color_, 1, (const GLfloat *) & colorscheme[2]);
+        draw_normals(face_normals_vbo_, face_normals_vbo_, f_number_ * stride,
+            f_number_);
     }
 
-    // Drawing bounding box in model coordinates
-    if (draw_mode_[2]) {
-        glUniform4fv(color_, 1, (GLfloat*) &colorscheme_[7]);
-        glDrawArrays(GL_LINES, f_number_ * 3, 24);
+    // Drawing bounding volumes in model coordinates
+    if (flags & draw_bounding_box) {
+        bool all = bounding_volume == BoundingVolume::all;
+
+        glUniform4fv(color_, 1, (const GLfloat *) & colorscheme[7]);
+
+        if (all || bounding_volume == BoundingVolume::box)
+            glDrawArrays(GL_LINES, v_number_, 24);
+        if (all || bounding_volume == BoundingVolume::oriented_box)
+            glDrawArrays(GL_LINES, v_number_ + 24, 24);
+        if (all || bounding_volume == BoundingVolume::sphere)
+            for (int i = 0; i < 3; i++)
+                glDrawArrays(GL_LINE_LOOP, v_number_ + 48 +
+                    i * sphere_segments, sphere_segments);
+    }
+
+    glUniformMatrix4fv(local_transform_, 1, true,
+        (const GLfloat *) & identity);
+
+    // The rest of the scene isn't quantised
+    if (quantized_) {
+        vec3 offset(0), scale(1);
+
+        glUniform3fv(position_offset_, 1, (GLfloat*) & offset);
+        glUniform3fv(position_scale_, 1, (GLfloat*) & scale);
+    }
+
+    // Controllers are drawn from client memory
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::build_vertex_normals()
+{
+    GLbyte *n = new GLbyte[v_number_ * 2];
+    for (int i = 0; i < v_number_; i++)
+        encode_normal(vn_[i], n + 2 * i);
+
+    glGenBuffers(1, &vertex_normals_vbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_normals_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, v_number_ * 2, n, GL_STATIC_DRAW);
+    memory_.allocate(MemoryCategory::gpu_normals, v_number_ * 2);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+
+    delete[] n;
+}
+
+void Mesh::build_face_normals()
+{
+    GLsizeiptr stride = quantized_ ? sizeof(QVertex) : sizeof(vec3);
+
+    vec3 *centre = new vec3[f_number_];
+    vec3 *normal = new vec3[f_number_];
+    GLbyte *n = new GLbyte[f_number_ * 2];
+
+    face_normals(v_, f_, f_number_, normal);
+
+    for (int i = 0; i < f_number_; i++) {
+        centre[i] = (v_[f_[3 * i]] + v_[f_[3 * i + 1]] + v_[f_[3 * i + 2]]) / 3;
+        encode_normal(normal[i], n + 2 * i);
     }
 
-    glUniformMatrix4fv(local_transform_, 1, true ,(GLfloat*) & id);
+    glGenBuffers(1, &face_normals_vbo_);
+    glBindBuffer(GL_ARRAY_BUFFER, face_normals_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, f_number_ * (stride + 2), 0,
+        GL_STATIC_DRAW);
+    memory_.allocate(MemoryCategory::gpu_normals, f_number_ * (stride + 2));
+
+    upload_vertices(0, centre, f_number_);
+    glBufferSubData(GL_ARRAY_BUFFER, f_number_ * stride, f_number_ * 2, n);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+
+    delete[] centre;
+    delete[] normal;
+    delete[] n;
+}
+
+void Mesh::release_normals()
+{
+    if (vertex_normals_vbo_ > 0)
+        glDeleteBuffers(1, &vertex_normals_vbo_);
+    if (face_normals_vbo_ > 0)
+        glDeleteBuffers(1, &face_normals_vbo_);
+
+    vertex_normals_vbo_ = face_normals_vbo_ = 0;
+    memory_.set(MemoryCategory::gpu_normals, 0);
+}
+
+void Mesh::draw_normals(GLuint origins_vbo, GLuint normals_vbo,
+    GLintptr normals_offset, int n)
+{
+    // Every normal is an instance of a two-vertex line, the second vertex is
+    // moved along the normal in shader
+    glBindBuffer(GL_ARRAY_BUFFER, origins_vbo);
+
+    if (quantized_)
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+            sizeof(QVertex), 0);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, normals_vbo);
+    glVertexAttribPointer(1, 2, GL_BYTE, GL_TRUE, 0, (GLvoid *) normals_offset);
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(0, 1);
+    glVertexAttribDivisor(1, 1);
+    glUniform1f(normal_length_, 1 / 20.0);
+
+    glDrawArraysInstanced(GL_LINES, 0, 2, n);
+
+    glUniform1f(normal_length_, 0);
+    glVertexAttribDivisor(0, 0);
+    glVertexAttribDivisor(1, 0);
+    glDisableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_vbo_);
+
+    if (quantized_)
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+            sizeof(QVertex), 0);
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+}
+
+int Mesh::select_lod(GLfloat radius) const
+{
+    if (lod_number_ < 2)
+        return 0;
+
+    // Number of triangles the projected sphere can show
+    GLfloat needed = pi * radius * radius / lod_pixels_per_triangle;
+
+    int level = 0;
+    for (int i = lod_number_ - 1; i > 0; i--)
+        if (levels_[i].f_number >= needed) {
+            level = i;
+            break;
+        }
+
+    return level;
 }
 
+const vec3 & Mesh::sphere_center() const
+{
+    return sphere_center_;
+}
+
+GLfloat Mesh::sphere_radius() const
+{
+    return sphere_radius_;
+}
+
+const vec3 & Mesh::box_min() const
+{
+    return volume_lines_[0];
+}
 
-void Mesh::toogle_vertex_normals()
+const vec3 & Mesh::box_max() const
 {
-    draw_mode_[0] ? draw_mode_[0] = false : draw_mode_[0] = true;
+    return volume_lines_[7];
 }
 
-void Mesh::toogle_face_normals()
+const OrientedBox & Mesh::oriented_box() const
 {
-    draw_mode_[1] ? draw_mode_[1] = false : draw_mode_[1] = true;
+    return oriented_box_;
 }
 
-void Mesh::toogle_bounding_box()
+const BoundingSphere & Mesh::tight_sphere() const
 {
-    draw_mode_[2] ? draw_mode_[2] = false : draw_mode_[2] = true;
+    return tight_sphere_;
+}
+
+PointBounds Mesh::world_bounds(const mat4 & t) const
+{
+    return point_bounds(v_, v_number_, t);
+}
+
+int Mesh::lod_faces(int level) const
+{
+    return level == 0 ? f_number_ : levels_[level].f_number;
+}
+
+const string & Mesh::name() const
+{
+    return name_;
+}
+
+const MemoryAccount & Mesh::memory() const
+{
+    return memory_;
+}
+
+void Mesh::memory_report()
+{
+    memory_.print(cout, name_);
+}
+
+const LoadStats & Mesh::load_stats() const
+{
+    return load_stats_;
+}
+
+int Mesh::lines_number(int level) const
+{
+    const Geometry & g = levels_[level];
+
+    if (wireframe == Wireframe::polygons)
+        return lod_faces(level) * 3;
+    if (wireframe == Wireframe::edges)
+        return level == 0 ? e_number_ : g.e_number;
+
+    return level == 0 ? fe_number_ : g.fe_number;
 }
 
 void Mesh::build_box(GLfloat box_limit[6]) {
@@ -302,28 +1651,66 @@ void Mesh::build_box(GLfloat box_limit[6]) {
             y_min = box_limit[2] - 0.05, y_max = box_limit[3] + 0.05,
             z_min = box_limit[4] - 0.05, z_max = box_limit[5] + 0.05;
 
-    bounding_box_[0]  = vec3(x_min, y_min, z_min);
-    bounding_box_[1]  = vec3(x_max, y_min, z_min);
-    bounding_box_[2]  = vec3(x_min, y_min, z_max);
-    bounding_box_[3]  = vec3(x_max, y_min, z_max);
-    bounding_box_[4]  = vec3(x_min, y_max, z_min);
-    bounding_box_[5]  = vec3(x_max, y_max, z_min);
-    bounding_box_[6]  = vec3(x_min, y_max, z_max);
-    bounding_box_[7]  = vec3(x_max, y_max, z_max);
-    bounding_box_[8]  = vec3(x_min, y_min, z_min);
-    bounding_box_[9]  = vec3(x_min, y_max, z_min);
-    bounding_box_[10] = vec3(x_min, y_min, z_max);
-    bounding_box_[11] = vec3(x_min, y_max, z_max);
-    bounding_box_[12] = vec3(x_max, y_min, z_min);
-    bounding_box_[13] = vec3(x_max, y_max, z_min);
-    bounding_box_[14] = vec3(x_max, y_min, z_max);
-    bounding_box_[15] = vec3(x_max, y_max, z_max);
-    bounding_box_[16] = vec3(x_min, y_min, z_min);
-    bounding_box_[17] = vec3(x_min, y_min, z_max);
-    bounding_box_[18] = vec3(x_min, y_max, z_min);
-    bounding_box_[19] = vec3(x_min, y_max, z_max);
-    bounding_box_[20] = vec3(x_max, y_min, z_min);
-    bounding_box_[21] = vec3(x_max, y_min, z_max);
-    bounding_box_[22] = vec3(x_max, y_max, z_min);
-    bounding_box_[23] = vec3(x_max, y_max, z_max);
+    volume_lines_[0]  = vec3(x_min, y_min, z_min);
+    volume_lines_[1]  = vec3(x_max, y_min, z_min);
+    volume_lines_[2]  = vec3(x_min, y_min, z_max);
+    volume_lines_[3]  = vec3(x_max, y_min, z_max);
+    volume_lines_[4]  = vec3(x_min, y_max, z_min);
+    volume_lines_[5]  = vec3(x_max, y_max, z_min);
+    volume_lines_[6]  = vec3(x_min, y_max, z_max);
+    volume_lines_[7]  = vec3(x_max, y_max, z_max);
+    volume_lines_[8]  = vec3(x_min, y_min, z_min);
+    volume_lines_[9]  = vec3(x_min, y_max, z_min);
+    volume_lines_[10] = vec3(x_min, y_min, z_max);
+    volume_lines_[11] = vec3(x_min, y_max, z_max);
+    volume_lines_[12] = vec3(x_max, y_min, z_min);
+    volume_lines_[13] = vec3(x_max, y_max, z_min);
+    volume_lines_[14] = vec3(x_max, y_min, z_max);
+    volume_lines_[15] = vec3(x_max, y_max, z_max);
+    volume_lines_[16] = vec3(x_min, y_min, z_min);
+    volume_lines_[17] = vec3(x_min, y_min, z_max);
+    volume_lines_[18] = vec3(x_min, y_max, z_min);
+    volume_lines_[19] = vec3(x_min, y_max, z_max);
+    volume_lines_[20] = vec3(x_max, y_min, z_min);
+    volume_lines_[21] = vec3(x_max, y_min, z_max);
+    volume_lines_[22] = vec3(x_max, y_max, z_min);
+    volume_lines_[23] = vec3(x_max, y_max, z_max);
+
+    sphere_center_ = vec3(x_min + x_max, y_min + y_max, z_min + z_max) / 2;
+    sphere_radius_ =
+        length(vec3(x_max - x_min, y_max - y_min, z_max - z_min)) / 2;
+
+    // Oriented box: corners are numbered by the signs of their coordinates
+    // along the axes (bit k set for the positive side of axis k), every line
+    // joins corners differing in one bit
+    const OrientedBox & b = oriented_box_;
+    vec3 corner[8];
+
+    for (int i = 0; i < 8; i++) {
+        corner[i] = b.center;
+
+        for (int k = 0; k < 3; k++)
+            corner[i] += b.axis[k] * (i & 1 << k ? b.half[k] : -b.half[k]);
+    }
+
+    vec3 *line = volume_lines_ + 24;
+
+    for (int k = 0; k < 3; k++)
+        for (int i = 0; i < 8; i++)
+            if (!(i & 1 << k)) {
+                *line++ = corner[i];
+                *line++ = corner[i | 1 << k];
+            }
+
+    // Sphere: circles around the axes of the oriented box
+    const BoundingSphere & s = tight_sphere_;
+
+    for (int k = 0; k < 3; k++)
+        for (int i = 0; i < sphere_segments; i++) {
+            GLfloat angle = 2 * pi * i / sphere_segments;
+
+            *line++ = s.center + s.radius *
+                (cos(angle) * b.axis[(k + 1) % 3] +
+                sin(angle) * b.axis[(k + 2) % 3]);
+        }
 }
@@ -10,51 +10,229 @@
 #include "vec.hpp"
 #include "mat.hpp"
 #include "list.hpp"
+#include "geometry.hpp"
+#include "quantize.hpp"
+#include "normals.hpp"
+#include "edges.hpp"
+#include "load_stats.hpp"
+#include "memory_account.hpp"
+#include "bounds.hpp"
+#include "binary_mesh.hpp"
 
 class Mesh {
 
+public:
+
+    // Number of levels of detail, including the full one
+    static const int lod_levels = 4;
+
+    // Highest subdivision level
+    static const int max_subdivision = 5;
+
+    // Wireframe drawing: triangles in line polygon mode (inner edges are drawn
+    // twice), unique edges as lines, or feature edges only
+    enum class Wireframe {
+        polygons,
+        edges,
+        features
+    };
+
+    // Bounding volumes drawn with the bounding box flag: the bounding box,
+    // the oriented box, the sphere or all of them
+    enum class BoundingVolume {
+        box,
+        oriented_box,
+        sphere,
+        all
+    };
+
+private:
+
     //
     // Data
     //
 
-    // Faces and vertex normals (with respect to faces)
-    // Note: the size of f_ is 3 * f_number_ and vn_ is of 6 * f_number_
-    vec3 *f_, *vn_;
-    int f_number_;
+    // Vertices, faces (triplets of indices into v_) and vertex normals (one
+    // per vertex, null if the file has none)
+    // Note: the size of f_ is 3 * f_number_ and vn_ is of v_number_
+    vec3 *v_, *vn_;
+    GLuint *f_;
+    int v_number_, f_number_;
+
+    // Wireframe lines: e_number_ unique edges followed by fe_number_ feature
+    // edges (pairs of indices into v_)
+    GLuint *e_;
+    int e_number_, fe_number_;
+
+    // Subdivision level of v_ and f_ and the control mesh they are computed
+    // from: vertices, vertex normals (null if they are generated) and faces,
+    // corners of face i are control_f_[control_offset_[i]] ...
+    // control_f_[control_offset_[i + 1] - 1]. Triangle meshes (no
+    // control_offset_) are moved here when subdivided and back at level 0,
+    // files with other polygons keep them here from loading
+    int subdivision_;
+    vec3 *control_v_, *control_vn_;
+    GLuint *control_f_;
+    int *control_offset_;
+    int control_v_number_, control_f_number_;
+
+    // Simplified levels of detail, level 0 is the mesh itself (v_, f_)
+    Geometry levels_[lod_levels];
+    int lod_number_;            // Number of levels ready to be drawn
+
+    // Background job building levels_
+    struct LodJob;
+    LodJob *lod_job_;
+
+    // File name, used for reports
+    std::string name_;
+
+    // Statistics of the last load
+    LoadStats load_stats_;
+
+    // Memory of the arrays and buffers above
+    MemoryAccount memory_;
+
+    // Lines of the bounding volumes: the bounding box and the oriented box
+    // (12 lines each) followed by three circles of the sphere (line loops
+    // around its axes)
+    static const int sphere_segments = 32;
+    static const int volume_vertices = 48 + 3 * sphere_segments;
+
+    // Limits of the bounding box in local coordinates: x_min, x_max, y_min,
+    // y_max, z_min, z_max, and the lines of the bounding volumes
+    GLfloat box_limit_[6];
+    vec3 volume_lines_[volume_vertices];
+
+    // Tight bounds of the vertices in local coordinates
+    OrientedBox oriented_box_;
+    BoundingSphere tight_sphere_;
 
-    // Bounding box in local coordinates
-    vec3 bounding_box_[24];
+    // Bounding sphere in local coordinates used for levels of detail
+    // (encloses the bounding box)
+    vec3 sphere_center_;
+    GLfloat sphere_radius_;
 
     // Shader attributes: color is used for rendering all the parts of
     // geometry, that is edges, normals and bounding box, transform_loc_
     // represents the location of local transform 4 by 4 matrix
     GLuint color_;
 
-    // Array of colors, used as color scheme
-    ColorScheme colorscheme_;
+    // Main vertex buffer: vertices, bounding volumes, vertex normals and
+    // vertices of simplified levels; index buffer: faces of all the levels
+    GLuint mesh_vbo_, mesh_ebo_;
 
-    // Check wheter to render: vertex normals, face normals, bounding box
-    bool draw_mode_[3];
-
-    // Main vertex buffer: faces, bounding box and vertex normals
-    GLuint mesh_vbo_;
+    // Offsets of faces and lines of the levels in mesh_ebo_ (in indices)
+    int lod_offset_[lod_levels], line_offset_[lod_levels];
 
     GLuint local_transform_;
 
+    // Quantised layout: vertices are QVertex relative to quantization_
+    bool quantized_;
+    Quantization quantization_;
+
+    // Normal lines, built the first time they are drawn: octahedral normals
+    // of vertices (origins are in mesh_vbo_), centres of faces followed by
+    // octahedral normals of faces
+    GLuint vertex_normals_vbo_, face_normals_vbo_;
+
+    // Shader attributes used for dequantisation
+    GLuint position_offset_, position_scale_, normal_length_;
+
     //
     // Private functions
     //
 
-    // Build bounding box by 6 bounding planes
+    // Build bounding box by 6 bounding planes and the lines of the oriented
+    // box and the sphere
     void build_box(GLfloat box_limit[6]);
 
-    // Initialise mesh_vbo_
+    // Set box limits, the oriented box and the sphere to the vertices and
+    // build their lines, returns the centroid of the vertices
+    vec3 fit_box();
+
+    // Initialise mesh_vbo_ and mesh_ebo_, their size is kept in load_stats_
     void set_main_buffer();
 
+    // Put vertices to the bound vertex buffer at a given position (in
+    // vertices), converting them to the layout in use
+    void upload_vertices(int first, const vec3 *v, int n);
+
+    // Put indices shifted by shift to the bound index buffer at a given
+    // position (in indices)
+    void upload_indices(int first, const GLuint *indices, int n, GLuint shift);
+
+    // Find unique and feature edges of the mesh (level 0)
+    void build_wireframe();
+
+    // Quantisation box of all the levels and the bounding volumes
+    void build_quantization();
+
+    // Build normal buffers, drop them when geometry or layout changes
+    void build_vertex_normals();
+    void build_face_normals();
+    void release_normals();
+
+    // Draw n normal lines as instances of a two-vertex line, origins are at
+    // the start of origins_vbo (in the layout in use), normals at
+    // normals_offset (in bytes) of normals_vbo
+    void draw_normals(GLuint origins_vbo, GLuint normals_vbo,
+        GLintptr normals_offset, int n);
+
+    // Reorder faces and vertices (with their normals) for the vertex caches
+    void optimize();
+
+    // Normals of generate_normals() without touching GL
+    void compute_normals(GLfloat crease_angle, NormalWeight weight);
+
+    // Release the mesh with its levels and control mesh
+    void clear();
+
+    // Release the control mesh
+    void clear_control();
+
+    // Account the current sizes of the arrays (GL buffers are accounted when
+    // they are created)
+    void account_arrays();
+
+    // Read a binary STL or PLY file (name_) the way read_file() reads .obj
+    // files, returns false on failure
+    bool import_file(MeshFormat format);
+
+    // Last steps of reading a file, after bounds and normals: optimisation,
+    // the cache, the wireframe and accounting
+    void finish_read();
+
+    // Binary cache of the processed mesh, stored next to the mesh file
+    bool read_cache();
+    void write_cache();
+
+    // Start building simplified levels in background
+    void build_lods();
+
+    // Stop background job without waiting for the result
+    void cancel_lods();
+
+    // Take levels built by the background job, has to be called from GL thread
+    void finish_lods();
+
+    // Delete the joined background job
+    void release_lod_job();
+
 public:
 
+    // Flags of draw(): the mesh belongs to the active object, is drawn as a
+    // coarse proxy (the coarsest level, or the bounding box while levels are
+    // being built) and with its vertex normals, face normals (both skipped
+    // for proxies) and bounding box
+    static const unsigned int draw_active = 1;
+    static const unsigned int draw_proxy = 2;
+    static const unsigned int draw_vertex_normals = 4;
+    static const unsigned int draw_face_normals = 8;
+    static const unsigned int draw_bounding_box = 16;
+
+    // Centre of the vertices, the default pivot of objects
     vec3 pivot;
-    mat4 transformation;
 
     Mesh();
 
@@ -63,27 +241,138 @@ public:
 
     ~Mesh();
 
-    // Read .obj file (works only with triangles)
+    // Read a mesh file and upload it, polygons are split into triangles.
+    // Files are .obj, binary STL (corners are welded into shared vertices)
+    // or binary PLY, by their first bytes or extension (see binary_mesh.hpp)
     void load_file(const char *obj_file);
 
-    // Set colorscheme defined in colorscheme.hpp
-    void set_colorscheme(const ColorScheme & colorscheme);
+    // Read a mesh file without touching GL, returns false on failure
+    bool read_file(const char *obj_file);
+
+    // Upload a mesh made by read_file() or set_geometry() and start building
+    // its levels of detail, has to be called from GL thread
+    void upload();
+
+    // Take vertices and faces of geometry without touching GL, normals are
+    // generated with a given crease angle (in degrees); name is used for
+    // reports
+    void set_geometry(Geometry && geometry, const std::string & name,
+        GLfloat crease);
+
+    // Replace vertex normals by normals computed from faces, vertices on
+    // creases sharper than crease_angle (in degrees) are split; uploaded
+    // meshes are uploaded again
+    void generate_normals(GLfloat crease_angle,
+        NormalWeight weight = NormalWeight::angle);
+
+    // Replace the mesh by its subdivision surface of a given level (0 is the
+    // mesh as read): Loop for triangle meshes, Catmull-Clark for files with
+    // other polygons; normals are generated, the wireframe shows edges of the
+    // quads. Uploaded meshes are uploaded again and their levels of detail
+    // rebuilt
+    void set_subdivision(int level);
+    int subdivision() const;
 
     // Set shader attribute locations
 
     void set_attributes(GLuint color_location, GLuint local_transform);
 
-    // Render geometry
-    void draw();
+    void set_dequantization(GLuint position_offset, GLuint position_scale,
+        GLuint normal_length);
+
+    // Render a level of detail with a model transformation, colors of a
+    // color scheme (see colorscheme.hpp) and draw flags; levels that aren't
+    // built yet fall back to the mesh
+    void draw(const mat4 & transformation, const vec4 *colorscheme,
+        unsigned int flags, int level);
+
+    // Level of detail for the projected radius of the bounding sphere (in
+    // pixels)
+    int select_lod(GLfloat radius) const;
+
+    // Bounding sphere in local coordinates
+    const vec3 & sphere_center() const;
+    GLfloat sphere_radius() const;
+
+    // Corners of the bounding box in local coordinates
+    const vec3 & box_min() const;
+    const vec3 & box_max() const;
+
+    // Tight oriented box and sphere of the vertices in local coordinates
+    const OrientedBox & oriented_box() const;
+    const BoundingSphere & tight_sphere() const;
+
+    // Bounding box and centroid of the vertices transformed by t, one pass
+    // over the vertices; tighter than the transformed box for rotations
+    PointBounds world_bounds(const mat4 & t) const;
+
+    // Number of triangles of a level
+    int lod_faces(int level) const;
+
+    // File name or the name given to set_geometry()
+    const std::string & name() const;
+
+    // Sizes and time of every phase of the last load_file(), read_file() or
+    // set_geometry() (the last two don't upload)
+    const LoadStats & load_stats() const;
+
+    // Print sizes of the float and quantised vertex buffers and quantisation
+    // errors, doesn't need GL
+    void footprint_report();
+
+    // Print time of normal generation, smooth and with creases (vertices are
+    // split), doesn't need GL
+    void normals_report();
+
+    // Print numbers of lines of the wireframe modes and the time of finding
+    // edges, doesn't need GL
+    void wireframe_report();
+
+    // Print time and size of half-edge connectivity and the numbers of
+    // boundary and non-manifold elements, doesn't need GL
+    void topology_report();
+
+    // Print time and size of every subdivision level, doesn't need GL
+    void subdivision_report();
+
+    // Memory of the mesh by category: current and peak bytes
+    const MemoryAccount & memory() const;
+
+    // Print memory of the mesh, current and peak KB of every category
+    void memory_report();
+
+    // Number of lines drawn for the wireframe of a level
+    int lines_number(int level) const;
+
+    // Wait for the levels of detail being built and take them, has to be
+    // called from GL thread
+    void wait_lods();
+
+    // Screen area (in pixels) per triangle, levels are chosen to not exceed
+    // this density
+    static GLfloat lod_pixels_per_triangle;
+
+    // Optimise vertex cache usage of loaded meshes, processed meshes are
+    // kept in binary cache files (file.obj.mcache, file.stl.mcache ...) unless
+    // use_cache is false
+    static bool optimize_on_load;
+    static bool use_cache;
+
+    // Wireframe mode of all the meshes and angle (in degrees) between faces
+    // above which their edge is a feature edge
+    static Wireframe wireframe;
+    static GLfloat feature_angle;
 
-    // Toogle rendering of dfferent elements
-    void toogle_vertex_normals();
-    void toogle_face_normals();
-    void toogle_bounding_box();
+    // Bounding volumes drawn for all the meshes
+    static BoundingVolume bounding_volume;
 
-    // Model transformation
+    // Crease angle (in degrees) of normals generated for files without them,
+    // 180 keeps all the normals smooth
+    static GLfloat crease_angle;
 
-    bool active;
+    // Upload vertices in quantised layout (16-bit positions relative to the
+    // bounding box, 6 bytes per vertex)
+    static bool quantize_vertices;
 };
 
 #endif
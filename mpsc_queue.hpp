@@ -0,0 +1,105 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+
+// Unbounded lock-free queue of many producers and a single consumer: any
+// thread may push, only one thread pops. Elements are kept in a linked list
+// of nodes, producers append to its end with one atomic exchange, so they
+// never wait for each other or for the consumer. The first node is a dummy
+// one (its element was popped already), the consumer moves it forward
+template <class D>
+class MpscQueue {
+
+private:
+
+    struct Node {
+        std::atomic<Node *> next;
+        D value;
+
+        Node() : next(0) {}
+        Node(const D & x) : next(0), value(x) {}
+    };
+
+    std::atomic<Node *> last_;          // Changed by producers
+    Node *first_;                       // Owned by the consumer
+
+public:
+
+    MpscQueue();
+    ~MpscQueue();
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue & operator = (const MpscQueue &) = delete;
+
+    //
+    // Methods
+    //
+
+    // Add element to the end, from any thread; allocates a node
+    void push(const D & x);
+
+    // Take the first element, from the consumer thread only; returns false if
+    // the queue is empty. An element being pushed meanwhile may be seen by
+    // the next call only
+    bool pop(D & x);
+
+    // Whether pop() would return false, from the consumer thread only
+    bool empty() const;
+};
+
+//
+// Implementation
+//
+
+template <class D>
+MpscQueue<D>::MpscQueue()
+{
+    first_ = new Node;
+    last_.store(first_);
+}
+
+template <class D>
+MpscQueue<D>::~MpscQueue()
+{
+    while (first_ != 0) {
+        Node *next = first_ -> next.load();
+        delete first_;
+        first_ = next;
+    }
+}
+
+template <class D>
+void MpscQueue<D>::push(const D & x)
+{
+    Node *node = new Node(x);
+
+    // The node is linked after it becomes the last one, until then the
+    // consumer stops before it
+    Node *previous = last_.exchange(node, std::memory_order_acq_rel);
+    previous -> next.store(node, std::memory_order_release);
+}
+
+template <class D>
+bool MpscQueue<D>::pop(D & x)
+{
+    Node *next = first_ -> next.load(std::memory_order_acquire);
+
+    if (next == 0)
+        return false;
+
+    x = next -> value;
+
+    delete first_;
+    first_ = next;
+
+    return true;
+}
+
+template <class D>
+bool MpscQueue<D>::empty() const
+{
+    return first_ -> next.load(std::memory_order_acquire) == 0;
+}
+
+#endif
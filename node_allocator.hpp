@@ -0,0 +1,235 @@
+#ifndef NODE_ALLOCATOR_HPP
+#define NODE_ALLOCATOR_HPP
+
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Allocators of the nodes of linked lists (the Allocator of List<D,
+// Allocator>) give memory for one node of type T at a time, the list
+// constructs and destroys the nodes. Allocators that release all their nodes
+// at once (release_all) let a list be cleared without walking it
+
+// Every node is allocated and freed on the heap
+template <class T>
+class HeapNodes {
+
+public:
+
+    static const bool release_all = false;
+
+    T * allocate();
+    void free(T *node);
+
+    // Nothing, nodes are freed one by one
+    void release();
+
+    // Size of the nodes in bytes
+    long long bytes(long long nodes) const;
+};
+
+// Bump allocator: nodes are cut from blocks one after another and freed
+// nodes aren't reused, all of them are released together. Blocks double in
+// size up to max_block nodes, so short lists take little memory and long ones
+// a few blocks per million nodes
+template <class T>
+class NodeArena {
+
+protected:
+
+    // Memory of a node, or the next free node of a pool
+    union Slot {
+        Slot *next;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type node;
+    };
+
+    static const int first_block = 16;
+    static const int max_block = 1 << 16;
+
+    std::vector<Slot *> blocks_;
+    Slot *position_, *end_;             // Free part of the last block
+    long long slots_;                   // Nodes of all the blocks
+
+    // Add a block, twice the size of the last one
+    void grow();
+
+public:
+
+    static const bool release_all = true;
+
+    NodeArena();
+    NodeArena(NodeArena && arena);
+    ~NodeArena();
+
+    NodeArena(const NodeArena &) = delete;
+    NodeArena & operator = (const NodeArena &) = delete;
+
+    T * allocate();
+
+    // Nothing, the node is released with the others
+    void free(T *node);
+
+    // Free the blocks, O(number of blocks)
+    void release();
+
+    // Size of the blocks in bytes
+    long long bytes(long long nodes) const;
+};
+
+// Arena that reuses freed nodes: they are kept in a list of free nodes
+template <class T>
+class NodePool : public NodeArena<T> {
+
+    typedef typename NodeArena<T>::Slot Slot;
+
+    Slot *free_;                        // Freed nodes
+
+public:
+
+    NodePool();
+    NodePool(NodePool && pool);
+
+    T * allocate();
+
+    // The node is reused by the next allocate()
+    void free(T *node);
+
+    void release();
+};
+
+//
+// Implementation
+//
+
+template <class T>
+T * HeapNodes<T>::allocate()
+{
+    return static_cast<T *>(::operator new(sizeof(T)));
+}
+
+template <class T>
+void HeapNodes<T>::free(T *node)
+{
+    ::operator delete(node);
+}
+
+template <class T>
+void HeapNodes<T>::release()
+{
+}
+
+template <class T>
+long long HeapNodes<T>::bytes(long long nodes) const
+{
+    return nodes * sizeof(T);
+}
+
+template <class T>
+NodeArena<T>::NodeArena() : position_(0), end_(0), slots_(0)
+{
+}
+
+template <class T>
+NodeArena<T>::NodeArena(NodeArena && arena) :
+    blocks_(std::move(arena.blocks_)), position_(arena.position_),
+    end_(arena.end_), slots_(arena.slots_)
+{
+    arena.blocks_.clear();
+    arena.position_ = arena.end_ = 0;
+    arena.slots_ = 0;
+}
+
+template <class T>
+NodeArena<T>::~NodeArena()
+{
+    release();
+}
+
+template <class T>
+void NodeArena<T>::grow()
+{
+    long long size = blocks_.empty() ? first_block : 2 * (end_ -
+        blocks_.back());
+
+    if (size > max_block)
+        size = max_block;
+
+    blocks_.push_back(new Slot[size]);
+    position_ = blocks_.back();
+    end_ = position_ + size;
+    slots_ += size;
+}
+
+template <class T>
+T * NodeArena<T>::allocate()
+{
+    if (position_ == end_)
+        grow();
+
+    return reinterpret_cast<T *>(&(position_++) -> node);
+}
+
+template <class T>
+void NodeArena<T>::free(T *)
+{
+}
+
+template <class T>
+void NodeArena<T>::release()
+{
+    for (unsigned int i = 0; i < blocks_.size(); i++)
+        delete[] blocks_[i];
+
+    blocks_.clear();
+    position_ = end_ = 0;
+    slots_ = 0;
+}
+
+template <class T>
+long long NodeArena<T>::bytes(long long) const
+{
+    return slots_ * sizeof(Slot);
+}
+
+template <class T>
+NodePool<T>::NodePool() : free_(0)
+{
+}
+
+template <class T>
+NodePool<T>::NodePool(NodePool && pool) :
+    NodeArena<T>(std::move(pool)), free_(pool.free_)
+{
+    pool.free_ = 0;
+}
+
+template <class T>
+T * NodePool<T>::allocate()
+{
+    if (free_ == 0)
+        return NodeArena<T>::allocate();
+
+    Slot *slot = free_;
+    free_ = slot -> next;
+
+    return reinterpret_cast<T *>(&slot -> node);
+}
+
+template <class T>
+void NodePool<T>::free(T *node)
+{
+    Slot *slot = reinterpret_cast<Slot *>(node);
+
+    slot -> next = free_;
+    free_ = slot;
+}
+
+template <class T>
+void NodePool<T>::release()
+{
+    NodeArena<T>::release();
+    free_ = 0;
+}
+
+#endif
@@ -0,0 +1,321 @@
+#include "normals.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <vector>
+
+// At most this many arrays of vertex normal sums, whatever the number of
+// threads: each is as large as the vertex normals
+const int max_normal_sums = 4;
+
+// Angle between two vectors given their inner product and lengths
+static inline GLfloat corner_angle(GLfloat dot, GLfloat a, GLfloat b)
+{
+    if (a == 0 || b == 0)
+        return 0;
+
+    GLfloat c = dot / (a * b);
+
+    return acos(c < -1 ? -1 : c > 1 ? 1 : c);
+}
+
+// Cross product of edges of a face (its length is twice the area) and weights
+// of the face at its corners: contribution of the face to the normal of its
+// k-th vertex is w[k] * c. Computed on components, this is the hot loop
+static inline void face_cross(const vec3 *v, const GLuint *f, int i,
+    NormalWeight weight, GLfloat c[3], GLfloat w[3])
+{
+    const vec3 & a = v[f[3 * i]], & b = v[f[3 * i + 1]], & d = v[f[3 * i + 2]];
+
+    GLfloat e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+    GLfloat e2[3] = { d.x - a.x, d.y - a.y, d.z - a.z };
+
+    c[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    c[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    c[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+    if (weight == NormalWeight::area) {
+        w[0] = w[1] = w[2] = 1;
+        return;
+    }
+
+    GLfloat l = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+
+    if (l == 0) {
+        w[0] = w[1] = w[2] = 0;
+        return;
+    }
+
+    GLfloat e3[3] = { d.x - b.x, d.y - b.y, d.z - b.z };
+
+    GLfloat l1 = sqrt(e1[0] * e1[0] + e1[1] * e1[1] + e1[2] * e1[2]);
+    GLfloat l2 = sqrt(e2[0] * e2[0] + e2[1] * e2[1] + e2[2] * e2[2]);
+    GLfloat l3 = sqrt(e3[0] * e3[0] + e3[1] * e3[1] + e3[2] * e3[2]);
+
+    GLfloat d12 = e1[0] * e2[0] + e1[1] * e2[1] + e1[2] * e2[2];
+    GLfloat d13 = e1[0] * e3[0] + e1[1] * e3[1] + e1[2] * e3[2];
+
+    // Angles of a non-degenerate triangle sum up to pi
+    GLfloat a0 = corner_angle(d12, l1, l2), a1 = corner_angle(-d13, l1, l3);
+    GLfloat a2 = pi - a0 - a1;
+
+    w[0] = a0 / l;
+    w[1] = a1 / l;
+    w[2] = (a2 > 0 ? a2 : 0) / l;
+}
+
+void face_normals(const vec3 *v, const GLuint *f, int f_number, vec3 *fn)
+{
+    parallel_for(f_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            GLfloat c[3], w[3];
+            face_cross(v, f, i, NormalWeight::area, c, w);
+
+            GLfloat l = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+
+            if (l > 0)
+                fn[i].x = c[0] / l, fn[i].y = c[1] / l, fn[i].z = c[2] / l;
+            else
+                fn[i].x = fn[i].y = fn[i].z = 0;
+        }
+    });
+}
+
+void vertex_normals(const vec3 *v, int v_number, const GLuint *f,
+    int f_number, vec3 *vn, NormalWeight weight)
+{
+    int sums = parallel_threads(f_number);
+
+    if (sums > max_normal_sums)
+        sums = max_normal_sums;
+
+    // Faces are split into sums ranges, every range accumulates to its own
+    // array: x, y, z for every vertex
+    GLfloat *sum = new GLfloat[(size_t) sums * v_number * 3];
+
+    parallel_for(sums, [&](int first, int last, int) {
+        for (int t = first; t < last; t++) {
+            GLfloat *s = sum + (size_t) t * v_number * 3;
+            int begin = (int) ((long long) f_number * t / sums);
+            int end = (int) ((long long) f_number * (t + 1) / sums);
+
+            for (size_t i = 0; i < (size_t) v_number * 3; i++)
+                s[i] = 0;
+
+            for (int i = begin; i < end; i++) {
+                GLfloat c[3], w[3];
+                face_cross(v, f, i, weight, c, w);
+
+                for (int k = 0; k < 3; k++) {
+                    GLfloat *p = s + (size_t) f[3 * i + k] * 3;
+
+                    p[0] += w[k] * c[0];
+                    p[1] += w[k] * c[1];
+                    p[2] += w[k] * c[2];
+                }
+            }
+        }
+    });
+
+    parallel_for(v_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            GLfloat n[3] = { 0, 0, 0 };
+
+            for (int t = 0; t < sums; t++) {
+                const GLfloat *p = sum + ((size_t) t * v_number + i) * 3;
+
+                n[0] += p[0], n[1] += p[1], n[2] += p[2];
+            }
+
+            GLfloat l = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            if (l > 0)
+                vn[i].x = n[0] / l, vn[i].y = n[1] / l, vn[i].z = n[2] / l;
+            else
+                vn[i].x = vn[i].y = vn[i].z = 0;
+        }
+    });
+
+    delete[] sum;
+}
+
+// Smoothed normal of the j-th of n faces around a vertex: sum of weighted
+// normals of the faces within the crease angle. Faces with equal sets of such
+// faces get equal sums, since they are added in the same order
+static inline void fan_normal(const GLfloat *unit, const GLfloat *weight,
+    int n, int j, GLfloat cos_crease, GLfloat normal[3])
+{
+    const GLfloat *a = unit + 3 * j;
+
+    // Degenerate faces are smoothed with everything
+    bool flat = a[0] == 0 && a[1] == 0 && a[2] == 0;
+
+    normal[0] = normal[1] = normal[2] = 0;
+
+    for (int k = 0; k < n; k++) {
+        const GLfloat *b = unit + 3 * k;
+
+        if (!flat && a[0] * b[0] + a[1] * b[1] + a[2] * b[2] < cos_crease &&
+            (b[0] != 0 || b[1] != 0 || b[2] != 0))
+            continue;
+
+        normal[0] += weight[k] * b[0];
+        normal[1] += weight[k] * b[1];
+        normal[2] += weight[k] * b[2];
+    }
+}
+
+int crease_normals(const vec3 *v, int v_number, GLuint *f, int f_number,
+    GLfloat crease_angle, NormalWeight weight, vec3 *&out_v, vec3 *&out_vn)
+{
+    GLfloat cos_crease = cos(crease_angle * pi / 180);
+
+    // Unit normals of faces and weights of corners: contribution of a face to
+    // the normal of its k-th vertex is corner_weight[3 * i + k] * unit normal
+    GLfloat *unit = new GLfloat[(size_t) f_number * 3];
+    GLfloat *corner_weight = new GLfloat[(size_t) f_number * 3];
+
+    parallel_for(f_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            GLfloat c[3], w[3];
+            face_cross(v, f, i, weight, c, w);
+
+            GLfloat l = sqrt(c[0] * c[0] + c[1] * c[1] + c[2] * c[2]);
+
+            for (int j = 0; j < 3; j++) {
+                unit[(size_t) 3 * i + j] = l > 0 ? c[j] / l : 0;
+                corner_weight[(size_t) 3 * i + j] = w[j] * l;
+            }
+        }
+    });
+
+    // Corners of every vertex: corner[offset[i]] ... corner[offset[i + 1] - 1]
+    int *offset = new int[v_number + 1];
+    int *corner = new int[f_number * 3];
+
+    for (int i = 0; i <= v_number; i++)
+        offset[i] = 0;
+    for (int i = 0; i < f_number * 3; i++)
+        offset[f[i] + 1]++;
+    for (int i = 0; i < v_number; i++)
+        offset[i + 1] += offset[i];
+
+    int *fill = new int[v_number];
+    for (int i = 0; i < v_number; i++)
+        fill[i] = offset[i];
+    for (int i = 0; i < f_number * 3; i++)
+        corner[fill[f[i]]++] = i;
+
+    delete[] fill;
+
+    // Faces around a vertex are copied together first, so the quadratic loops
+    // over them don't jump around memory
+    auto gather = [&](int i, std::vector<GLfloat> & fan_unit,
+        std::vector<GLfloat> & fan_weight) {
+        int valence = offset[i + 1] - offset[i];
+
+        fan_unit.resize(3 * valence);
+        fan_weight.resize(valence);
+
+        for (int j = 0; j < valence; j++) {
+            int c = corner[offset[i] + j];
+
+            for (int k = 0; k < 3; k++)
+                fan_unit[3 * j + k] = unit[(size_t) 3 * (c / 3) + k];
+            fan_weight[j] = corner_weight[c];
+        }
+
+        return valence;
+    };
+
+    // group[j] is the first corner (position in corner) with the same normal
+    // as corner[j], copies[i] the number of extra copies of vertex i
+    int *group = new int[f_number * 3];
+    int *copies = new int[v_number];
+
+    parallel_for(v_number, [&](int begin, int end, int) {
+        std::vector<GLfloat> fan_unit, fan_weight, n;
+
+        for (int i = begin; i < end; i++) {
+            int valence = gather(i, fan_unit, fan_weight);
+            n.resize(3 * valence);
+
+            copies[i] = valence > 0 ? -1 : 0;
+
+            for (int j = 0; j < valence; j++) {
+                GLfloat *nj = &n[3 * j];
+                fan_normal(&fan_unit[0], &fan_weight[0], valence, j,
+                    cos_crease, nj);
+
+                int first = j;
+                for (int k = 0; k < j && first == j; k++)
+                    if (n[3 * k] == nj[0] && n[3 * k + 1] == nj[1] &&
+                        n[3 * k + 2] == nj[2])
+                        first = group[offset[i] + k] - offset[i];
+
+                group[offset[i] + j] = offset[i] + first;
+
+                if (first == j)
+                    copies[i]++;
+            }
+        }
+    });
+
+    // Copies go after the original vertices, in the order of vertices
+    int total = v_number;
+
+    for (int i = 0; i < v_number; i++) {
+        int c = copies[i];
+        copies[i] = total;
+        total += c;
+    }
+
+    out_v = new vec3[total];
+    out_vn = new vec3[total];
+
+    parallel_for(v_number, [&](int begin, int end, int) {
+        std::vector<GLfloat> fan_unit, fan_weight;
+        std::vector<GLuint> index;
+
+        for (int i = begin; i < end; i++) {
+            int valence = gather(i, fan_unit, fan_weight);
+            int next = copies[i];
+
+            out_v[i] = v[i];
+            index.resize(valence);
+
+            for (int j = 0; j < valence; j++) {
+                int g = group[offset[i] + j] - offset[i];
+                GLuint target;
+
+                // First corner of a group gets the vertex or its next copy
+                if (g == j) {
+                    target = j == 0 ? i : next++;
+
+                    GLfloat n[3];
+                    fan_normal(&fan_unit[0], &fan_weight[0], valence, j,
+                        cos_crease, n);
+
+                    GLfloat l = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                    out_v[target] = v[i];
+                    out_vn[target] = l > 0 ?
+                        vec3(n[0] / l, n[1] / l, n[2] / l) : vec3(0);
+                } else
+                    target = index[g];
+
+                index[j] = target;
+                f[corner[offset[i] + j]] = target;
+            }
+        }
+    });
+
+    delete[] unit;
+    delete[] corner_weight;
+    delete[] offset;
+    delete[] corner;
+    delete[] group;
+    delete[] copies;
+
+    return total;
+}
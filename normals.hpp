@@ -0,0 +1,31 @@
+#ifndef NORMALS_HPP
+#define NORMALS_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+
+// Weighting of face normals in vertex normals: by face area or by the angle
+// of the face at the vertex
+enum class NormalWeight {
+    area,
+    angle
+};
+
+// Unit normals of faces, zero for degenerate faces
+void face_normals(const vec3 *v, const GLuint *f, int f_number, vec3 *fn);
+
+// Smooth unit vertex normals, zero for unused vertices. Faces are split
+// into at most 4 ranges, every range accumulates to its own array and the
+// arrays are summed up by all the threads afterwards
+void vertex_normals(const vec3 *v, int v_number, const GLuint *f,
+    int f_number, vec3 *vn, NormalWeight weight);
+
+// Vertex normals with creases: faces around a vertex are smoothed together
+// only if their normals differ by at most crease_angle (in degrees), every
+// other set of faces gets its own copy of the vertex. out_v and out_vn are
+// allocated with new[], f is updated to the copies; returns the number of
+// vertices in out_v
+int crease_normals(const vec3 *v, int v_number, GLuint *f, int f_number,
+    GLfloat crease_angle, NormalWeight weight, vec3 *&out_v, vec3 *&out_vn);
+
+#endif
@@ -0,0 +1,192 @@
+#include "obj_writer.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Lines formatted at once and the longest line: "v" and three floats of up
+// to 21 characters, or "f" and three indices of up to 19 digits
+const int block_lines = 1 << 16;
+const int max_line = 72;
+
+char *write_integer(char *p, long long x)
+{
+    if (x < 0)
+        *p++ = '-', x = -x;
+
+    char digits[20];
+    int n = 0;
+
+    do
+        digits[n++] = '0' + x % 10, x /= 10;
+    while (x != 0);
+
+    while (n > 0)
+        *p++ = digits[--n];
+
+    return p;
+}
+
+char *write_float(char *p, GLfloat x)
+{
+    long long fixed = llround(fabs((double) x) * 1000000);
+
+    if (fixed == 0) {
+        *p++ = '0';
+        return p;
+    }
+
+    if (x < 0)
+        *p++ = '-';
+
+    p = write_integer(p, fixed / 1000000);
+
+    // Decimals without trailing zeros
+    int fraction = fixed % 1000000, digits = 6;
+
+    if (fraction == 0)
+        return p;
+
+    while (fraction % 10 == 0)
+        fraction /= 10, digits--;
+
+    *p++ = '.';
+    for (int i = digits - 1; i >= 0; i--)
+        p[i] = '0' + fraction % 10, fraction /= 10;
+
+    return p + digits;
+}
+
+ObjWriter::ObjWriter()
+{
+    file_ = 0;
+    buffer_ = 0;
+    first_ = 0;
+    v_number_ = f_number_ = bytes_ = 0;
+}
+
+ObjWriter::~ObjWriter()
+{
+    close();
+}
+
+bool ObjWriter::open(const char *obj_file)
+{
+    close();
+
+    file_ = fopen(obj_file, "wb");
+
+    if (file_ == 0) {
+        cout << "Can't write " << obj_file << endl;
+        return false;
+    }
+
+    name_ = obj_file;
+    buffer_ = new char[(size_t) block_lines * max_line];
+    first_ = 0;
+    v_number_ = f_number_ = bytes_ = 0;
+
+    return true;
+}
+
+bool ObjWriter::close()
+{
+    if (file_ == 0)
+        return true;
+
+    bool good = ferror(file_) == 0;
+    good = fclose(file_) == 0 && good;
+
+    if (!good)
+        cout << "Failed to write " << name_ << endl;
+
+    delete[] buffer_;
+    file_ = 0;
+    buffer_ = 0;
+
+    return good;
+}
+
+template <class F>
+void ObjWriter::write_lines(int n, F format)
+{
+    vector<char *> end(parallel_threads(block_lines));
+
+    for (int block = 0; block < n; block += block_lines) {
+        int lines = n - block < block_lines ? n - block : block_lines;
+
+        // Every thread formats its range at the position of its first line
+        parallel_for(lines, [&](int begin, int stop, int t) {
+            char *p = buffer_ + (size_t) begin * max_line;
+
+            for (int i = begin; i < stop; i++)
+                p = format(p, block + i);
+
+            end[t] = p;
+        });
+
+        int used = parallel_threads(lines);
+
+        for (int t = 0; t < used; t++) {
+            char *start = buffer_ + (size_t) lines * t / used * max_line;
+
+            fwrite(start, 1, end[t] - start, file_);
+            bytes_ += end[t] - start;
+        }
+    }
+}
+
+void ObjWriter::comment(const string & text)
+{
+    string line = "# " + text + "\n";
+
+    fwrite(line.data(), 1, line.size(), file_);
+    bytes_ += line.size();
+}
+
+void ObjWriter::object(const string & name)
+{
+    string line = "o " + name + "\n";
+
+    fwrite(line.data(), 1, line.size(), file_);
+    bytes_ += line.size();
+}
+
+void ObjWriter::write_vertices(const vec3 *v, int n,
+    const mat4 & transformation)
+{
+    write_lines(n, [&](char *p, int i) {
+        vec3 u = transformation * v[i];
+
+        *p++ = 'v';
+        for (int k = 0; k < 3; k++) {
+            *p++ = ' ';
+            p = write_float(p, u[k]);
+        }
+        *p++ = '\n';
+
+        return p;
+    });
+
+    first_ = v_number_;
+    v_number_ += n;
+}
+
+void ObjWriter::write_faces(const GLuint *f, int n)
+{
+    write_lines(n, [&](char *p, int i) {
+        *p++ = 'f';
+        for (int k = 0; k < 3; k++) {
+            *p++ = ' ';
+            p = write_integer(p, first_ + f[3 * i + k] + 1);
+        }
+        *p++ = '\n';
+
+        return p;
+    });
+
+    f_number_ += n;
+}
@@ -0,0 +1,67 @@
+#ifndef OBJ_WRITER_HPP
+#define OBJ_WRITER_HPP
+
+#include <cstdio>
+#include <string>
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+#include "mat.hpp"
+
+// Formatted-number writers: put the number at p and return the end of it (no
+// terminating zero). Floats are fixed point with up to 6 decimals and have to
+// be below 1e12 in magnitude
+char *write_integer(char *p, long long x);
+char *write_float(char *p, GLfloat x);
+
+// Streaming .obj output of any size: lines are formatted by the writers above
+// in parallel into a buffer that is written in large blocks, nothing else is
+// kept. Faces index the vertices of the last write_vertices() call
+class ObjWriter {
+
+    FILE *file_;
+    std::string name_;
+
+    // Lines of a block, every one takes at most max_line characters
+    char *buffer_;
+
+    // Index of the first vertex of the last write_vertices() call
+    long long first_;
+
+    long long v_number_, f_number_, bytes_;
+
+    // Format n lines by format(p, i), which puts line i at p and returns its
+    // end, and write them
+    template <class F>
+    void write_lines(int n, F format);
+
+public:
+
+    ObjWriter();
+    ~ObjWriter();
+
+    ObjWriter(const ObjWriter &) = delete;
+    ObjWriter & operator = (const ObjWriter &) = delete;
+
+    // Start a new file, returns false if it can't be created
+    bool open(const char *obj_file);
+
+    // Finish the file, returns false if anything failed to be written
+    bool close();
+
+    void comment(const std::string & text);
+    void object(const std::string & name);
+
+    // Vertices are transformed on the way
+    void write_vertices(const vec3 *v, int n,
+        const mat4 & transformation = mat4(1));
+
+    // Triplets of indices into the last vertices written
+    void write_faces(const GLuint *f, int n);
+
+    long long vertices() const { return v_number_; }
+    long long faces() const { return f_number_; }
+    long long bytes() const { return bytes_; }
+};
+
+#endif
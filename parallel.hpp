@@ -0,0 +1,90 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include "jobs.hpp"
+
+// Number of ranges parallel_for splits n items into: one per thread of the
+// job system (see jobs.hpp)
+inline int parallel_threads(int n)
+{
+    int threads = job_threads();
+
+    if (threads > n)
+        threads = n > 1 ? n : 1;
+
+    return threads;
+}
+
+// Ranges [begin, end) of a parallel loop over items, split in halves (the
+// second one is a job on the stack) down to grain items; halves of grain
+// items are bounded jobs if bounded is set
+template <class F>
+struct ParallelRange {
+    F *body;
+    int begin, end, grain;
+    bool bounded;
+
+    void run() const
+    {
+        if (end - begin <= grain) {
+            (*body)(begin, end);
+            return;
+        }
+
+        int middle = begin + (end - begin) / 2;
+        ParallelRange second = { body, middle, end, grain, bounded };
+        ParallelRange first = { body, begin, middle, grain, bounded };
+
+        Job job([&second]() { second.run(); },
+            bounded && end - middle <= grain);
+        job.submit();
+
+        first.run();
+        job.wait();
+    }
+};
+
+// Call body(begin, end) for ranges of at most grain items covering [0, n),
+// split among the threads by work stealing: idle threads take the largest
+// ranges left. Returns when all of them are done. Doesn't allocate memory,
+// and loops of up to grain items run on the calling thread at once
+template <class F>
+void parallel_for(int n, int grain, F body)
+{
+    if (grain < 1)
+        grain = 1;
+
+    if (n <= grain || job_threads() == 1) {
+        if (n > 0)
+            body(0, n);
+        return;
+    }
+
+    ParallelRange<F> range = { &body, 0, n, grain, true };
+    range.run();
+}
+
+// Split [0, n) into parallel_threads(n) contiguous ranges and call
+// body(begin, end, t) for the t-th range; returns when all of them are done.
+// The ranges aren't bounded jobs, threads that aren't workers don't steal them
+template <class F>
+void parallel_for(int n, F body)
+{
+    int threads = parallel_threads(n);
+
+    auto ranges = [&](int first, int last) {
+        for (int t = first; t < last; t++)
+            body((int) ((long long) n * t / threads),
+                (int) ((long long) n * (t + 1) / threads), t);
+    };
+
+    if (threads == 1) {
+        ranges(0, 1);
+        return;
+    }
+
+    ParallelRange<decltype(ranges)> range = { &ranges, 0, threads, 1, false };
+    range.run();
+}
+
+#endif
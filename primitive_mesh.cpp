@@ -0,0 +1,17 @@
+#include "primitive_mesh.hpp"
+
+using namespace std;
+
+// Crease angle (in degrees) of shapes with flat faces
+const GLfloat primitive_crease = 60;
+
+PrimitiveMesh::PrimitiveMesh(Primitive shape, int resolution)
+{
+    Geometry g;
+    make_primitive(g, shape, resolution);
+
+    bool flat = shape == Primitive::box || shape == Primitive::cylinder;
+
+    set_geometry(move(g), string(primitive_names[(int) shape]) + " " +
+        to_string(resolution), flat ? primitive_crease : 180);
+}
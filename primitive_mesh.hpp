@@ -0,0 +1,17 @@
+#ifndef PRIMITIVE_MESH_HPP
+#define PRIMITIVE_MESH_HPP
+
+#include "mesh.hpp"
+#include "primitives.hpp"
+
+// Mesh generated instead of read from a file (see primitives.hpp). Flat
+// shapes (box, cylinder) get their edges creased, the others smooth normals.
+// Doesn't touch GL, copies of it are uploaded like other meshes
+class PrimitiveMesh : public Mesh {
+
+public:
+
+    PrimitiveMesh(Primitive shape, int resolution);
+};
+
+#endif
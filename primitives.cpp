@@ -0,0 +1,368 @@
+#include "primitives.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+#include <cstring>
+
+const char *primitive_names[primitive_shapes] = {
+    "icosphere", "uv_sphere", "box", "cylinder", "torus", "grid"
+};
+
+// Two triangles of a quad with corners in counter-clockwise order
+static inline void quad(GLuint *f, GLuint a, GLuint b, GLuint c, GLuint d)
+{
+    f[0] = a, f[1] = b, f[2] = c;
+    f[3] = a, f[4] = c, f[5] = d;
+}
+
+// Quads between two closed rows of n vertices: seen from outside, the row
+// starting at upper is above the one at lower and indices grow to the left
+static void band(GLuint *f, GLuint upper, GLuint lower, int n)
+{
+    for (int i = 0; i < n; i++) {
+        GLuint next = (i + 1) % n;
+
+        quad(f + 6 * i, upper + i, upper + next, lower + next, lower + i);
+    }
+}
+
+// Cosines and sines of n angles around the circle
+static void circle(int n, GLfloat *&c, GLfloat *&s)
+{
+    c = new GLfloat[n];
+    s = new GLfloat[n];
+
+    for (int i = 0; i < n; i++) {
+        c[i] = cos(2 * pi * i / n);
+        s[i] = sin(2 * pi * i / n);
+    }
+}
+
+void icosphere(vec3 *v, GLuint *f, int levels, GLfloat radius)
+{
+    const GLfloat t = (1 + sqrt(5.0)) / 2;
+
+    const vec3 icosahedron_v[12] = {
+        vec3(-1,  t,  0), vec3( 1,  t,  0), vec3(-1, -t,  0), vec3( 1, -t,  0),
+        vec3( 0, -1,  t), vec3( 0,  1,  t), vec3( 0, -1, -t), vec3( 0,  1, -t),
+        vec3( t,  0, -1), vec3( t,  0,  1), vec3(-t,  0, -1), vec3(-t,  0,  1)
+    };
+    const GLuint icosahedron_f[60] = {
+        0, 11,  5,   0,  5,  1,   0,  1,  7,   0,  7, 10,   0, 10, 11,
+        1,  5,  9,   5, 11,  4,  11, 10,  2,  10,  7,  6,   7,  1,  8,
+        3,  9,  4,   3,  4,  2,   3,  2,  6,   3,  6,  8,   3,  8,  9,
+        4,  9,  5,   2,  4, 11,   6,  2, 10,   8,  6,  7,   9,  8,  1
+    };
+
+    for (int i = 0; i < 12; i++)
+        v[i] = normalize(icosahedron_v[i]) * radius;
+    for (int i = 0; i < 60; i++)
+        f[i] = icosahedron_f[i];
+
+    if (levels == 0)
+        return;
+
+    // Midpoints of the edges of a level, kept by their lower vertex: every
+    // vertex has at most 6 neighbours
+    int cached = icosphere_vertices(levels - 1);
+    GLuint *neighbour = new GLuint[6 * cached];
+    GLuint *midpoint = new GLuint[6 * cached];
+    unsigned char *count = new unsigned char[cached];
+
+    GLuint n = 12;
+
+    auto split = [&](GLuint a, GLuint b) {
+        GLuint low = a < b ? a : b, high = a < b ? b : a;
+        GLuint *slot = neighbour + 6 * low;
+
+        for (int k = 0; k < count[low]; k++)
+            if (slot[k] == high)
+                return midpoint[6 * low + k];
+
+        slot[count[low]] = high;
+        midpoint[6 * low + count[low]++] = n;
+
+        v[n] = normalize(v[a] + v[b]) * radius;
+
+        return n++;
+    };
+
+    for (int l = 0; l < levels; l++) {
+        memset(count, 0, n);
+
+        // Children of face i are faces 4 * i ... 4 * i + 3, going backwards
+        // overwrites only faces that are already split
+        for (int i = icosphere_faces(l) - 1; i >= 0; i--) {
+            GLuint a = f[3 * i], b = f[3 * i + 1], c = f[3 * i + 2];
+            GLuint ab = split(a, b), bc = split(b, c), ca = split(c, a);
+            GLuint *child = f + 12 * i;
+
+            child[0] = a,  child[1]  = ab, child[2]  = ca;
+            child[3] = ab, child[4]  = b,  child[5]  = bc;
+            child[6] = ca, child[7]  = bc, child[8]  = c;
+            child[9] = ab, child[10] = bc, child[11] = ca;
+        }
+    }
+
+    delete[] neighbour;
+    delete[] midpoint;
+    delete[] count;
+}
+
+void uv_sphere(vec3 *v, GLuint *f, int slices, int stacks, GLfloat radius)
+{
+    GLfloat *c, *s;
+    circle(slices, c, s);
+
+    // Poles and rows of slices vertices between them, from the top
+    int south = uv_sphere_vertices(slices, stacks) - 1;
+
+    v[0] = vec3(0, radius, 0);
+    v[south] = vec3(0, -radius, 0);
+
+    parallel_for(stacks - 1, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++) {
+            GLfloat phi = pi * (j + 1) / stacks;
+            GLfloat y = radius * cos(phi), r = radius * sin(phi);
+            vec3 *row = v + 1 + j * slices;
+
+            for (int i = 0; i < slices; i++)
+                row[i] = vec3(r * c[i], y, r * s[i]);
+        }
+    });
+
+    // Caps around the poles, bands between the rows
+    GLuint *bottom = f + 3 * (uv_sphere_faces(slices, stacks) - slices);
+
+    for (int i = 0; i < slices; i++) {
+        GLuint next = (i + 1) % slices;
+        GLuint last = south - slices;
+
+        f[3 * i] = 0, f[3 * i + 1] = 1 + next, f[3 * i + 2] = 1 + i;
+        bottom[3 * i] = last + i, bottom[3 * i + 1] = last + next;
+        bottom[3 * i + 2] = south;
+    }
+
+    parallel_for(stacks - 2, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++)
+            band(f + 3 * slices + 6 * slices * j, 1 + j * slices,
+                1 + (j + 1) * slices, slices);
+    });
+
+    delete[] c;
+    delete[] s;
+}
+
+void box(vec3 *v, GLuint *f, const vec3 & size)
+{
+    // Bits of corner i choose the maximal x, y and z
+    for (int i = 0; i < box_vertices; i++)
+        v[i] = vec3(i & 1 ? size.x : -size.x, i & 2 ? size.y : -size.y,
+            i & 4 ? size.z : -size.z) / 2;
+
+    // -x, +x, -y, +y, -z, +z
+    const GLuint box_f[3 * box_faces] = {
+        0, 4, 6,   0, 6, 2,   5, 1, 3,   5, 3, 7,   0, 1, 5,   0, 5, 4,
+        6, 7, 3,   6, 3, 2,   1, 0, 2,   1, 2, 3,   4, 5, 7,   4, 7, 6
+    };
+
+    for (int i = 0; i < 3 * box_faces; i++)
+        f[i] = box_f[i];
+}
+
+void cylinder(vec3 *v, GLuint *f, int slices, int stacks, GLfloat radius,
+    GLfloat height)
+{
+    GLfloat *c, *s;
+    circle(slices, c, s);
+
+    // Rows of the side from the top, centres of the caps
+    int top = slices * (stacks + 1), bottom = top + 1;
+
+    v[top] = vec3(0, height / 2, 0);
+    v[bottom] = vec3(0, -height / 2, 0);
+
+    parallel_for(stacks + 1, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++) {
+            GLfloat y = height / 2 - height * j / stacks;
+            vec3 *row = v + j * slices;
+
+            for (int i = 0; i < slices; i++)
+                row[i] = vec3(radius * c[i], y, radius * s[i]);
+        }
+    });
+
+    GLuint *bottom_cap = f + 3 * (cylinder_faces(slices, stacks) - slices);
+
+    for (int i = 0; i < slices; i++) {
+        GLuint next = (i + 1) % slices;
+        GLuint last = stacks * slices;
+
+        f[3 * i] = top, f[3 * i + 1] = next, f[3 * i + 2] = i;
+        bottom_cap[3 * i] = last + i, bottom_cap[3 * i + 1] = last + next;
+        bottom_cap[3 * i + 2] = bottom;
+    }
+
+    parallel_for(stacks, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++)
+            band(f + 3 * slices + 6 * slices * j, j * slices,
+                (j + 1) * slices, slices);
+    });
+
+    delete[] c;
+    delete[] s;
+}
+
+void torus(vec3 *v, GLuint *f, int rings, int sides, GLfloat major_radius,
+    GLfloat minor_radius)
+{
+    GLfloat *c, *s, *tube_c, *tube_s;
+    circle(rings, c, s);
+    circle(sides, tube_c, tube_s);
+
+    // Ring i is a circle of sides vertices around the tube
+    parallel_for(rings, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++)
+            for (int j = 0; j < sides; j++) {
+                GLfloat r = major_radius + minor_radius * tube_c[j];
+
+                v[i * sides + j] = vec3(r * c[i], minor_radius * tube_s[j],
+                    r * s[i]);
+            }
+    });
+
+    parallel_for(rings, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++)
+            band(f + 6 * sides * i, i * sides, (i + 1) % rings * sides, sides);
+    });
+
+    delete[] c;
+    delete[] s;
+    delete[] tube_c;
+    delete[] tube_s;
+}
+
+void grid(vec3 *v, GLuint *f, int columns, int rows, GLfloat width,
+    GLfloat depth)
+{
+    // Row j is at z growing with j, its vertices at x growing
+    parallel_for(rows + 1, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++) {
+            GLfloat z = depth * j / rows - depth / 2;
+
+            for (int i = 0; i <= columns; i++)
+                v[j * (columns + 1) + i] =
+                    vec3(width * i / columns - width / 2, 0, z);
+        }
+    });
+
+    parallel_for(rows, [&](int begin, int end, int) {
+        for (int j = begin; j < end; j++)
+            for (int i = 0; i < columns; i++) {
+                GLuint a = j * (columns + 1) + i, b = a + columns + 1;
+
+                quad(f + 6 * (j * columns + i), a, b, b + 1, a + 1);
+            }
+    });
+}
+
+// Parameters make_primitive uses for a resolution: levels of the icosphere or
+// segments around (n) and along (m) the other shapes, and the sizes
+static void primitive_size(Primitive shape, int resolution, int & n, int & m,
+    int & vertices, int & faces)
+{
+    // A band of m takes two triangles per segment, so m is half of n
+    n = resolution > 3 ? resolution : 3;
+    m = n / 2;
+
+    switch (shape) {
+    case Primitive::icosphere:
+        n = resolution < 0 ? 0 : resolution > 10 ? 10 : resolution;
+        vertices = icosphere_vertices(n), faces = icosphere_faces(n);
+        break;
+    case Primitive::uv_sphere:
+        m = m > 2 ? m : 2;
+        vertices = uv_sphere_vertices(n, m), faces = uv_sphere_faces(n, m);
+        break;
+    case Primitive::box:
+        vertices = box_vertices, faces = box_faces;
+        break;
+    case Primitive::cylinder:
+        vertices = cylinder_vertices(n, m), faces = cylinder_faces(n, m);
+        break;
+    case Primitive::torus:
+        m = m > 3 ? m : 3;
+        vertices = torus_vertices(n, m), faces = torus_faces(n, m);
+        break;
+    case Primitive::grid:
+        m = n;
+        vertices = grid_vertices(n, m), faces = grid_faces(n, m);
+        break;
+    }
+}
+
+void make_primitive(Geometry & g, Primitive shape, int resolution)
+{
+    int n, m, vertices, faces;
+    primitive_size(shape, resolution, n, m, vertices, faces);
+
+    g.allocate(vertices, faces);
+
+    switch (shape) {
+    case Primitive::icosphere:
+        icosphere(g.v, g.f, n, 1);
+        break;
+    case Primitive::uv_sphere:
+        uv_sphere(g.v, g.f, n, m, 1);
+        break;
+    case Primitive::box:
+        box(g.v, g.f, vec3(2));
+        break;
+    case Primitive::cylinder:
+        cylinder(g.v, g.f, n, m, 1, 2);
+        break;
+    case Primitive::torus:
+        torus(g.v, g.f, n, m, 0.75, 0.25);
+        break;
+    case Primitive::grid:
+        grid(g.v, g.f, n, m, 2, 2);
+        break;
+    }
+}
+
+int primitive_vertices(Primitive shape, int resolution)
+{
+    int n, m, vertices, faces;
+    primitive_size(shape, resolution, n, m, vertices, faces);
+
+    return vertices;
+}
+
+int primitive_faces(Primitive shape, int resolution)
+{
+    int n, m, vertices, faces;
+    primitive_size(shape, resolution, n, m, vertices, faces);
+
+    return faces;
+}
+
+int primitive_resolution(Primitive shape, long long triangles)
+{
+    // Faces grow by 4 with a level of the icosphere, with the square of the
+    // resolution for the others (2 n^2 for the grid, about n^2 otherwise)
+    if (shape == Primitive::icosphere) {
+        int levels = 0;
+        while (levels < 10 && icosphere_faces(levels) * 2 < triangles)
+            levels++;
+
+        return levels;
+    }
+
+    if (shape == Primitive::grid)
+        triangles /= 2;
+
+    int n = sqrt((double) triangles) + 0.5;
+
+    // Indices of every primitive fit an int
+    return n < 3 ? 3 : n > 16384 ? 16384 : n;
+}
@@ -0,0 +1,120 @@
+#ifndef PRIMITIVES_HPP
+#define PRIMITIVES_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+#include "geometry.hpp"
+
+// Procedural meshes: indexed triangles with shared vertices, centred at the
+// origin, y is up and faces are counter-clockwise seen from outside.
+//
+// Every generator writes to arrays of exactly the sizes below (3 indices per
+// face), so they can be allocated up front, or be static arrays when the
+// resolution is a constant
+
+constexpr int icosphere_vertices(int levels)
+{
+    return 10 * (1 << 2 * levels) + 2;
+}
+
+constexpr int icosphere_faces(int levels)
+{
+    return 20 * (1 << 2 * levels);
+}
+
+constexpr int uv_sphere_vertices(int slices, int stacks)
+{
+    return slices * (stacks - 1) + 2;
+}
+
+constexpr int uv_sphere_faces(int slices, int stacks)
+{
+    return 2 * slices * (stacks - 1);
+}
+
+constexpr int box_vertices = 8;
+constexpr int box_faces = 12;
+
+constexpr int cylinder_vertices(int slices, int stacks)
+{
+    return slices * (stacks + 1) + 2;
+}
+
+constexpr int cylinder_faces(int slices, int stacks)
+{
+    return 2 * slices * (stacks + 1);
+}
+
+constexpr int torus_vertices(int rings, int sides)
+{
+    return rings * sides;
+}
+
+constexpr int torus_faces(int rings, int sides)
+{
+    return 2 * rings * sides;
+}
+
+constexpr int grid_vertices(int columns, int rows)
+{
+    return (columns + 1) * (rows + 1);
+}
+
+constexpr int grid_faces(int columns, int rows)
+{
+    return 2 * columns * rows;
+}
+
+// Icosahedron with every face split into 4 levels times, new vertices are
+// put on the sphere. The midpoint of an edge is looked up in the slots of its
+// lower vertex (at most 6, no hashing), faces are split in place
+void icosphere(vec3 *v, GLuint *f, int levels, GLfloat radius);
+
+// Sphere of slices meridians and stacks bands between the poles (slices >= 3,
+// stacks >= 2)
+void uv_sphere(vec3 *v, GLuint *f, int slices, int stacks, GLfloat radius);
+
+// Box of a given size, corners are shared by its faces
+void box(vec3 *v, GLuint *f, const vec3 & size);
+
+// Closed cylinder along y: slices around (>= 3), stacks bands along the side,
+// caps are fans around their centres
+void cylinder(vec3 *v, GLuint *f, int slices, int stacks, GLfloat radius,
+    GLfloat height);
+
+// Torus around y: rings around the axis, sides around the tube (both >= 3)
+void torus(vec3 *v, GLuint *f, int rings, int sides, GLfloat major_radius,
+    GLfloat minor_radius);
+
+// Grid of columns along x and rows along z in the y = 0 plane, facing up
+void grid(vec3 *v, GLuint *f, int columns, int rows, GLfloat width,
+    GLfloat depth);
+
+enum class Primitive {
+    icosphere,
+    uv_sphere,
+    box,
+    cylinder,
+    torus,
+    grid
+};
+
+const int primitive_shapes = 6;
+
+// Names of the shapes in the order of Primitive
+extern const char *primitive_names[primitive_shapes];
+
+// Primitive fitting the [-1, 1] cube, resolution is the number of levels of
+// the icosphere and the number of segments around (or along x) for the other
+// shapes, the box has none. Arrays of g are allocated to exact sizes
+void make_primitive(Geometry & g, Primitive shape, int resolution);
+
+// Numbers of vertices and triangles make_primitive gives for a resolution
+int primitive_vertices(Primitive shape, int resolution);
+int primitive_faces(Primitive shape, int resolution);
+
+// Resolution for which make_primitive gives about a given number of
+// triangles (within a factor of 2 for the icosphere)
+int primitive_resolution(Primitive shape, long long triangles);
+
+#endif
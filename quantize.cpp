@@ -0,0 +1,83 @@
+#include "quantize.hpp"
+
+void encode_normal(const vec3 & normal, GLbyte n[2])
+{
+    vec2 e = oct_encode(normal);
+
+    for (int j = 0; j < 2; j++)
+        n[j] = (GLbyte) floor(e[j] * 127 + 0.5);
+}
+
+vec3 decode_normal(const GLbyte n[2])
+{
+    return oct_decode(vec2(n[0] / 127.0, n[1] / 127.0));
+}
+
+Quantization::Quantization()
+{
+    empty_ = true;
+}
+
+void Quantization::include(const vec3 *v, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (empty_) {
+            min_ = max_ = v[i];
+            empty_ = false;
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++) {
+            if (v[i][j] < min_[j])
+                min_[j] = v[i][j];
+            if (v[i][j] > max_[j])
+                max_[j] = v[i][j];
+        }
+    }
+}
+
+vec3 Quantization::offset() const
+{
+    return min_;
+}
+
+vec3 Quantization::scale() const
+{
+    vec3 s = max_ - min_;
+
+    // Flat boxes still have to be invertible
+    for (int j = 0; j < 3; j++)
+        if (s[j] <= 0)
+            s[j] = 1;
+
+    return s;
+}
+
+QVertex Quantization::encode(const vec3 & v) const
+{
+    QVertex q;
+    vec3 s = scale();
+
+    for (int j = 0; j < 3; j++) {
+        GLfloat t = (v[j] - min_[j]) / s[j];
+
+        if (t < 0)
+            t = 0;
+        if (t > 1)
+            t = 1;
+
+        q.p[j] = (GLushort) (t * 65535 + 0.5);
+    }
+
+    return q;
+}
+
+vec3 Quantization::decode(const QVertex & q) const
+{
+    vec3 s = scale();
+
+    return vec3(
+        min_.x + s.x * q.p[0] / 65535.0,
+        min_.y + s.y * q.p[1] / 65535.0,
+        min_.z + s.z * q.p[2] / 65535.0);
+}
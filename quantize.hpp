@@ -0,0 +1,39 @@
+#ifndef QUANTIZE_HPP
+#define QUANTIZE_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+
+// Quantised vertex: position as 16-bit normalised coordinates relative to a
+// box, 6 bytes without padding
+struct QVertex {
+    GLushort p[3];
+};
+
+// Octahedral normal in 2 x 8 bits, as stored in normal buffers
+void encode_normal(const vec3 & normal, GLbyte n[2]);
+vec3 decode_normal(const GLbyte n[2]);
+
+// Box used for quantisation, dequantised position is offset + scale * p,
+// where p is in [0, 1]^3
+class Quantization {
+
+    vec3 min_, max_;
+    bool empty_;
+
+public:
+
+    Quantization();
+
+    // Grow the box to contain given points
+    void include(const vec3 *v, int n);
+
+    vec3 offset() const;
+    vec3 scale() const;
+
+    // Position conversion
+    QVertex encode(const vec3 & v) const;
+    vec3 decode(const QVertex & q) const;
+};
+
+#endif
@@ -0,0 +1,179 @@
+// Reports of loading, optimisation, normals, wireframes, topology,
+// subdivision and primitives. They only load meshes and print what they
+// measured, so GL is replaced by gl_stub.hpp and no window, display or driver
+// is needed (make bench runs them)
+
+#include "gl_stub.hpp"
+#include "mesh.hpp"
+#include "primitives.hpp"
+#include "geometry.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Print vertex cache statistics before and after optimisation for every file
+int vcache_report(int n, char **files)
+{
+    Mesh::optimize_on_load = true;
+    Mesh::use_cache = false;
+
+    for (int i = 0; i < n; i++) {
+        Mesh mesh;
+        mesh.read_file(files[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Print float and quantised vertex buffer sizes for every file
+int footprint_report(int n, char **files)
+{
+    for (int i = 0; i < n; i++) {
+        Mesh mesh;
+
+        if (mesh.read_file(files[i]))
+            mesh.footprint_report();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Print time of normal generation for every file
+int normals_report(int n, char **files)
+{
+    for (int i = 0; i < n; i++) {
+        Mesh mesh;
+
+        if (mesh.read_file(files[i]))
+            mesh.normals_report();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Print numbers of wireframe lines for every file
+int wireframe_report(int n, char **files)
+{
+    for (int i = 0; i < n; i++) {
+        Mesh mesh;
+
+        if (mesh.read_file(files[i]))
+            mesh.wireframe_report();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Print half-edge connectivity statistics for every file
+int topology_report(int n, char **files)
+{
+    for (int i = 0; i < n; i++) {
+        Mesh mesh;
+
+        if (mesh.read_file(files[i]))
+            mesh.topology_report();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Print time of every subdivision level for every file
+int subdivision_report(int n, char **files)
+{
+    for (int i = 0; i < n; i++) {
+        Mesh mesh;
+
+        if (mesh.read_file(files[i]))
+            mesh.subdivision_report();
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// Print sizes and time of every phase of loading for every file and for all
+// of them; --optimize among the files optimises them (and uses the cache)
+int stats_report(int n, char **files)
+{
+    LoadStats total;
+
+    for (int i = 0; i < n; i++) {
+        if (strcmp(files[i], "--optimize") == 0) {
+            Mesh::optimize_on_load = true;
+            continue;
+        }
+
+        Mesh mesh;
+
+        if (mesh.read_file(files[i])) {
+            mesh.load_stats().print(cout);
+            total += mesh.load_stats();
+        }
+    }
+
+    if (total.files > 1) {
+        total.name = "total (" + to_string(total.files) + " files)";
+        total.print(cout);
+    }
+
+    // High-water marks of all the meshes
+    MemoryAccount::print_all(cout);
+
+    return EXIT_SUCCESS;
+}
+
+// Print time of generating every primitive with about a million triangles
+int primitives_report()
+{
+    const int resolution[primitive_shapes] = { 8, 1024, 0, 1024, 1024, 724 };
+
+    for (int i = 0; i < primitive_shapes; i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        Geometry g;
+        make_primitive(g, (Primitive) i, resolution[i]);
+
+        cout << primitive_names[i] << " " << resolution[i] << ": " <<
+            g.v_number << " vertices, " << g.f_number << " triangles in " <<
+            chrono::duration<double, milli>(
+            chrono::steady_clock::now() - start).count() << " ms" << endl;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--vcache-report") == 0)
+        return vcache_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--footprint-report") == 0)
+        return footprint_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--normals-report") == 0)
+        return normals_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--wireframe-report") == 0)
+        return wireframe_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--topology-report") == 0)
+        return topology_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--subdivision-report") == 0)
+        return subdivision_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--stats") == 0)
+        return stats_report(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--primitives-report") == 0)
+        return primitives_report();
+
+    cerr << "Use: report --vcache-report file.obj ..." << endl;
+    cerr << "     report --footprint-report file.obj ..." << endl;
+    cerr << "     report --normals-report file.obj ..." << endl;
+    cerr << "     report --wireframe-report file.obj ..." << endl;
+    cerr << "     report --topology-report file.obj ..." << endl;
+    cerr << "     report --subdivision-report file.obj ..." << endl;
+    cerr << "     report --stats [--optimize] file.obj ..." << endl;
+    cerr << "     report --primitives-report" << endl;
+    cerr << "Files are .obj, binary .stl or binary .ply" << endl;
+    return EXIT_FAILURE;
+}
@@ -1,4 +1,23 @@
 #include "scene.hpp"
+#include "primitive_mesh.hpp"
+#include "synthetic.hpp"
+#include "parallel.hpp"
+
+#include <algorithm>
+
+// Objects of a job of the parallel loops over them
+const int object_grain = 1024;
+
+// Whether 9 colors are the ones of a color scheme
+static bool same_colors(const vec4 *colors, const ColorScheme & colorscheme)
+{
+    for (int i = 0; i < 9; i++)
+        for (int j = 0; j < 4; j++)
+            if (colors[i][j] != colorscheme[i][j])
+                return false;
+
+    return true;
+}
 
 Scene::Scene()
 {
@@ -7,10 +26,14 @@ Scene::Scene()
     build_move_controller();
     build_rot_controller();
 
-    camera_index_ = -1;
+    camera_ = null_handle;
     active_camera_ = Camera(vec3(0, 0, 0), vec3(0, 0, 0));
 
-    object_index_ = 0;
+    object_ = null_handle;
+    hierarchy_changed_ = false;
+    all_dirty_ = true;
+
+    position_offset_ = position_scale_ = normal_length_ = 0;
 
     grid_color_ = vec4(42 / 255.0, 161 / 255.0, 152 / 255.0, 0.5);
     camera_color_ = vec4(133 / 255.0, 153 / 255.0, 0 / 255.0, 1.0);
@@ -20,12 +43,29 @@ Scene::Scene()
     zoom_s = 0.01;
 
     active_transform_ = Transformation::disabled;
+
+    viewport_width_ = viewport_height_ = 600;
+
+    interaction_ = false;
+    frame_budget_ = 1000 / 60.0;
+    quality_ = 1;
+
+    lod_switches_ = 0;
+    report_lods_ = false;
 }
 
 Scene::~Scene()
 {
-    for(cam_geo_.set_iterator(); cam_geo_.iterator(); cam_geo_.iterate())
-        glDeleteBuffers(1, &cam_geo_.get_iterator());
+    for (Camera & camera : cameras_)
+        glDeleteBuffers(1, &camera.buffer);
+
+    for (Shape & shape : shapes_)
+        delete shape.mesh;
+
+    // Meshes of commands that weren't applied
+    Command command;
+    while (commands_.pop(command))
+        delete command.mesh;
 
     glDeleteBuffers(1, &grid_buf_);
     glDeleteBuffers(1, &move_controller_buf_);
@@ -52,47 +92,828 @@ void Scene::init(GLuint color, GLuint cam_transform, GLuint local_transform)
     glBufferData(GL_ARRAY_BUFFER, 75 * sizeof(vec3), rot_controller_,
         GL_STATIC_DRAW);
 
+    memory_.allocate(MemoryCategory::gpu_helpers,
+        (36 + 18 + 75) * sizeof(vec3));
+
     color_ = color;
     cam_transform_ = cam_transform;
     local_transform_ = local_transform;
 }
 
-void Scene::add_direct(const char *obj_file, const ColorScheme & colorscheme)
+void Scene::set_dequantization(GLuint position_offset, GLuint position_scale,
+    GLuint normal_length)
+{
+    position_offset_ = position_offset;
+    position_scale_ = position_scale;
+    normal_length_ = normal_length;
+
+    // Everything that isn't quantised is drawn as is
+    glUniform3f(position_offset_, 0, 0, 0);
+    glUniform3f(position_scale_, 1, 1, 1);
+    glUniform1f(normal_length_, 0);
+}
+
+Handle Scene::add_direct(const char *obj_file,
+    const ColorScheme & colorscheme)
+{
+    Mesh *mesh = new Mesh;
+    mesh -> load_file(obj_file);
+
+    return add_instance(add_shape(mesh), Transform(), colorscheme);
+}
+
+
+Handle Scene::add_primitive(Primitive shape, int resolution,
+    const ColorScheme & colorscheme)
+{
+    return add_object(PrimitiveMesh(shape, resolution), colorscheme);
+}
+
+void Scene::add_synthetic(int n, long long triangles, unsigned int seed,
+    const ColorScheme & colorscheme)
+{
+    SyntheticObject *objects = new SyntheticObject[n];
+    synthetic_scene(objects, n, triangles, -1, seed, 3);
+
+    // Objects of the same shape have the same resolution and share it
+    Handle shapes[primitive_shapes];
+    for (int i = 0; i < primitive_shapes; i++)
+        shapes[i] = null_handle;
+
+    for (int i = 0; i < n; i++) {
+        int shape = (int) objects[i].shape;
+
+        if (shapes[shape] == null_handle)
+            shapes[shape] = add_geometry(PrimitiveMesh(objects[i].shape,
+                objects[i].resolution));
+
+        add_instance(shapes[shape], objects[i].transformation, colorscheme);
+    }
+
+    delete[] objects;
+}
+
+Handle Scene::add_object(const Mesh & G, const ColorScheme & colorscheme)
+{
+    return add_instance(add_geometry(G), Transform(), colorscheme);
+}
+
+Handle Scene::add_geometry(const Mesh & G)
+{
+    return add_shape(new Mesh(G));
+}
+
+Handle Scene::add_shape(Mesh *mesh)
+{
+    Shape shape = { mesh, 0 };
+
+    shape.mesh -> set_attributes(color_, local_transform_);
+    shape.mesh -> set_dequantization(position_offset_, position_scale_,
+        normal_length_);
+
+    Handle geometry = shapes_.insert(shape);
+    account_containers();
+
+    return geometry;
+}
+
+Handle Scene::add_instance(Handle geometry, const Transform & transformation,
+    const ColorScheme & colorscheme)
+{
+    return insert_instance(geometry, transformation, colorscheme, null_handle);
+}
+
+Handle Scene::insert_instance(Handle geometry,
+    const Transform & transformation, const ColorScheme & colorscheme,
+    Handle reserved)
+{
+    if (!shapes_.contains(geometry))
+        return null_handle;
+
+    Shape & shape = shapes_[geometry];
+    shape.users++;
+
+    // Objects of the same color scheme share its material
+    int material = 0;
+    int materials = colorschemes_.size() / 9;
+
+    while (material < materials &&
+        !same_colors(&colorschemes_[9 * material], colorscheme))
+        material++;
+
+    if (material == materials)
+        colorschemes_.insert(colorschemes_.end(), colorscheme,
+            colorscheme + 9);
+
+    Handle object = objects_.insert(geometry, reserved);
+
+    local_.push_back(transformation);
+    local_matrices_.push_back(transformation.matrix());
+    parents_.push_back(null_handle);
+    children_.push_back(0);
+    world_.push_back(local_matrices_.back());
+    pivots_.push_back(world_.back() * shape.mesh -> pivot);
+    box_min_.push_back(vec3(0));
+    box_max_.push_back(vec3(0));
+    spheres_.push_back(vec4(0));
+    flags_.push_back(visible_flag);
+    lods_.push_back(0);
+    materials_.push_back(material);
+
+    update_bounds(objects_.size() - 1);
+    account_containers();
+
+    hierarchy_changed_ = true;
+    activate_object(object);
+
+    return object;
+}
+
+// Whether the linear part of an affine transformation has an inverse
+static bool invertible(const mat4 & A)
+{
+    return det(mat3(
+        A[0][0], A[0][1], A[0][2],
+        A[1][0], A[1][1], A[1][2],
+        A[2][0], A[2][1], A[2][2])) != 0;
+}
+
+// Whether components reproduce the linear part of an affine transformation
+// up to rounding, they don't if it has shear
+static bool exact_components(const Transform & t, const mat4 & A)
+{
+    mat4 B = t.matrix();
+    GLfloat size = 0, error = 0;
+
+    for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++) {
+            GLfloat a = fabs(A[r][c]), e = fabs(A[r][c] - B[r][c]);
+
+            size = a > size ? a : size;
+            error = e > error ? e : error;
+        }
+
+    return error <= 1e-5 * size;
+}
+
+void Scene::remove_object(Handle object)
+{
+    if (!objects_.contains(object))
+        return;
+
+    release_shape(objects_[object]);
+
+    int i = objects_.index(object);
+    int last = objects_.size() - 1;
+
+    // Children are attached to the parent of the object, keeping their place
+    if (children_[i] > 0)
+        for (int j = 0; j < objects_.size(); j++)
+            if (parents_[j] == object) {
+                set_local_matrix(j, local_matrix(i) * local_matrix(j));
+                parents_[j] = parents_[i];
+            }
+
+    // Positions change, the next update checks all the objects
+    all_dirty_ = true;
+
+    if (objects_.contains(parents_[i]))
+        children_[objects_.index(parents_[i])] += children_[i] - 1;
+
+    // The last object takes the place of the removed one in all the arrays
+    local_[i] = local_[last];
+    local_matrices_[i] = local_matrices_[last];
+    parents_[i] = parents_[last];
+    children_[i] = children_[last];
+    world_[i] = world_[last];
+    pivots_[i] = pivots_[last];
+    box_min_[i] = box_min_[last];
+    box_max_[i] = box_max_[last];
+    spheres_[i] = spheres_[last];
+    flags_[i] = flags_[last];
+    lods_[i] = lods_[last];
+    materials_[i] = materials_[last];
+
+    local_.pop_back();
+    local_matrices_.pop_back();
+    parents_.pop_back();
+    children_.pop_back();
+    world_.pop_back();
+    pivots_.pop_back();
+    box_min_.pop_back();
+    box_max_.pop_back();
+    spheres_.pop_back();
+    flags_.pop_back();
+    lods_.pop_back();
+    materials_.pop_back();
+
+    objects_.remove(object);
+    account_containers();
+
+    hierarchy_changed_ = true;
+
+    // The last object becomes the active one
+    if (object == object_)
+        activate_object(objects_.size() > 0 ?
+            objects_.handle(objects_.size() - 1) : null_handle);
+}
+
+void Scene::release_shape(Handle shape)
+{
+    if (--shapes_[shape].users > 0)
+        return;
+
+    delete shapes_[shape].mesh;
+    shapes_.remove(shape);
+}
+
+void Scene::delete_active_object()
+{
+    remove_object(object_);
+}
+
+Mesh * Scene::object(Handle object)
+{
+    return objects_.contains(object) ? shapes_[objects_[object]].mesh : 0;
+}
+
+Handle Scene::active_object() const
+{
+    return object_;
+}
+
+int Scene::objects_number() const
+{
+    return objects_.size();
+}
+
+void Scene::set_transformation(Handle object, const Transform & transformation)
+{
+    if (!objects_.contains(object))
+        return;
+
+    int i = objects_.index(object);
+
+    local_[i] = transformation;
+    mark_dirty(i);
+}
+
+bool Scene::set_parent(Handle object, Handle parent)
 {
-    Mesh new_mesh;
-    objects_.push(new_mesh);
+    // Only null_handle detaches, a removed parent is an error
+    if (!objects_.contains(object) ||
+        (parent != null_handle && !objects_.contains(parent)))
+        return false;
 
-    if (objects_.length() > 0)
-        objects_[object_index_].active = false;
+    // Cycles: the object can't be an ancestor of its parent
+    for (Handle h = parent; h != null_handle; h = parents_[objects_.index(h)])
+        if (h == object)
+            return false;
 
-    objects_.tail().load_file(obj_file);
-    objects_.tail().set_colorscheme(colorscheme);
-    objects_.tail().set_attributes(color_, local_transform_);
+    int i = objects_.index(object);
+    mat4 world = world_transformation(object);
 
-    object_index_ = objects_.length() - 1;
-    objects_[object_index_].active = true;
+    // Parents scaled to zero can't keep the world transformation
+    if (parent != null_handle) {
+        mat4 parent_world = world_transformation(parent);
+
+        if (!invertible(parent_world))
+            return false;
+
+        world = affine_inverse(parent_world) * world;
+    }
+
+    if (objects_.contains(parents_[i]))
+        children_[objects_.index(parents_[i])]--;
+
+    parents_[i] = parent;
+
+    if (parent != null_handle)
+        children_[objects_.index(parent)]++;
+
+    set_local_matrix(i, world);
+
+    hierarchy_changed_ = true;
+
+    return true;
+}
+
+void Scene::post(Command::Type type, Handle object, Mesh *mesh,
+    const Transform & transformation, const ColorScheme *colorscheme)
+{
+    Command command = { type, object, mesh, transformation, colorscheme };
+    commands_.push(command);
 }
 
+Handle Scene::post_add_object(Mesh *mesh, const Transform & transformation,
+    const ColorScheme & colorscheme)
+{
+    Handle object = objects_.reserve();
+
+    post(Command::Type::add_object, object, mesh, transformation,
+        &colorscheme);
+
+    return object;
+}
 
-void Scene::add_object(const Mesh & G) {
-    objects_.push(G);
+void Scene::post_replace_geometry(Handle object, Mesh *mesh)
+{
+    post(Command::Type::replace_geometry, object, mesh, Transform(), 0);
+}
 
-    if (objects_.length() > 0)
-        objects_[object_index_].active = false;
+void Scene::post_transformation(Handle object,
+    const Transform & transformation)
+{
+    post(Command::Type::set_transformation, object, 0, transformation, 0);
+}
 
-    object_index_ = objects_.length() - 1;
-    objects_[object_index_].active = true;
+void Scene::post_remove_object(Handle object)
+{
+    post(Command::Type::remove_object, object, 0, Transform(), 0);
+}
+
+int Scene::apply_commands()
+{
+    int n = 0;
+    Command c;
+
+    while (commands_.pop(c)) {
+        n++;
+
+        if (c.type == Command::Type::add_object) {
+            c.mesh -> upload();
+            insert_instance(add_shape(c.mesh), c.transformation,
+                *c.colorscheme, c.object);
+            continue;
+        }
+
+        if (!objects_.contains(c.object)) {
+            delete c.mesh;
+            continue;
+        }
+
+        int i = objects_.index(c.object);
+
+        switch (c.type) {
+            case Command::Type::replace_geometry: {
+                // The object gets a shape of its own, the old one is deleted
+                // with its last object
+                c.mesh -> upload();
+                Handle shape = add_shape(c.mesh);
+
+                shapes_[shape].users++;
+                release_shape(objects_[c.object]);
+                objects_[c.object] = shape;
+
+                lods_[i] = 0;
+                mark_dirty(i);
+                break;
+            }
+            case Command::Type::set_transformation:
+                set_transformation(c.object, c.transformation);
+                break;
+            case Command::Type::remove_object:
+                remove_object(c.object);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return n;
+}
+
+bool Scene::commands_pending() const
+{
+    return !commands_.empty();
+}
+
+mat4 Scene::world_transformation(Handle object) const
+{
+    mat4 world(1);
+
+    for (Handle h = object; h != null_handle; h = parents_[objects_.index(h)])
+        world = local_matrix(objects_.index(h)) * world;
+
+    return world;
+}
+
+mat4 Scene::local_matrix(int i) const
+{
+    return flags_[i] & local_dirty_flag ? local_[i].matrix() :
+        local_matrices_[i];
+}
+
+void Scene::set_local_matrix(int i, const mat4 & A)
+{
+    local_[i] = Transform(A);
+    local_matrices_[i] = A;
+
+    mark_dirty(i);
+    flags_[i] &= ~local_dirty_flag;
+}
+
+Handle Scene::parent(Handle object) const
+{
+    return objects_.contains(object) ? parents_[objects_.index(object)] :
+        null_handle;
+}
+
+void Scene::compose_world(int i, int parent)
+{
+    const Mesh & mesh = *shapes_[objects_.begin()[i]].mesh;
+
+    if (flags_[i] & local_dirty_flag)
+        local_matrices_[i] = local_[i].matrix();
+
+    world_[i] = parent < 0 ? local_matrices_[i] :
+        world_[parent] * local_matrices_[i];
+    pivots_[i] = world_[i] * mesh.pivot;
+    update_bounds(i);
+}
+
+// Reorder an array of components like SlotMap::permute()
+template <class T>
+static void permute(std::vector<T> & components, const std::vector<int> & order)
+{
+    std::vector<T> permuted(components.size());
+
+    for (unsigned int k = 0; k < components.size(); k++)
+        permuted[k] = components[order[k]];
+
+    components.swap(permuted);
+}
+
+void Scene::build_hierarchy()
+{
+    int n = objects_.size();
+
+    std::vector<int> parent(n), order, child_start(n + 1, 0), child_list(n);
+    order.reserve(n);
+    depth_start_.clear();
+
+    // Children of every object are counted, the counts are summed up to the
+    // ends of the ranges in child_list and the ranges filled from the ends
+    for (int i = 0; i < n; i++) {
+        parent[i] = objects_.contains(parents_[i]) ?
+            objects_.index(parents_[i]) : -1;
+
+        if (parent[i] >= 0)
+            child_start[parent[i]]++;
+        else
+            order.push_back(i);
+    }
+
+    for (int i = 1; i <= n; i++)
+        child_start[i] += child_start[i - 1];
+
+    for (int i = n - 1; i >= 0; i--)
+        if (parent[i] >= 0)
+            child_list[--child_start[parent[i]]] = i;
+
+    // Roots are the first depth, children of a depth the next one
+    int start = 0;
+
+    while (start < (int) order.size()) {
+        int end = order.size();
+        depth_start_.push_back(start);
+
+        for (int k = start; k < end; k++)
+            for (int c = child_start[order[k]]; c < child_start[order[k] + 1];
+                c++)
+                order.push_back(child_list[c]);
+
+        start = end;
+    }
+
+    depth_start_.push_back(n);
+
+    objects_.permute(order);
+    permute(local_, order);
+    permute(local_matrices_, order);
+    permute(parents_, order);
+    permute(children_, order);
+    permute(world_, order);
+    permute(pivots_, order);
+    permute(box_min_, order);
+    permute(box_max_, order);
+    permute(spheres_, order);
+    permute(flags_, order);
+    permute(lods_, order);
+    permute(materials_, order);
+
+    parent_position_.resize(n);
+    for (int i = 0; i < n; i++)
+        parent_position_[i] = objects_.contains(parents_[i]) ?
+            objects_.index(parents_[i]) : -1;
+
+    // Children of a position follow the ones of the previous position, the
+    // first ones follow the roots
+    child_start_.assign(n + 1, 0);
+    child_start_[0] = depth_start_.size() > 2 ? depth_start_[1] : n;
+
+    for (int i = 0; i < n; i++)
+        if (parent_position_[i] >= 0)
+            child_start_[parent_position_[i] + 1]++;
+
+    for (int i = 1; i <= n; i++)
+        child_start_[i] += child_start_[i - 1];
+
+    hierarchy_changed_ = false;
+    all_dirty_ = true;
+    account_containers();
+}
+
+void Scene::update_world()
+{
+    if (hierarchy_changed_)
+        build_hierarchy();
+
+    int n = objects_.size();
+    const int *parent = parent_position_.data();
+    unsigned char *flags = flags_.data();
+
+    // Many small subtrees are updated in one pass over all the objects
+    if (dirty_roots_.size() * 16 > (size_t) n)
+        all_dirty_ = true;
+
+    if (!all_dirty_) {
+        // Ancestors come first, subtrees of roots updated on the way are
+        // skipped
+        std::sort(dirty_roots_.begin(), dirty_roots_.end());
+
+        for (int root : dirty_roots_) {
+            if (!(flags[root] & dirty_flag))
+                continue;
+
+            int begin = root, end = root + 1;
+
+            while (begin < end) {
+                parallel_for(end - begin, object_grain,
+                    [&](int first, int last) {
+                    for (int i = begin + first; i < begin + last; i++) {
+                        compose_world(i, parent[i]);
+                        flags[i] &= ~(dirty_flag | local_dirty_flag);
+                    }
+                });
+
+                int next = child_start_[begin];
+                end = child_start_[end];
+                begin = next;
+            }
+        }
+
+        dirty_roots_.clear();
+        return;
+    }
+
+    // Dirty objects make their children dirty, parents come first: objects
+    // of a depth depend on the previous depths only, so every depth is a
+    // parallel loop
+    for (int d = 0; d + 1 < (int) depth_start_.size(); d++) {
+        int begin = depth_start_[d], end = depth_start_[d + 1];
+
+        parallel_for(end - begin, object_grain, [&](int first, int last) {
+            for (int i = begin + first; i < begin + last; i++) {
+                int p = parent[i];
+
+                if (p >= 0 && (flags[p] & dirty_flag))
+                    flags[i] |= dirty_flag;
+
+                if (flags[i] & dirty_flag)
+                    compose_world(i, p);
+            }
+        });
+    }
+
+    for (int i = 0; i < n; i++)
+        flags[i] &= ~(dirty_flag | local_dirty_flag);
+
+    dirty_roots_.clear();
+    all_dirty_ = false;
+}
+
+void Scene::mark_dirty(int i)
+{
+    if (!(flags_[i] & dirty_flag))
+        dirty_roots_.push_back(i);
+
+    flags_[i] |= dirty_flag | local_dirty_flag;
+}
+
+void Scene::activate_object(Handle object)
+{
+    // Normals and bounding box are shown for the active object only
+    const unsigned int active = Mesh::draw_active |
+        Mesh::draw_vertex_normals | Mesh::draw_face_normals |
+        Mesh::draw_bounding_box;
+
+    if (objects_.contains(object_))
+        flags_[objects_.index(object_)] &= ~active;
+
+    object_ = object;
+
+    if (objects_.contains(object_))
+        flags_[objects_.index(object_)] |= Mesh::draw_active;
+}
+
+// Range of a coordinate of a transformed box: the translation plus the
+// smaller (larger) products of a row of the transformation with the corners
+static void transform_range(const vec4 & row, const vec3 & low,
+    const vec3 & high, GLfloat & min, GLfloat & max)
+{
+    GLfloat a[3] = { row.x * low.x, row.y * low.y, row.z * low.z };
+    GLfloat b[3] = { row.x * high.x, row.y * high.y, row.z * high.z };
+
+    min = max = row.w;
+
+    for (int c = 0; c < 3; c++) {
+        min += a[c] < b[c] ? a[c] : b[c];
+        max += a[c] < b[c] ? b[c] : a[c];
+    }
+}
+
+// Largest scaling factor of a model transformation: the longest column
+static GLfloat largest_scale(const mat4 & t)
+{
+    const vec4 *r = t.M_;
+
+    GLfloat x = r[0].x * r[0].x + r[1].x * r[1].x + r[2].x * r[2].x;
+    GLfloat y = r[0].y * r[0].y + r[1].y * r[1].y + r[2].y * r[2].y;
+    GLfloat z = r[0].z * r[0].z + r[1].z * r[1].z + r[2].z * r[2].z;
+
+    GLfloat s = x > y ? x : y;
+
+    return sqrt(s > z ? s : z);
+}
+
+// Coordinate of a transformed point
+static inline GLfloat transform_coordinate(const vec4 & row, const vec3 & p)
+{
+    return row.w + row.x * p.x + row.y * p.y + row.z * p.z;
+}
+
+// Range of a coordinate of a transformed oriented box: the transformed centre
+// plus and minus the half sizes along the transformed axes
+static void transform_range(const vec4 & row, const OrientedBox & box,
+    GLfloat & min, GLfloat & max)
+{
+    const GLfloat *half = &box.half.x;
+    GLfloat extent = 0;
+
+    for (int k = 0; k < 3; k++) {
+        const vec3 & a = box.axis[k];
+        extent += fabs(row.x * a.x + row.y * a.y + row.z * a.z) * half[k];
+    }
+
+    GLfloat center = transform_coordinate(row, box.center);
+
+    min = center - extent;
+    max = center + extent;
+}
+
+void Scene::update_bounds(int i)
+{
+    const Mesh & mesh = *shapes_[objects_.begin()[i]].mesh;
+    const vec3 & low = mesh.box_min(), & high = mesh.box_max();
+    const BoundingSphere & sphere = mesh.tight_sphere();
+    const mat4 & t = world_[i];
+
+    GLfloat *min = &box_min_[i].x, *max = &box_max_[i].x;
+    vec4 & world_sphere = spheres_[i];
+
+    // Box of the transformed bounding box cut by the box of the transformed
+    // oriented box, which is tighter for rotated and elongated meshes
+    for (int c = 0; c < 3; c++) {
+        GLfloat oriented_min, oriented_max;
+
+        transform_range(t.M_[c], low, high, min[c], max[c]);
+        transform_range(t.M_[c], mesh.oriented_box(), oriented_min,
+            oriented_max);
+
+        min[c] = min[c] > oriented_min ? min[c] : oriented_min;
+        max[c] = max[c] < oriented_max ? max[c] : oriented_max;
+    }
+
+    world_sphere.x = transform_coordinate(t.M_[0], sphere.center);
+    world_sphere.y = transform_coordinate(t.M_[1], sphere.center);
+    world_sphere.z = transform_coordinate(t.M_[2], sphere.center);
+    world_sphere.w = largest_scale(t) * sphere.radius;
+}
+
+PointBounds Scene::world_bounds(Handle object) const
+{
+    if (!objects_.contains(object)) {
+        PointBounds none;
+        none.min = none.max = none.centroid = vec3(0);
+        return none;
+    }
+
+    int i = objects_.index(object);
+
+    return shapes_[objects_[object]].mesh -> world_bounds(world_[i]);
+}
+
+void Scene::update_bounds()
+{
+    parallel_for(objects_.size(), object_grain, [this](int begin, int end) {
+        for (int i = begin; i < end; i++)
+            update_bounds(i);
+    });
+}
+
+int Scene::cull()
+{
+    mat4 camera =
+        active_camera_.projection *
+        RotZ(-active_camera_.t[1][2]) *
+        RotX(-active_camera_.t[1][0]) *
+        RotY(-active_camera_.t[1][1]) *
+        Translate(-active_camera_.t[0]);
+
+    // Planes of the frustum (Gribb, Hartmann): the last row of the camera
+    // transformation plus and minus the other rows, points inside have
+    // non-negative distances to all of them. Normalised, so that the
+    // distances are in world units. The perspective projection has no depth
+    // range, one of its planes is all zero and is kept
+    GLfloat plane[6][4];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 4; j++) {
+            plane[2 * i][j] = camera[3][j] + camera[i][j];
+            plane[2 * i + 1][j] = camera[3][j] - camera[i][j];
+        }
+
+    for (int k = 0; k < 6; k++) {
+        GLfloat *p = plane[k];
+        GLfloat l = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+
+        for (int j = 0; j < 4 && l > 0; j++)
+            p[j] /= l;
+    }
+
+    int n = objects_.size();
+    const vec3 *low = box_min_.data(), *high = box_max_.data();
+    const vec4 *sphere = spheres_.data();
+    unsigned char *flags = flags_.data();
+    int visible_number = 0;
+
+    for (int i = 0; i < n; i++) {
+        bool visible = true;
+
+        // Sphere is outside if its centre is farther than the radius behind
+        // a plane
+        for (int k = 0; k < 6 && visible; k++) {
+            const GLfloat *p = plane[k];
+
+            visible = p[3] + p[0] * sphere[i].x + p[1] * sphere[i].y +
+                p[2] * sphere[i].z >= -sphere[i].w;
+        }
+
+        // Corner of the box farthest along the normal of a plane is outside
+        // only if the whole box is
+        for (int k = 0; k < 6 && visible; k++) {
+            const GLfloat *p = plane[k];
+
+            GLfloat d = p[3] +
+                p[0] * (p[0] > 0 ? high[i].x : low[i].x) +
+                p[1] * (p[1] > 0 ? high[i].y : low[i].y) +
+                p[2] * (p[2] > 0 ? high[i].z : low[i].z);
+
+            visible = d >= 0;
+        }
+
+        flags[i] = visible ? flags[i] | visible_flag : flags[i] & ~visible_flag;
+        visible_number += visible;
+    }
+
+    return visible_number;
+}
+
+void Scene::account_containers()
+{
+    long long components =
+        local_.capacity() * sizeof(Transform) +
+        (local_matrices_.capacity() + world_.capacity()) * sizeof(mat4) +
+        parents_.capacity() * sizeof(Handle) +
+        (pivots_.capacity() + box_min_.capacity() + box_max_.capacity()) *
+        sizeof(vec3) + flags_.capacity() + lods_.capacity() +
+        (children_.capacity() + materials_.capacity()) * sizeof(int) +
+        (spheres_.capacity() + colorschemes_.capacity()) * sizeof(vec4);
+
+    long long hierarchy = (depth_start_.capacity() + child_start_.capacity() +
+        parent_position_.capacity() + dirty_roots_.capacity()) * sizeof(int);
+
+    memory_.set(MemoryCategory::containers, objects_.bytes() +
+        shapes_.bytes() + shapes_.size() * sizeof(Mesh) + components +
+        hierarchy + cameras_.bytes());
 }
 
 void Scene::add_camera(vec3 pos, vec3 rot) {
-    cameras_.push(Camera(pos, rot));
-    camera_index_ = cameras_.length() - 1;
+    Camera camera(pos, rot);
     active_camera_ = Camera(pos, rot);
 
-    GLuint tmp_buf;
-
-    glGenBuffers(1, &tmp_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, tmp_buf);
+    glGenBuffers(1, &camera.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, camera.buffer);
 
     vec3 new_camera[48];
 
@@ -103,17 +924,18 @@ void Scene::add_camera(vec3 pos, vec3 rot) {
     glBufferData(GL_ARRAY_BUFFER, 48 * sizeof(vec3), new_camera,
         GL_STATIC_DRAW);
 
-    cam_geo_.push(tmp_buf);
+    camera_ = cameras_.insert(camera);
+
+    memory_.allocate(MemoryCategory::gpu_helpers, 48 * sizeof(vec3));
+    account_containers();
 }
 
 void Scene::add_camera() {
-    cameras_.push(active_camera_);
-    camera_index_ = cameras_.length() - 1;
+    Camera camera = active_camera_;
 
     // Initilise new buffer
-    GLuint tmp_buf;
-    glGenBuffers(1, &tmp_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, tmp_buf);
+    glGenBuffers(1, &camera.buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, camera.buffer);
 
     // Transform camera geometry
     vec3 new_camera[48];
@@ -127,7 +949,10 @@ void Scene::add_camera() {
     glBufferData(GL_ARRAY_BUFFER, 48 * sizeof(vec3), new_camera,
         GL_STATIC_DRAW);
 
-    cam_geo_.push(tmp_buf);
+    camera_ = cameras_.insert(camera);
+
+    memory_.allocate(MemoryCategory::gpu_helpers, 48 * sizeof(vec3));
+    account_containers();
 }
 
 void Scene::switch_projection()
@@ -155,28 +980,161 @@ void Scene::switch_projection()
 void Scene::draw() {
     use_camera(active_camera_);
 
-    for(objects_.set_iterator(); objects_.iterator(); objects_.iterate())
-        objects_.get_iterator().draw();
+    mat4 view =
+        RotZ(-active_camera_.t[1][2]) *
+        RotX(-active_camera_.t[1][0]) *
+        RotY(-active_camera_.t[1][1]) *
+        Translate(-active_camera_.t[0]);
+
+    update_world();
+    cull();
+
+    int n = objects_.size();
+    const Handle *shapes = objects_.begin();
+    unsigned int proxy = interaction_ ? Mesh::draw_proxy : 0;
+    long long triangles = 0;
+
+    lod_switches_ = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (!(flags_[i] & visible_flag))
+            continue;
+
+        Mesh & mesh = *shapes_[shapes[i]].mesh;
+
+        if (!interaction_) {
+            int level = mesh.select_lod(
+                quality_ * projected_radius(mesh, world_[i], view));
+
+            if (level != lods_[i]) {
+                lods_[i] = level;
+                lod_switches_++;
+            }
+
+            triangles += mesh.lod_faces(lods_[i]);
+        }
+
+        mesh.draw(world_[i], &colorschemes_[9 * materials_[i]],
+            (flags_[i] & ~visible_flag) | proxy, lods_[i]);
+    }
+
+    // One line for all the switches of the frame
+    if (report_lods_ && lod_switches_ > 0)
+        cout << "levels of detail: " << lod_switches_ << " switches, " <<
+            triangles << " triangles in view" << endl;
 
     draw_grid();
     draw_cameras();
     draw_active_controller();
 }
 
+void Scene::set_viewport(GLsizei width, GLsizei height)
+{
+    viewport_width_ = width;
+    viewport_height_ = height;
+}
+
+void Scene::begin_interaction()
+{
+    interaction_ = true;
+}
+
+void Scene::end_interaction()
+{
+    interaction_ = false;
+}
+
+bool Scene::interaction()
+{
+    return interaction_;
+}
+
+void Scene::wait_lods()
+{
+    for (Shape & shape : shapes_)
+        shape.mesh -> wait_lods();
+}
+
+const MemoryAccount & Scene::memory() const
+{
+    return memory_;
+}
+
+void Scene::memory_report()
+{
+    for (Shape & shape : shapes_)
+        shape.mesh -> memory_report();
+
+    memory_.print(cout, "scene");
+    MemoryAccount::print_all(cout);
+}
+
+void Scene::set_frame_budget(double ms)
+{
+    frame_budget_ = ms;
+}
+
+void Scene::set_lod_report(bool report)
+{
+    report_lods_ = report;
+}
+
+int Scene::lod_switches() const
+{
+    return lod_switches_;
+}
+
+void Scene::frame_time(double ms)
+{
+    // Coarsen fast when over budget, refine slowly when well under it
+    if (ms > frame_budget_)
+        quality_ /= 1.25;
+    else if (ms < 0.7 * frame_budget_)
+        quality_ *= 1.05;
+
+    if (quality_ < 0.05)
+        quality_ = 0.05;
+    if (quality_ > 1)
+        quality_ = 1;
+}
+
 void Scene::toogle_vertex_normals()
 {
-    if (objects_.length() == 0)
-        return;
+    if (objects_.contains(object_))
+        flags_[objects_.index(object_)] ^= Mesh::draw_vertex_normals;
+}
 
-    objects_[object_index_].toogle_vertex_normals();
+void Scene::toogle_face_normals()
+{
+    if (objects_.contains(object_))
+        flags_[objects_.index(object_)] ^= Mesh::draw_face_normals;
 }
 
 void Scene::toogle_bounding_box()
 {
-    if (objects_.length() == 0)
+    if (objects_.contains(object_))
+        flags_[objects_.index(object_)] ^= Mesh::draw_bounding_box;
+}
+
+void Scene::finer_subdivision()
+{
+    if (!objects_.contains(object_))
+        return;
+
+    // Objects sharing the mesh are subdivided too
+    Mesh & mesh = *shapes_[objects_[object_]].mesh;
+    mesh.set_subdivision(mesh.subdivision() + 1);
+    update_bounds();
+}
+
+void Scene::coarser_subdivision()
+{
+    if (!objects_.contains(object_))
         return;
 
-    objects_[object_index_].toogle_bounding_box();
+    Mesh & mesh = *shapes_[objects_[object_]].mesh;
+    mesh.set_subdivision(mesh.subdivision() - 1);
+    update_bounds();
 }
 
 // Maya controls
@@ -197,7 +1155,7 @@ void Scene::update_camera_move(int delta_x, int delta_y) {
     Rz(active_camera_.t[1][2]) *
     active_camera_.t[0];
 
-    camera_index_ = -1;
+    camera_ = null_handle;
 }
 
 void Scene::update_camera_roll(int d) {
@@ -208,14 +1166,14 @@ void Scene::update_camera_roll(int d) {
     if (active_camera_.t[1][2] < - 2 * pi)
         active_camera_.t[1][2] += 2 * pi;
 
-    camera_index_ = -1;
+    camera_ = null_handle;
 }
 
 void Scene::update_camera_zoom(int d) {
     vec3 v(0,0,1);
     v = Ry(-active_camera_.t[1][1]) * Rx(active_camera_.t[1][0]) * v;
     active_camera_.t[0] += zoom_s * d * v;
-    camera_index_ = -1;
+    camera_ = null_handle;
 }
 
 void Scene::update_camera_spherical(int dx, int dy) {
@@ -233,53 +1191,52 @@ void Scene::update_camera_spherical(int dx, int dy) {
     if (active_camera_.t[1][1] < - 2 * pi)
         active_camera_.t[1][1] += 2 * pi;
 
-    camera_index_ = -1;
+    camera_ = null_handle;
 }
 
 void Scene::previous_camera() {
-    if (cameras_.length() == 0)
+    if (cameras_.size() == 0)
         return;
 
-    if (camera_index_ == -1) {
-        camera_index_ = 0;
-        active_camera_ = cameras_[camera_index_];
-        return;
-    }
+    // A moved camera switches to the first one
+    int i = 0;
 
-    if (camera_index_ == 0)
-        camera_index_ = cameras_.length() - 1;
-    else
-        camera_index_--;
+    if (cameras_.contains(camera_)) {
+        i = cameras_.index(camera_) - 1;
+        if (i < 0)
+            i = cameras_.size() - 1;
+    }
 
-    active_camera_ = cameras_[camera_index_];
+    camera_ = cameras_.handle(i);
+    active_camera_ = cameras_[camera_];
 }
 
 void Scene::next_camera() {
-    if (cameras_.length() == 0)
+    if (cameras_.size() == 0)
         return;
 
-    if (camera_index_ == -1) {
-        camera_index_ = 0;
-        active_camera_ = cameras_[camera_index_];
-        return;
-    }
+    int i = 0;
 
-    if (camera_index_ == cameras_.length() - 1)
-        camera_index_ = 0;
-    else
-        camera_index_++;
+    if (cameras_.contains(camera_)) {
+        i = cameras_.index(camera_) + 1;
+        if (i >= cameras_.size())
+            i = 0;
+    }
 
-    active_camera_ = cameras_[camera_index_];
+    camera_ = cameras_.handle(i);
+    active_camera_ = cameras_[camera_];
 }
 
 void Scene::delete_active_camera() {
-    if (camera_index_ == -1)
+    if (!cameras_.contains(camera_))
         return;
 
-    glDeleteBuffers(1, & cam_geo_[camera_index_]);
-    cameras_.remove_by_index(camera_index_);
-    cam_geo_.remove_by_index(camera_index_);
-    camera_index_ = -1;
+    glDeleteBuffers(1, &cameras_[camera_].buffer);
+    cameras_.remove(camera_);
+    camera_ = null_handle;
+
+    memory_.release(MemoryCategory::gpu_helpers, 48 * sizeof(vec3));
+    account_containers();
 }
 
 void Scene::build_camera_model() {
@@ -410,9 +1367,9 @@ void Scene::draw_grid() {
 }
 
 void Scene::draw_cameras() {
-    for(cam_geo_.set_iterator(); cam_geo_.iterator(); cam_geo_.iterate()) {
+    for (const Camera & camera : cameras_) {
         glUniform4fv(color_, 1, (GLfloat*) &camera_color_);
-        glBindBuffer(GL_ARRAY_BUFFER, cam_geo_.get_iterator());
+        glBindBuffer(GL_ARRAY_BUFFER, camera.buffer);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
         glDrawArrays(GL_LINES, 0, 48);
     }
@@ -420,10 +1377,11 @@ void Scene::draw_cameras() {
 
 void Scene::draw_active_controller()
 {
-    if (objects_.length() == 0 || active_transform_ == Transformation::disabled)
+    if (!objects_.contains(object_) ||
+        active_transform_ == Transformation::disabled)
         return;
 
-    mat4 pivot_transform = Translate(objects_[object_index_].pivot);
+    mat4 pivot_transform = Translate(pivots_[objects_.index(object_)]);
 
     glUniformMatrix4fv(local_transform_, 1, true, (GLfloat*) & pivot_transform);
 
@@ -536,7 +1494,7 @@ void Scene::draw_active_controller()
     }
 }
 
-void Scene::use_camera(Camera cam) {
+void Scene::use_camera(const Camera & cam) {
     mat4 transformation =
         active_camera_.projection *
         RotZ(-cam.t[1][2]) * RotX(-cam.t[1][0]) * RotY(-cam.t[1][1]) *
@@ -547,32 +1505,26 @@ void Scene::use_camera(Camera cam) {
 
 void Scene::previous_object()
 {
-    if (objects_.length() == 0)
+    if (!objects_.contains(object_))
         return;
 
-    if (objects_.length() > 1)
-        objects_[object_index_].active = false;
-
-    object_index_--;
-    if (object_index_ < 0)
-        object_index_ = objects_.length() - 1;
+    int i = objects_.index(object_) - 1;
+    if (i < 0)
+        i = objects_.size() - 1;
 
-    objects_[object_index_].active = true;
+    activate_object(objects_.handle(i));
 }
 
 void Scene::next_object()
 {
-    if (objects_.length() == 0)
+    if (!objects_.contains(object_))
         return;
 
-    if (objects_.length() > 1)
-        objects_[object_index_].active = false;
-
-    object_index_++;
-    if (object_index_ >= objects_.length())
-        object_index_ = 0;
+    int i = objects_.index(object_) + 1;
+    if (i >= objects_.size())
+        i = 0;
 
-    objects_[object_index_].active = true;
+    activate_object(objects_.handle(i));
 }
 
 void Scene::activate_translation()
@@ -600,7 +1552,7 @@ bool Scene::transformation_is_active()
     return (active_transform_ == Transformation::disabled) ? false : true;
 }
 
-vec2 Scene::camera_plane_projection(vec3 point)
+vec2 Scene::camera_plane_projection(const vec3 & point)
 {
     vec4 u(point, 1);
 
@@ -616,93 +1568,91 @@ vec2 Scene::camera_plane_projection(vec3 point)
     return vec2(p.x / p.w, p.y / p.w);
 }
 
-void Scene::axis_transform(unsigned int axis, double delta_x, double delta_y)
+GLfloat Scene::projected_radius(const Mesh & mesh, const mat4 & model,
+    const mat4 & view)
 {
-    mat4 t;
+    const mat4 & t = model;
 
-    if (active_transform_ == Transformation::uniform_scaling ||
-        active_transform_ == Transformation::rotation) {
+    GLfloat r = largest_scale(t) * mesh.sphere_radius();
+    GLfloat pixels = viewport_height_ / 2.0;
 
-        if (active_transform_ == Transformation::uniform_scaling)
-            t = Scale(1 + delta_x + delta_y);
+    if (active_camera_.parallel_projection)
+        return r * pixels;
 
-        if (active_transform_ == Transformation::rotation)
-            switch (axis) {
-                case 0:
-                    t = RotX(delta_x + delta_y);
-                    break;
-                case 1:
-                    t = RotY(delta_x + delta_y);
-                    break;
-                case 2:
-                    t = RotZ(delta_x + delta_y);
-                    break;
-            }
+    // Distance along the main axis of the camera
+    GLfloat d = -(view * (t * mesh.sphere_center())).z;
 
-        t = Translate(objects_[object_index_].pivot) *
-            t * Translate(-objects_[object_index_].pivot);
+    // Camera is inside the sphere
+    if (d <= r)
+        return viewport_height_;
 
-        objects_[object_index_].transformation =
-            t * objects_[object_index_].transformation;
+    return r / d * pixels;
+}
 
-        return;
-    }
+void Scene::axis_transform(unsigned int axis, double delta_x, double delta_y)
+{
+    int i = objects_.index(object_);
+    Transform & local = local_[i];
+    vec3 pivot = pivots_[i];
 
-    vec2 p = camera_plane_projection(objects_[object_index_].pivot);
+    // Locals with shear (from reparenting) are edited through their
+    // components, the change is applied to the exact matrix
+    mat4 before = local.matrix();
+    bool sheared = !(flags_[i] & local_dirty_flag) && invertible(before) &&
+        !exact_components(local, local_matrices_[i]);
 
-    vec2 end_p = camera_plane_projection(objects_[object_index_].pivot +
-        move_controller_[2 * axis + 1]);
+    // Gizmos work along world axes, components are in the parent coordinates
+    mat4 to_parent(1);
 
-    vec2 direction = normalize(end_p - p);
-    
-    vec2 dv = vec2(delta_x, delta_y);
+    if (objects_.contains(parents_[i]))
+        to_parent = affine_inverse(world_[objects_.index(parents_[i])]);
 
+    vec4 e(0);
+    e[axis] = 1;
+    e = to_parent * e;
 
-    if (active_transform_ == Transformation::translation)
-        switch (axis) {
-            case 0:
-                objects_[object_index_].pivot.x += dot(direction, dv);
-                t = Translate(dot(direction, dv), 0, 0);
-                break;
-            case 1:
-                objects_[object_index_].pivot.y += dot(direction, dv);
-                t = Translate(0, dot(direction, dv), 0);
-                break;
-            case 2:
-                objects_[object_index_].pivot.z += dot(direction, dv);
-                t = Translate(0, 0, dot(direction, dv));
-                break;
-        }
+    vec3 parent_axis(e.x, e.y, e.z);
 
-    if (active_transform_ == Transformation::scaling) {
-        switch (axis) {
-            case 0:
-                t = ScaleX(1 + dot(direction, dv));
-                break;
-            case 1:
-                t = ScaleY(1 + dot(direction, dv));
-                break;
-            case 2:
-                t = ScaleZ(1 + dot(direction, dv));
-                break;
-        }
+    if (active_transform_ == Transformation::uniform_scaling)
+        local.scale_about(1 + delta_x + delta_y, to_parent * pivot);
 
-        t = Translate(objects_[object_index_].pivot) *
-            t * Translate(-objects_[object_index_].pivot);
+    // Rotation about y is clockwise as RotY()
+    if (active_transform_ == Transformation::rotation)
+        local.rotate_about(quat(normalize(parent_axis),
+            axis == 1 ? -(delta_x + delta_y) : delta_x + delta_y),
+            to_parent * pivot);
 
-        objects_[object_index_].transformation =
-            objects_[object_index_].transformation * t;
+    if (active_transform_ == Transformation::translation ||
+        active_transform_ == Transformation::scaling) {
 
-        return;
+        vec2 p = camera_plane_projection(pivot);
+
+        vec2 end_p = camera_plane_projection(pivot +
+            move_controller_[2 * axis + 1]);
+
+        GLfloat d = dot(normalize(end_p - p), vec2(delta_x, delta_y));
+
+        if (active_transform_ == Transformation::translation)
+            local.translation += d * parent_axis;
+        else
+            local.scale_axis(axis, 1 + d,
+                shapes_[objects_[object_]].mesh -> pivot);
     }
 
-    objects_[object_index_].transformation =
-        t * objects_[object_index_].transformation;
+    if (sheared)
+        set_local_matrix(i, local.matrix() * affine_inverse(before) *
+            local_matrices_[i]);
+    else
+        mark_dirty(i);
 }
 
 int Scene::local_transform(int axis, double delta_x, double delta_y,
     double x, double y)
 {
+    if (!objects_.contains(object_))
+        return -1;
+
+    const vec3 & pivot = pivots_[objects_.index(object_)];
 
     // Translating and scaling
     if (active_transform_ == Transformation::translation ||
@@ -712,14 +1662,12 @@ int Scene::local_transform(int axis, double delta_x, double delta_y,
         // Check if currently there is nothing to transform
         if (axis == -1) {
             // Find projections to the camera plane
-            vec2 p = camera_plane_projection(
-                objects_[object_index_].pivot);
+            vec2 p = camera_plane_projection(pivot);
             vec2 end_p;
 
             // Check "closest" axis
             for (int i = 0; i < 3; i++) {
-                end_p = camera_plane_projection(
-                    objects_[object_index_].pivot +
+                end_p = camera_plane_projection(pivot +
                     move_controller_[2 * i + 1]);
 
                 if (length(end_p - p) <= 0.05 && i == 2) {
@@ -740,10 +1688,8 @@ int Scene::local_transform(int axis, double delta_x, double delta_y,
                 bool uniform_scaling = true;
 
                 for (int i = 0; i < 3; i++) {
-                    end_p =
-                        camera_plane_projection(
-                            objects_[object_index_].pivot +
-                            move_controller_[2 * i + 1]);
+                    end_p = camera_plane_projection(pivot +
+                        move_controller_[2 * i + 1]);
 
                     if (!belongs_to_segment(vec2(x, y), p, end_p, 0.05)) {
                         uniform_scaling = false;
@@ -776,8 +1722,7 @@ int Scene::local_transform(int axis, double delta_x, double delta_y,
             // Check "closest" axis
             for (int i = 0; i < 3; i++)
                 for (int j = 0; j < 25; j++) {
-                    p = camera_plane_projection(
-                        objects_[object_index_].pivot +
+                    p = camera_plane_projection(pivot +
                         rot_controller_[i * 25 + j]);
 
                     if (sqrt(dot(p -  vec2(x, y), p - vec2(x, y))) <= 0.05) {
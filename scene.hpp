@@ -5,7 +5,11 @@
 #include "vec.hpp"
 #include "mat.hpp"
 #include "mesh.hpp"
-#include "list.hpp"
+#include "primitives.hpp"
+#include "slot_map.hpp"
+#include "mpsc_queue.hpp"
+
+#include <vector>
 
 class Scene {
 
@@ -22,6 +26,7 @@ class Scene {
             );
 
             parallel_projection = false;
+            buffer = 0;
         }
 
         Camera(vec3 pos, vec3 rot) {
@@ -35,6 +40,7 @@ class Scene {
             );
 
             parallel_projection = false;
+            buffer = 0;
         }
 
         // 0 - position, 1 - rotation
@@ -43,21 +49,96 @@ class Scene {
         // Projection matrix
         mat4 projection;
         bool parallel_projection;
+
+        // Geometry buffer of a stored camera's model (0 for the active one)
+        GLuint buffer;
     };
 
-    List <Mesh> objects_;       // Main geometry of a scene, that is .obj files
-    List <Camera> cameras_;     // All the cameras
-    List <GLuint> cam_geo_;     // Geometry buffers of all the cameras
+    // Geometry of objects (owned) and the number of objects using it
+    struct Shape {
+        Mesh *mesh;
+        int users;
+    };
+
+    // Objects of a scene refer to their shape by handle. The rest of their
+    // state is kept in arrays in the order of objects_ (object at position i
+    // has world_[i], box_min_[i], ...), passes over all the objects scan
+    // only the arrays they need
+    SlotMap <Handle> objects_;
+    SlotMap <Shape> shapes_;
+
+    std::vector<Transform> local_;      // Transformations in parents and
+    std::vector<mat4> local_matrices_;  // their matrices, exact ones where
+                                        // reparenting left shear
+    std::vector<Handle> parents_;       // Parents (null_handle for roots)
+    std::vector<int> children_;         // Numbers of children
+    std::vector<mat4> world_;           // Model transformations
+    std::vector<vec3> pivots_;          // Pivots of controllers
+    std::vector<vec3> box_min_;         // Bounding boxes in world coordinates
+    std::vector<vec3> box_max_;
+    std::vector<vec4> spheres_;         // Tight bounding spheres in world
+                                        // coordinates: centres and radii
+    std::vector<unsigned char> flags_;  // Draw flags of Mesh and the ones below
+    std::vector<unsigned char> lods_;   // Levels of detail in use
+    std::vector<int> materials_;        // Color schemes (9 colors each) in
+    std::vector<vec4> colorschemes_;    // colorschemes_
+
+    // Object is inside the view frustum (see cull()), world transformations
+    // of the object and its subtree are out of date, the local matrix of the
+    // object is out of date (composed from local_ by update_world())
+    static const unsigned int visible_flag = 128;
+    static const unsigned int dirty_flag = 64;
+    static const unsigned int local_dirty_flag = 32;
+
+    // Objects are kept in breadth-first order of the hierarchy, parents
+    // before children, so world transformations are updated in one pass over
+    // the arrays. Objects of a depth (from depth_start_[d] to
+    // depth_start_[d + 1]) depend only on the previous one and can be updated
+    // in parallel. Children of the objects at positions [a, b) are the
+    // objects at [child_start_[a], child_start_[b]), so a subtree is one
+    // range per depth. Sorted again after the hierarchy changes
+    std::vector<int> depth_start_;
+    std::vector<int> child_start_;
+    std::vector<int> parent_position_;  // Positions of parents, -1 for roots
+    bool hierarchy_changed_;
+
+    // Positions of objects marked dirty since the last update, roots of the
+    // subtrees update_world() walks; all of them are checked instead while
+    // all_dirty_ is set (positions changed)
+    std::vector<int> dirty_roots_;
+    bool all_dirty_;
+
+    // Change of the scene posted by another thread, applied by
+    // apply_commands(); meshes aren't uploaded yet and belong to commands
+    struct Command {
+        enum class Type {
+            add_object, replace_geometry, set_transformation, remove_object
+        };
+
+        Type type;
+        Handle object;
+        Mesh *mesh;
+        Transform transformation;
+        const ColorScheme *colorscheme;
+    };
+
+    MpscQueue <Command> commands_;
+
+    // All the cameras
+    SlotMap <Camera> cameras_;
 
     // Active mesh, switching bounding box and normals works for this object
-    int object_index_;
+    // (null_handle if there are no objects)
+    Handle object_;
 
-    // Active camera and index for tracing through the all cameras (in a list)
+    // Active camera and the stored camera it was set to (null_handle once it
+    // is moved)
     Camera active_camera_;
-    int camera_index_;
+    Handle camera_;
 
     // Shader attributes
     GLuint color_, cam_transform_, local_transform_;
+    GLuint position_offset_, position_scale_, normal_length_;
 
     // Grid (Maya-like)
     GLuint grid_buf_;
@@ -89,6 +170,27 @@ class Scene {
     // Main vertex array object (VAO)
     GLuint vao_;
 
+    // Viewport size in pixels, used for choosing levels of detail
+    GLsizei viewport_width_, viewport_height_;
+
+    // Interaction (camera orbit, controller drag): objects are drawn as
+    // coarse proxies until the input is idle
+    bool interaction_;
+
+    // Frame time controller: detail is scaled by quality_ (0, 1] to keep
+    // frame time (in milliseconds) within frame_budget_
+    double frame_budget_;
+    GLfloat quality_;
+
+    // Switches of levels of detail are counted per frame, and printed once
+    // per frame if report_lods_ is set
+    int lod_switches_;
+    bool report_lods_;
+
+    // Memory of the containers and of the buffers of the grid, controllers
+    // and cameras (objects have their own)
+    MemoryAccount memory_;
+
 public:
 
     // It's important to not to do anything with GL here
@@ -99,11 +201,90 @@ public:
     // functions can't be called before GLUT is initialised)
     void init(GLuint color, GLuint cam_transform, GLuint local_transform);
 
-    // Add new object
-    void add_object(const Mesh & G);
+    // Shader attributes used by quantised meshes
+    void set_dequantization(GLuint position_offset, GLuint position_scale,
+        GLuint normal_length);
+
+    // Add new object, it becomes the active one; returns its handle
+    Handle add_object(const Mesh & G,
+        const ColorScheme & colorscheme = solarized);
+
+    // Add geometry without objects, objects sharing it are added by
+    // add_instance(); it's deleted with the last of them
+    Handle add_geometry(const Mesh & G);
+    Handle add_instance(Handle geometry, const Transform & transformation,
+        const ColorScheme & colorscheme);
 
     // Add new object without calling copy constructor
-    void add_direct(const char *obj_file, const ColorScheme & colorscheme);
+    Handle add_direct(const char *obj_file, const ColorScheme & colorscheme);
+
+    // Add generated object (see primitive_mesh.hpp)
+    Handle add_primitive(Primitive shape, int resolution,
+        const ColorScheme & colorscheme);
+
+    // Add a synthetic scene of n objects and about triangles in total (see
+    // synthetic.hpp), every shape is generated once and shared
+    void add_synthetic(int n, long long triangles, unsigned int seed,
+        const ColorScheme & colorscheme);
+
+    // Remove an object, stale handles are ignored. The last object takes its
+    // place in the order of switching
+    void remove_object(Handle object);
+    void delete_active_object();
+
+    // Geometry of an object (null if it was removed), the active object and
+    // the number of objects
+    Mesh * object(Handle object);
+    Handle active_object() const;
+    int objects_number() const;
+
+    // Transformation of an object relative to its parent (the world one for
+    // roots), the pivot is moved with it
+    void set_transformation(Handle object, const Transform & transformation);
+
+    // Changes posted from any thread (the rest of the methods are for GL
+    // thread only), applied by apply_commands() in the order of posting;
+    // posting never waits for GL thread. Meshes are made without GL
+    // (Mesh::read_file(), set_geometry()) and allocated with new, the scene
+    // takes them. post_add_object() returns the handle of the object at
+    // once, it refers to the object after the command is applied (and can be
+    // used by later commands); color schemes have to outlive the commands
+    Handle post_add_object(Mesh *mesh, const Transform & transformation,
+        const ColorScheme & colorscheme);
+    void post_replace_geometry(Handle object, Mesh *mesh);
+    void post_transformation(Handle object, const Transform & transformation);
+    void post_remove_object(Handle object);
+
+    // Apply the posted changes and upload their meshes, commands for objects
+    // removed meanwhile are dropped; returns the number of commands
+    int apply_commands();
+
+    // Whether there are posted changes to apply
+    bool commands_pending() const;
+
+    // Attach an object to a parent, or detach it with null_handle, keeping
+    // its world transformation (shear included); returns false if the parent
+    // was removed, is in its subtree or is scaled to zero
+    bool set_parent(Handle object, Handle parent);
+    Handle parent(Handle object) const;
+
+    // World transformations, pivots and bounding boxes of the objects whose
+    // transformations or ancestors' ones changed, called by draw()
+    void update_world();
+
+    // Bounding boxes of all the objects in world coordinates, kept up to date
+    // by transformations and subdivision
+    void update_bounds();
+
+    // Bounding box and centroid of the vertices of an object in world
+    // coordinates, as of the last update_world(); all zero for stale
+    // handles. Culling uses the transformed boxes of meshes instead, they
+    // are larger for rotated objects but don't need a pass over the vertices
+    PointBounds world_bounds(Handle object) const;
+
+    // Mark objects whose bounding boxes intersect the view frustum of the
+    // active camera as visible, only they are drawn; returns their number
+    int cull();
 
     // Add new camera
     void add_camera(vec3 pos, vec3 rot);
@@ -114,6 +295,35 @@ public:
     // Main draw callback
     void draw();
 
+    // Set viewport size (in pixels)
+    void set_viewport(GLsizei width, GLsizei height);
+
+    // Interaction mode: while it's on objects are drawn with coarse proxies
+    void begin_interaction();
+    void end_interaction();
+    bool interaction();
+
+    // Wait for the levels of detail of all the objects
+    void wait_lods();
+
+    // Memory of the scene itself, without its objects
+    const MemoryAccount & memory() const;
+
+    // Print memory of every object, of the scene and the totals of all the
+    // meshes and scenes, current and peak KB of every category
+    void memory_report();
+
+    // Frame time budget in milliseconds
+    void set_frame_budget(double ms);
+
+    // Report time of the last frame (in milliseconds) to the controller
+    void frame_time(double ms);
+
+    // Print the number of switches of levels of detail of frames that have
+    // some; switches of the last frame
+    void set_lod_report(bool report);
+    int lod_switches() const;
+
     // Camera move (Maya-like)
     void update_camera_move(int delta_x, int delta_y);
 
@@ -139,8 +349,13 @@ public:
 
     // Toogle drawing options for the active object
     void toogle_vertex_normals();
+    void toogle_face_normals();
     void toogle_bounding_box();
 
+    // Subdivide the active object one level more or less
+    void finer_subdivision();
+    void coarser_subdivision();
+
     // If camera was set by the index in cameras array it will be deleted
     void delete_active_camera();
 
@@ -167,8 +382,59 @@ private:
     void build_move_controller();
     void build_rot_controller();
 
+    // Account the current sizes of the containers
+    void account_containers();
+
+    // Make an object the active one
+    void activate_object(Handle object);
+
+    // Delete a shape when its last object is removed
+    void release_shape(Handle shape);
+
+    // Add a shape of an uploaded mesh, the scene takes it
+    Handle add_shape(Mesh *mesh);
+
+    // add_instance() into a handle reserved by post_add_object(), any new
+    // handle if reserved is null_handle
+    Handle insert_instance(Handle geometry, const Transform & transformation,
+        const ColorScheme & colorscheme, Handle reserved);
+
+    // Post a command, from any thread
+    void post(Command::Type type, Handle object, Mesh *mesh,
+        const Transform & transformation, const ColorScheme *colorscheme);
+
+    // Bounding box of the object at position i in world coordinates
+    void update_bounds(int i);
+
+    // World transformation, pivot and bounding box of the object at position
+    // i from its parent at position parent (-1 for roots)
+    void compose_world(int i, int parent);
+
+    // World transformation of an object from the local ones of it and its
+    // ancestors, up to date before update_world()
+    mat4 world_transformation(Handle object) const;
+
+    // Local matrix of the object at position i, up to date before
+    // update_world(). Reparenting sets the matrix, the components are its
+    // decomposition (without shear)
+    mat4 local_matrix(int i) const;
+    void set_local_matrix(int i, const mat4 & A);
+
+    // Sort objects in breadth-first order of the hierarchy
+    void build_hierarchy();
+
+    // Mark the transformation of the object at position i as changed, it's
+    // composed with its subtree by update_world()
+    void mark_dirty(int i);
+
     // Calculate a parallel projection of a point to the screen plane
-    vec2 camera_plane_projection(vec3 point);
+    vec2 camera_plane_projection(const vec3 & point);
+
+    // Radius of the projected bounding sphere of a mesh with a model
+    // transformation in pixels, view is the transformation of the active
+    // camera without projection
+    GLfloat projected_radius(const Mesh & mesh, const mat4 & model,
+        const mat4 & view);
 
     // Translates object along the axis according to the speed of pointer
     void axis_transform(unsigned int axis, double delta_x, double delta_y);
@@ -179,7 +445,7 @@ private:
     void draw_active_controller();
 
     // Send camera transfomration to shader
-    void use_camera(Camera cam);
+    void use_camera(const Camera & cam);
 };
 
 #endif
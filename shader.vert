@@ -1,6 +1,9 @@
 #version 410
 
-in vec4 vertex_position;
+layout(location = 0) in vec4 vertex_position;
+
+// Octahedral encoded normal (normal lines only)
+layout(location = 1) in vec2 vertex_normal;
 
 // Camera transformation
 uniform mat4 camera;
@@ -8,8 +11,32 @@ uniform mat4 camera;
 // Local transformation
 uniform mat4 local_transformation;
 
+// Dequantisation of positions: offset + scale * position
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
+// Length of normal lines, the second vertex of a line is moved along normal
+uniform float normal_length;
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(
+            n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+
+    return normalize(n);
+}
+
 void main()
 {
-    gl_Position =
-        camera * local_transformation * vertex_position / vertex_position.w;
+    vec3 position = position_offset +
+        position_scale * vertex_position.xyz / vertex_position.w;
+
+    if (normal_length > 0.0)
+        position +=
+            float(gl_VertexID) * normal_length * oct_decode(vertex_normal);
+
+    gl_Position = camera * local_transformation * vec4(position, 1.0);
 }
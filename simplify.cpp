@@ -0,0 +1,443 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+using namespace std;
+
+// Weight of planes that keep boundary edges in place
+const double boundary_weight = 100.0;
+
+// Minimal cosine between face normals before and after a collapse
+const double flip_tolerance = 0.2;
+
+//
+// Quadric
+//
+
+Simplifier::Quadric::Quadric()
+{
+    for (int i = 0; i < 10; i++)
+        q[i] = 0;
+}
+
+Simplifier::Quadric::Quadric(double a, double b, double c, double d)
+{
+    q[0] = a * a, q[1] = a * b, q[2] = a * c, q[3] = a * d;
+    q[4] = b * b, q[5] = b * c, q[6] = b * d;
+    q[7] = c * c, q[8] = c * d;
+    q[9] = d * d;
+}
+
+Simplifier::Quadric & Simplifier::Quadric::operator += (const Quadric & Q)
+{
+    for (int i = 0; i < 10; i++)
+        q[i] += Q.q[i];
+
+    return *this;
+}
+
+Simplifier::Quadric Simplifier::Quadric::operator * (double s) const
+{
+    Quadric Q;
+    for (int i = 0; i < 10; i++)
+        Q.q[i] = q[i] * s;
+
+    return Q;
+}
+
+double Simplifier::Quadric::error(const vec3 & v) const
+{
+    double x = v.x, y = v.y, z = v.z;
+
+    return
+        q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+        q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+        q[7] * z * z + 2 * q[8] * z +
+        q[9];
+}
+
+bool Simplifier::Quadric::optimum(vec3 & v) const
+{
+    // Solve A x = b by Cramer's rule, where A is the upper left 3 by 3 block
+    double a00 = q[0], a01 = q[1], a02 = q[2],
+           a11 = q[4], a12 = q[5], a22 = q[7];
+    double b0 = -q[3], b1 = -q[6], b2 = -q[8];
+
+    double c00 = a11 * a22 - a12 * a12;
+    double c01 = a02 * a12 - a01 * a22;
+    double c02 = a01 * a12 - a02 * a11;
+
+    double d = a00 * c00 + a01 * c01 + a02 * c02;
+
+    if (fabs(d) < 1e-12)
+        return false;
+
+    double c11 = a00 * a22 - a02 * a02;
+    double c12 = a01 * a02 - a00 * a12;
+    double c22 = a00 * a11 - a01 * a01;
+
+    v.x = (c00 * b0 + c01 * b1 + c02 * b2) / d;
+    v.y = (c01 * b0 + c11 * b1 + c12 * b2) / d;
+    v.z = (c02 * b0 + c12 * b1 + c22 * b2) / d;
+
+    return true;
+}
+
+//
+// Simplifier
+//
+
+namespace {
+
+// Exact position key, used to weld vertices that share a position
+struct PositionHash {
+    size_t operator () (const vec3 & v) const
+    {
+        unsigned int b[3];
+        memcpy(b, &v.x, sizeof(b));
+        return (b[0] * 73856093u) ^ (b[1] * 19349663u) ^ (b[2] * 83492791u);
+    }
+};
+
+struct PositionEqual {
+    bool operator () (const vec3 & u, const vec3 & v) const
+    {
+        return u.x == v.x && u.y == v.y && u.z == v.z;
+    }
+};
+
+inline unsigned long long edge_key(GLuint a, GLuint b)
+{
+    if (a > b)
+        swap(a, b);
+
+    return ((unsigned long long) a << 32) | b;
+}
+
+}
+
+Simplifier::Simplifier(const vec3 *vertices, int v_number,
+    const GLuint *faces, int f_number)
+{
+    // Weld vertices with equal positions, so that seams don't open
+    unordered_map<vec3, GLuint, PositionHash, PositionEqual> welded;
+    vector<GLuint> remap(v_number);
+
+    for (int i = 0; i < v_number; i++) {
+        auto it = welded.find(vertices[i]);
+
+        if (it == welded.end()) {
+            remap[i] = v_.size();
+            welded[vertices[i]] = v_.size();
+            v_.push_back(vertices[i]);
+        } else
+            remap[i] = it -> second;
+    }
+
+    // Faces, degenerate after welding ones are dropped
+    f_.reserve(f_number * 3);
+    for (int i = 0; i < f_number; i++) {
+        GLuint a = remap[faces[3 * i]],
+               b = remap[faces[3 * i + 1]],
+               c = remap[faces[3 * i + 2]];
+
+        if (a == b || b == c || c == a)
+            continue;
+
+        f_.push_back(a), f_.push_back(b), f_.push_back(c);
+    }
+
+    f_number_ = f_.size() / 3;
+
+    quadrics_.resize(v_.size());
+    adjacency_.resize(v_.size());
+    stamp_.assign(v_.size(), 0);
+    vertex_removed_.assign(v_.size(), false);
+    face_removed_.assign(f_number_, false);
+
+    // Number of faces sharing every edge
+    unordered_map<unsigned long long, int> edges;
+
+    for (int i = 0; i < f_number_; i++)
+        for (int j = 0; j < 3; j++)
+            edges[edge_key(f_[3 * i + j], f_[3 * i + (j + 1) % 3])]++;
+
+    // Plane quadrics weighted by area
+    for (int i = 0; i < f_number_; i++) {
+        const vec3 & p0 = v_[f_[3 * i]];
+        const vec3 & p1 = v_[f_[3 * i + 1]];
+        const vec3 & p2 = v_[f_[3 * i + 2]];
+
+        vec3 n = (p1 - p0) * (p2 - p0);
+        double area = length(n) / 2;
+
+        for (int j = 0; j < 3; j++)
+            adjacency_[f_[3 * i + j]].push_back(i);
+
+        if (area == 0)
+            continue;
+
+        n /= 2 * area;
+
+        Quadric Q = Quadric(n.x, n.y, n.z, -dot(n, p0)) * area;
+
+        for (int j = 0; j < 3; j++)
+            quadrics_[f_[3 * i + j]] += Q;
+
+        // Planes perpendicular to the face through boundary edges
+        for (int j = 0; j < 3; j++) {
+            GLuint a = f_[3 * i + j], b = f_[3 * i + (j + 1) % 3];
+
+            if (edges[edge_key(a, b)] != 1)
+                continue;
+
+            vec3 e = v_[b] - v_[a];
+            vec3 m = e * n;
+            double l = length(m);
+
+            if (l == 0)
+                continue;
+
+            m /= l;
+
+            Quadric B = Quadric(m.x, m.y, m.z, -dot(m, v_[a])) *
+                (boundary_weight * dot(e, e));
+
+            quadrics_[a] += B;
+            quadrics_[b] += B;
+        }
+    }
+
+    // Initial candidates
+    heap_.reserve(edges.size());
+    for (auto it = edges.begin(); it != edges.end(); ++it)
+        push_collapse(it -> first >> 32, it -> first & 0xffffffff);
+}
+
+void Simplifier::neighbours(GLuint v, vector<GLuint> & out) const
+{
+    out.clear();
+
+    for (unsigned int i = 0; i < adjacency_[v].size(); i++) {
+        int face = adjacency_[v][i];
+
+        if (face_removed_[face])
+            continue;
+
+        for (int j = 0; j < 3; j++)
+            if (f_[3 * face + j] != v)
+                out.push_back(f_[3 * face + j]);
+    }
+
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+int Simplifier::shared_faces(GLuint v0, GLuint v1) const
+{
+    int n = 0;
+
+    for (unsigned int i = 0; i < adjacency_[v0].size(); i++) {
+        int face = adjacency_[v0][i];
+
+        if (face_removed_[face])
+            continue;
+
+        if (f_[3 * face] == v1 || f_[3 * face + 1] == v1 ||
+            f_[3 * face + 2] == v1)
+            n++;
+    }
+
+    return n;
+}
+
+void Simplifier::push_collapse(GLuint v0, GLuint v1)
+{
+    Quadric Q = quadrics_[v0];
+    Q += quadrics_[v1];
+
+    Collapse c;
+    c.v0 = v0, c.v1 = v1;
+    c.stamp0 = stamp_[v0], c.stamp1 = stamp_[v1];
+
+    // Optimal point if it exists, otherwise the best of ends and midpoint
+    vec3 candidates[4] = { v_[v0], v_[v1], (v_[v0] + v_[v1]) / 2, 0 };
+    int n = Q.optimum(candidates[3]) ? 4 : 3;
+
+    c.cost = Q.error(candidates[0]);
+    c.target = candidates[0];
+
+    for (int i = 1; i < n; i++) {
+        double e = Q.error(candidates[i]);
+        if (e < c.cost)
+            c.cost = e, c.target = candidates[i];
+    }
+
+    heap_.push_back(c);
+    push_heap(heap_.begin(), heap_.end());
+}
+
+bool Simplifier::valid(const Collapse & c) const
+{
+    // Link condition: common neighbours are exactly the opposite vertices
+    // of the faces sharing the edge
+    vector<GLuint> n0, n1, common;
+    neighbours(c.v0, n0);
+    neighbours(c.v1, n1);
+
+    set_intersection(n0.begin(), n0.end(), n1.begin(), n1.end(),
+        back_inserter(common));
+
+    if ((int) common.size() != shared_faces(c.v0, c.v1))
+        return false;
+
+    // Faces that are moved must not flip or degenerate
+    GLuint ends[2] = { c.v0, c.v1 };
+
+    for (int k = 0; k < 2; k++)
+        for (unsigned int i = 0; i < adjacency_[ends[k]].size(); i++) {
+            int face = adjacency_[ends[k]][i];
+
+            if (face_removed_[face])
+                continue;
+
+            vec3 p[3], q[3];
+            bool shared = false;
+
+            for (int j = 0; j < 3; j++) {
+                GLuint v = f_[3 * face + j];
+                p[j] = v_[v];
+                q[j] = (v == c.v0 || v == c.v1) ? c.target : v_[v];
+                shared = shared || v == ends[1 - k];
+            }
+
+            if (shared)
+                continue;
+
+            vec3 before = (p[1] - p[0]) * (p[2] - p[0]);
+            vec3 after = (q[1] - q[0]) * (q[2] - q[0]);
+
+            double la = length(after), lb = length(before);
+
+            if (la == 0)
+                return false;
+
+            if (lb > 0 && dot(before, after) < flip_tolerance * la * lb)
+                return false;
+        }
+
+    return true;
+}
+
+void Simplifier::apply(const Collapse & c)
+{
+    v_[c.v0] = c.target;
+    quadrics_[c.v0] += quadrics_[c.v1];
+
+    // Move faces of v1 to v0, the ones sharing the edge vanish
+    for (unsigned int i = 0; i < adjacency_[c.v1].size(); i++) {
+        int face = adjacency_[c.v1][i];
+
+        if (face_removed_[face])
+            continue;
+
+        bool shared = false;
+        for (int j = 0; j < 3; j++)
+            if (f_[3 * face + j] == c.v0)
+                shared = true;
+
+        if (shared) {
+            face_removed_[face] = true;
+            f_number_--;
+            continue;
+        }
+
+        for (int j = 0; j < 3; j++)
+            if (f_[3 * face + j] == c.v1)
+                f_[3 * face + j] = c.v0;
+
+        adjacency_[c.v0].push_back(face);
+    }
+
+    vector<int>().swap(adjacency_[c.v1]);
+    vertex_removed_[c.v1] = true;
+
+    // Compact adjacency of the kept vertex
+    vector<int> & a = adjacency_[c.v0];
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < a.size(); i++)
+        if (!face_removed_[a[i]])
+            a[k++] = a[i];
+    a.resize(k);
+
+    stamp_[c.v0]++;
+    stamp_[c.v1]++;
+
+    // New candidates around the kept vertex
+    vector<GLuint> n;
+    neighbours(c.v0, n);
+
+    for (unsigned int i = 0; i < n.size(); i++)
+        push_collapse(c.v0, n[i]);
+}
+
+int Simplifier::simplify(int target_faces, const atomic<bool> *cancel)
+{
+    while (f_number_ > target_faces && !heap_.empty()) {
+        if (cancel != 0 && cancel -> load(memory_order_relaxed))
+            break;
+
+        pop_heap(heap_.begin(), heap_.end());
+        Collapse c = heap_.back();
+        heap_.pop_back();
+
+        // Outdated candidate
+        if (vertex_removed_[c.v0] || vertex_removed_[c.v1] ||
+            stamp_[c.v0] != c.stamp0 || stamp_[c.v1] != c.stamp1)
+            continue;
+
+        if (!valid(c))
+            continue;
+
+        apply(c);
+    }
+
+    return f_number_;
+}
+
+int Simplifier::faces() const
+{
+    return f_number_;
+}
+
+void Simplifier::extract(Geometry & g) const
+{
+    vector<int> remap(v_.size(), -1);
+    int v_number = 0;
+
+    for (unsigned int i = 0; i < face_removed_.size(); i++) {
+        if (face_removed_[i])
+            continue;
+
+        for (int j = 0; j < 3; j++)
+            if (remap[f_[3 * i + j]] == -1)
+                remap[f_[3 * i + j]] = v_number++;
+    }
+
+    g.allocate(v_number, f_number_);
+
+    for (unsigned int i = 0; i < v_.size(); i++)
+        if (remap[i] != -1)
+            g.v[remap[i]] = v_[i];
+
+    int k = 0;
+    for (unsigned int i = 0; i < face_removed_.size(); i++) {
+        if (face_removed_[i])
+            continue;
+
+        for (int j = 0; j < 3; j++)
+            g.f[k++] = remap[f_[3 * i + j]];
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef SIMPLIFY_HPP
+#define SIMPLIFY_HPP
+
+#include <atomic>
+#include <vector>
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+#include "geometry.hpp"
+
+// Quadric error metric edge collapse simplifier (Garland and Heckbert).
+// Collapses are applied to an inner copy of the mesh incrementally, so a chain
+// of levels of detail is produced by calling simplify() with decreasing
+// targets and extracting the geometry after each call
+class Simplifier {
+
+    // Symmetric 4 by 4 matrix, upper triangle stored row by row
+    struct Quadric {
+        double q[10];
+
+        Quadric();
+        Quadric(double a, double b, double c, double d);
+
+        Quadric & operator += (const Quadric & Q);
+        Quadric operator * (double s) const;
+
+        // Error of a point
+        double error(const vec3 & v) const;
+
+        // Point of minimal error, false if the system is degenerate
+        bool optimum(vec3 & v) const;
+    };
+
+    // Candidate collapse (v0, v1) -> v0, stamps are used for lazy deletion
+    struct Collapse {
+        double cost;
+        GLuint v0, v1;
+        unsigned int stamp0, stamp1;
+        vec3 target;
+
+        bool operator < (const Collapse & c) const { return cost > c.cost; }
+    };
+
+    std::vector<vec3> v_;
+    std::vector<GLuint> f_;
+    std::vector<Quadric> quadrics_;
+
+    // Faces incident to a vertex (may contain removed faces)
+    std::vector< std::vector<int> > adjacency_;
+
+    std::vector<unsigned int> stamp_;
+    std::vector<bool> vertex_removed_, face_removed_;
+
+    std::vector<Collapse> heap_;
+
+    int f_number_;
+
+    // Neighbour vertices and faces shared by both ends of an edge
+    void neighbours(GLuint v, std::vector<GLuint> & out) const;
+    int shared_faces(GLuint v0, GLuint v1) const;
+
+    // Compute the cost of collapsing an edge and push it to the heap
+    void push_collapse(GLuint v0, GLuint v1);
+
+    // Check if collapse keeps the surface manifold and doesn't flip faces
+    bool valid(const Collapse & c) const;
+
+    void apply(const Collapse & c);
+
+public:
+
+    Simplifier(const vec3 *vertices, int v_number, const GLuint *faces,
+        int f_number);
+
+    // Collapse edges until there are at most target_faces faces, returns
+    // the number of faces left; stops early if no valid collapse is left or
+    // cancel becomes true
+    int simplify(int target_faces, const std::atomic<bool> *cancel = 0);
+
+    // Current number of faces
+    int faces() const;
+
+    // Copy current state to g, unused vertices are dropped
+    void extract(Geometry & g) const;
+};
+
+#endif
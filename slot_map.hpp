@@ -0,0 +1,273 @@
+#ifndef SLOT_MAP_HPP
+#define SLOT_MAP_HPP
+
+#include <atomic>
+#include <vector>
+
+// Handle of an element of a SlotMap: index of its slot and the generation of
+// the slot when the element was added. Handles of removed elements are stale,
+// the slot has moved to the next generation
+struct Handle {
+    unsigned int index, generation;
+
+    bool operator == (const Handle & h) const {
+        return index == h.index && generation == h.generation;
+    }
+
+    bool operator != (const Handle & h) const {
+        return !(*this == h);
+    }
+};
+
+// Handle that never refers to an element
+const Handle null_handle = { ~0u, 0 };
+
+// Dense slot map: elements are kept contiguous, in the order they were added
+// until one is removed (the last element takes its place). Handles lead to
+// them through slots, so lookup, insertion and removal are O(1) and stale
+// handles are detected
+template <class D>
+class SlotMap {
+
+private:
+
+    // Slots of elements keep their position in dense_, free slots the next
+    // free slot
+    struct Slot {
+        unsigned int position;
+        unsigned int generation;
+    };
+
+    std::vector<D> dense_;
+    std::vector<unsigned int> slot_of_;     // Slot of every element
+    std::vector<Slot> slots_;
+    unsigned int free_;                     // First free slot, or ~0u
+
+    // Number of slots ever taken, by insert() or reserve(); slots_ catches
+    // up when they are used. Reserved slots have position ~0u until their
+    // element is inserted
+    std::atomic<unsigned int> next_slot_;
+
+public:
+
+    SlotMap();
+
+    //
+    // Methods
+    //
+
+    // Add element to the end, into a slot given by reserve() unless reserved
+    // is null_handle, O(1) amortised
+    Handle insert(const D & x, Handle reserved = null_handle);
+
+    // Handle of a new slot for an element inserted later, from any thread
+    // (the only method that is thread-safe); it refers to nothing until
+    // then, O(1)
+    Handle reserve();
+
+    // Remove element, the last one is moved to its position, O(1); returns
+    // false for stale handles
+    bool remove(Handle h);
+
+    // Remove all elements, handles become stale, O(n)
+    void clear();
+
+    // Reorder elements, the one at position order[k] is moved to position k;
+    // handles stay valid, O(n)
+    void permute(const std::vector<int> & order);
+
+    // Whether a handle refers to an element, O(1)
+    bool contains(Handle h) const;
+
+    // Position of the element of a valid handle and handle of the element at
+    // a position, O(1)
+    int index(Handle h) const;
+    Handle handle(int i) const;
+
+    // Number of elements, O(1)
+    int size() const;
+
+    // Size of the arrays in bytes, O(1)
+    long long bytes() const;
+
+    // Contiguous elements
+    D * begin();
+    D * end();
+    const D * begin() const;
+    const D * end() const;
+
+    //
+    // Operator overloading
+    //
+
+    // Element of a valid handle, O(1)
+    D & operator [] (Handle h);
+    const D & operator [] (Handle h) const;
+};
+
+//
+// Implementation
+//
+
+template <class D>
+SlotMap<D>::SlotMap() : next_slot_(0)
+{
+    free_ = ~0u;
+}
+
+template <class D>
+Handle SlotMap<D>::insert(const D & x, Handle reserved)
+{
+    unsigned int slot = reserved.index;
+
+    if (reserved == null_handle && free_ != ~0u) {
+        slot = free_;
+        free_ = slots_[slot].position;
+    } else {
+        if (reserved == null_handle)
+            slot = next_slot_++;
+
+        // Slots reserved meanwhile by other threads wait for their elements
+        while (slots_.size() <= slot) {
+            Slot reserved_slot = { ~0u, 1 };
+            slots_.push_back(reserved_slot);
+        }
+    }
+
+    slots_[slot].position = dense_.size();
+
+    dense_.push_back(x);
+    slot_of_.push_back(slot);
+
+    Handle h = { slot, slots_[slot].generation };
+    return h;
+}
+
+template <class D>
+Handle SlotMap<D>::reserve()
+{
+    Handle h = { next_slot_++, 1 };
+    return h;
+}
+
+template <class D>
+bool SlotMap<D>::remove(Handle h)
+{
+    if (!contains(h))
+        return false;
+
+    unsigned int i = slots_[h.index].position;
+    unsigned int last = dense_.size() - 1;
+
+    if (i != last) {
+        dense_[i] = dense_[last];
+        slot_of_[i] = slot_of_[last];
+        slots_[slot_of_[i]].position = i;
+    }
+
+    dense_.pop_back();
+    slot_of_.pop_back();
+
+    slots_[h.index].generation++;
+    slots_[h.index].position = free_;
+    free_ = h.index;
+
+    return true;
+}
+
+template <class D>
+void SlotMap<D>::clear()
+{
+    while (!dense_.empty())
+        remove(handle(dense_.size() - 1));
+}
+
+template <class D>
+void SlotMap<D>::permute(const std::vector<int> & order)
+{
+    std::vector<D> dense(dense_.size());
+    std::vector<unsigned int> slot_of(slot_of_.size());
+
+    for (unsigned int k = 0; k < dense_.size(); k++) {
+        dense[k] = dense_[order[k]];
+        slot_of[k] = slot_of_[order[k]];
+        slots_[slot_of[k]].position = k;
+    }
+
+    dense_.swap(dense);
+    slot_of_.swap(slot_of);
+}
+
+template <class D>
+bool SlotMap<D>::contains(Handle h) const
+{
+    return h.index < slots_.size() &&
+        slots_[h.index].generation == h.generation &&
+        slots_[h.index].position < dense_.size() &&
+        slot_of_[slots_[h.index].position] == h.index;
+}
+
+template <class D>
+int SlotMap<D>::index(Handle h) const
+{
+    return slots_[h.index].position;
+}
+
+template <class D>
+Handle SlotMap<D>::handle(int i) const
+{
+    Handle h = { slot_of_[i], slots_[slot_of_[i]].generation };
+    return h;
+}
+
+template <class D>
+int SlotMap<D>::size() const
+{
+    return dense_.size();
+}
+
+template <class D>
+long long SlotMap<D>::bytes() const
+{
+    return (long long) dense_.capacity() * sizeof(D) +
+        slot_of_.capacity() * sizeof(unsigned int) +
+        slots_.capacity() * sizeof(Slot);
+}
+
+template <class D>
+D * SlotMap<D>::begin()
+{
+    return dense_.data();
+}
+
+template <class D>
+D * SlotMap<D>::end()
+{
+    return dense_.data() + dense_.size();
+}
+
+template <class D>
+const D * SlotMap<D>::begin() const
+{
+    return dense_.data();
+}
+
+template <class D>
+const D * SlotMap<D>::end() const
+{
+    return dense_.data() + dense_.size();
+}
+
+template <class D>
+D & SlotMap<D>::operator [] (Handle h)
+{
+    return dense_[slots_[h.index].position];
+}
+
+template <class D>
+const D & SlotMap<D>::operator [] (Handle h) const
+{
+    return dense_[slots_[h.index].position];
+}
+
+#endif
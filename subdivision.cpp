@@ -0,0 +1,523 @@
+#include "subdivision.hpp"
+#include "parallel.hpp"
+
+#include <cmath>
+
+// Faces of a subdivision level with their edges: corners of face i are
+// f[first(i)] ... f[first(i) + size(i) - 1], corner_edge[c] is the edge from
+// corner c to the next corner of its face. Owns its arrays
+struct Level {
+    vec3 *v;
+    GLuint *f;
+    int *offset;                // Null if every face has sides corners
+    int *corner_edge;
+    Edge *edges;
+    int v_number, f_number, sides, e_number;
+
+    Level(): v(0), f(0), offset(0), corner_edge(0), edges(0), v_number(0),
+        f_number(0), sides(0), e_number(0) {}
+
+    ~Level() { clear(); }
+
+    Level(const Level &) = delete;
+    Level & operator = (const Level &) = delete;
+
+    int first(int i) const { return offset != 0 ? offset[i] : sides * i; }
+    int size(int i) const {
+        return offset != 0 ? offset[i + 1] - offset[i] : sides;
+    }
+    int corners() const {
+        return offset != 0 ? offset[f_number] : sides * f_number;
+    }
+
+    void clear() {
+        delete[] v;
+        delete[] f;
+        delete[] offset;
+        delete[] corner_edge;
+        delete[] edges;
+
+        v = 0, f = 0, offset = corner_edge = 0, edges = 0;
+        v_number = f_number = sides = e_number = 0;
+    }
+};
+
+// Halves of edge i of the parent level are edges 2 * i (at its end a) and
+// 2 * i + 1 (at its end b) of the child level
+static inline int half(const Edge *edges, int i, GLuint end)
+{
+    return 2 * i + (edges[i].a == end ? 0 : 1);
+}
+
+// Side of an edge a face is on, -1 for further faces of non-manifold edges
+static inline int side(const Edge & e, int face)
+{
+    return e.face[0] == face ? 0 : e.face[1] == face ? 1 : -1;
+}
+
+// Edges of every vertex: adjacent[offset[i]] ... adjacent[offset[i + 1] - 1]
+static void vertex_edges(const Edge *edges, int e_number, int v_number,
+    int *&offset, int *&adjacent)
+{
+    offset = new int[v_number + 1];
+    adjacent = new int[e_number * 2];
+
+    for (int i = 0; i <= v_number; i++)
+        offset[i] = 0;
+    for (int i = 0; i < e_number; i++)
+        offset[edges[i].a + 1]++, offset[edges[i].b + 1]++;
+    for (int i = 0; i < v_number; i++)
+        offset[i + 1] += offset[i];
+
+    int *fill = new int[v_number];
+    for (int i = 0; i < v_number; i++)
+        fill[i] = offset[i];
+    for (int i = 0; i < e_number; i++) {
+        adjacent[fill[edges[i].a]++] = i;
+        adjacent[fill[edges[i].b]++] = i;
+    }
+
+    delete[] fill;
+}
+
+// Neighbourhood of a vertex: sums of its neighbours and of its neighbours
+// along boundary edges, and (given face points) sum of the face points of
+// its faces, every face counted once for manifold vertices
+struct Ring {
+    vec3 sum, boundary_sum, face_sum;
+    int n, boundary;
+    bool non_manifold;
+};
+
+static inline Ring vertex_ring(const vec3 *v, const Edge *edges,
+    const int *offset, const int *adjacent, GLuint i, const vec3 *face_point)
+{
+    Ring ring;
+    ring.sum = ring.boundary_sum = ring.face_sum = vec3(0);
+    ring.n = ring.boundary = 0;
+    ring.non_manifold = false;
+
+    for (int j = offset[i]; j < offset[i + 1]; j++) {
+        const Edge & e = edges[adjacent[j]];
+        const vec3 & other = v[e.a == i ? e.b : e.a];
+
+        ring.sum += other;
+        ring.n++;
+
+        if (e.face[1] == -1) {
+            ring.boundary_sum += other;
+            ring.boundary++;
+        } else if (e.face[1] == -2)
+            ring.non_manifold = true;
+        else if (face_point != 0)
+            ring.face_sum +=
+                (face_point[e.face[0]] + face_point[e.face[1]]) / 2;
+    }
+
+    return ring;
+}
+
+// Position of a vertex on the boundary, false for interior vertices
+static inline bool boundary_vertex(const vec3 & v, const Ring & ring,
+    vec3 & out)
+{
+    if (ring.boundary == 0 && !ring.non_manifold && ring.n > 0)
+        return false;
+
+    // Corners stay in place, vertices on a boundary curve are smoothed along it
+    if (ring.boundary == 2 && !ring.non_manifold)
+        out = v * 0.75 + ring.boundary_sum / 8;
+    else
+        out = v;
+
+    return true;
+}
+
+// Vertex of a triangle that isn't on the edge
+static inline GLuint opposite_vertex(const GLuint *f, int face, const Edge & e)
+{
+    for (int k = 0; k < 3; k++) {
+        GLuint c = f[3 * face + k];
+
+        if (c != e.a && c != e.b)
+            return c;
+    }
+
+    return e.a;
+}
+
+// Halves of a parent edge as edges of the child level, face[0] is set by the
+// faces
+static inline void split_edge(const Edge & e, GLuint middle, Edge *halves)
+{
+    halves[0].a = e.a, halves[1].a = e.b;
+
+    for (int k = 0; k < 2; k++) {
+        halves[k].b = middle;
+        halves[k].face[0] = -1;
+        halves[k].face[1] = e.face[1];
+    }
+}
+
+// Control mesh as the first level, corners repeating the previous one are
+// dropped and so are faces left with fewer than three
+static void control_level(const vec3 *v, int v_number, const GLuint *f,
+    const int *offset, int f_number, Level & level)
+{
+    level.v_number = v_number;
+    level.v = new vec3[v_number];
+    for (int i = 0; i < v_number; i++)
+        level.v[i] = v[i];
+
+    level.sides = offset != 0 ? 0 : 3;
+    level.offset = offset != 0 ? new int[f_number + 1] : 0;
+    level.f = new GLuint[offset != 0 ? offset[f_number] : 3 * f_number];
+
+    int corners = 0;
+
+    for (int i = 0; i < f_number; i++) {
+        int first = offset != 0 ? offset[i] : 3 * i;
+        int size = offset != 0 ? offset[i + 1] - first : 3, kept = 0;
+
+        for (int k = 0; k < size; k++)
+            if (f[first + k] != f[first + (k + size - 1) % size])
+                level.f[corners + kept++] = f[first + k];
+
+        if (kept < 3)
+            continue;
+
+        if (offset != 0)
+            level.offset[level.f_number] = corners;
+
+        corners += kept;
+        level.f_number++;
+    }
+
+    if (offset != 0)
+        level.offset[level.f_number] = corners;
+
+    level.corner_edge = new int[corners];
+    level.e_number = polygon_edges(level.f, level.offset, level.sides,
+        level.f_number, level.edges, level.corner_edge);
+}
+
+// Loop step: every triangle is split into four by points on its edges
+static void loop_step(const Level & in, Level & out)
+{
+    const vec3 *v = in.v;
+    const GLuint *f = in.f;
+    const Edge *edges = in.edges;
+    int n = in.v_number, e_number = in.e_number;
+
+    out.v_number = n + e_number;
+    out.f_number = in.f_number * 4;
+    out.sides = 3;
+    out.e_number = e_number * 2 + in.f_number * 3;
+
+    out.v = new vec3[out.v_number];
+    out.f = new GLuint[out.f_number * 3];
+    out.corner_edge = new int[out.f_number * 3];
+    out.edges = new Edge[out.e_number];
+
+    // 3/8 of the ends and 1/8 of the opposite vertices
+    parallel_for(e_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            const Edge & e = edges[i];
+
+            if (e.face[1] < 0)
+                out.v[n + i] = (v[e.a] + v[e.b]) / 2;
+            else
+                out.v[n + i] = (v[e.a] + v[e.b]) * 0.375 +
+                    (v[opposite_vertex(f, e.face[0], e)] +
+                    v[opposite_vertex(f, e.face[1], e)]) * 0.125;
+
+            split_edge(e, n + i, out.edges + 2 * i);
+        }
+    });
+
+    int *offset, *adjacent;
+    vertex_edges(edges, e_number, n, offset, adjacent);
+
+    // Loop's weights of n neighbours
+    parallel_for(n, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            Ring ring = vertex_ring(v, edges, offset, adjacent, i, 0);
+
+            if (boundary_vertex(v[i], ring, out.v[i]))
+                continue;
+
+            GLfloat c = 0.375 + 0.25 * cos(2 * pi / ring.n);
+            GLfloat beta = (0.625 - c * c) / ring.n;
+
+            out.v[i] = v[i] * (1 - ring.n * beta) + ring.sum * beta;
+        }
+    });
+
+    delete[] offset;
+    delete[] adjacent;
+
+    // Triangles at the corners (k-th at c[k]) and the middle one
+    parallel_for(in.f_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            GLuint c[3], m[3];
+            int e[3];
+
+            for (int k = 0; k < 3; k++) {
+                c[k] = f[3 * i + k];
+                e[k] = in.corner_edge[3 * i + k];
+                m[k] = n + e[k];
+            }
+
+            GLuint *o = out.f + 12 * i;
+
+            o[0] = c[0], o[1] = m[0], o[2] = m[2];
+            o[3] = m[0], o[4] = c[1], o[5] = m[1];
+            o[6] = m[2], o[7] = m[1], o[8] = c[2];
+            o[9] = m[0], o[10] = m[1], o[11] = m[2];
+
+            // Half of the k-th edge at c[k] is in the k-th triangle, the
+            // other one in the next triangle
+            for (int k = 0; k < 3; k++) {
+                int s = side(edges[e[k]], i);
+
+                if (s < 0)
+                    continue;
+
+                out.edges[half(edges, e[k], c[k])].face[s] = 4 * i + k;
+                out.edges[half(edges, e[k], c[(k + 1) % 3])].face[s] =
+                    4 * i + (k + 1) % 3;
+            }
+
+            // Inner edges, the k-th from m[k] to m[k + 2] is shared by the
+            // k-th triangle and the middle one
+            int inner = e_number * 2 + 3 * i;
+
+            for (int k = 0; k < 3; k++) {
+                Edge & g = out.edges[inner + k];
+                GLuint a = m[k], b = m[(k + 2) % 3];
+
+                g.a = a < b ? a : b, g.b = a < b ? b : a;
+                g.face[0] = 4 * i + k;
+                g.face[1] = 4 * i + 3;
+            }
+
+            int *ce = out.corner_edge + 12 * i;
+
+            ce[0] = half(edges, e[0], c[0]);
+            ce[1] = inner;
+            ce[2] = half(edges, e[2], c[0]);
+            ce[3] = half(edges, e[0], c[1]);
+            ce[4] = half(edges, e[1], c[1]);
+            ce[5] = inner + 1;
+            ce[6] = inner + 2;
+            ce[7] = half(edges, e[1], c[2]);
+            ce[8] = half(edges, e[2], c[2]);
+            ce[9] = inner + 1;
+            ce[10] = inner + 2;
+            ce[11] = inner;
+        }
+    });
+}
+
+// Catmull-Clark step: every face is split into quads, one per corner, by a
+// point in the middle of the face and points on its edges
+static void catmull_clark_step(const Level & in, Level & out)
+{
+    const vec3 *v = in.v;
+    const GLuint *f = in.f;
+    const Edge *edges = in.edges;
+    int n = in.v_number, f_number = in.f_number, e_number = in.e_number;
+    int corners = in.corners();
+
+    out.v_number = n + f_number + e_number;
+    out.f_number = corners;
+    out.sides = 4;
+    out.e_number = e_number * 2 + corners;
+
+    out.v = new vec3[out.v_number];
+    out.f = new GLuint[out.f_number * 4];
+    out.corner_edge = new int[out.f_number * 4];
+    out.edges = new Edge[out.e_number];
+
+    vec3 *face_point = out.v + n, *edge_point = face_point + f_number;
+
+    // Centroids of faces
+    parallel_for(f_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            int first = in.first(i), size = in.size(i);
+
+            vec3 sum(0);
+            for (int k = 0; k < size; k++)
+                sum += v[f[first + k]];
+
+            face_point[i] = sum / size;
+        }
+    });
+
+    // Average of the ends and the face points on both sides
+    parallel_for(e_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            const Edge & e = edges[i];
+
+            if (e.face[1] < 0)
+                edge_point[i] = (v[e.a] + v[e.b]) / 2;
+            else
+                edge_point[i] = (v[e.a] + v[e.b] + face_point[e.face[0]] +
+                    face_point[e.face[1]]) / 4;
+
+            split_edge(e, n + f_number + i, out.edges + 2 * i);
+        }
+    });
+
+    int *offset, *adjacent;
+    vertex_edges(edges, e_number, n, offset, adjacent);
+
+    // (F + 2R + (n - 3) P) / n: average of face points, of edge middles and
+    // the vertex itself
+    parallel_for(n, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            Ring ring = vertex_ring(v, edges, offset, adjacent, i, face_point);
+
+            if (boundary_vertex(v[i], ring, out.v[i]))
+                continue;
+
+            GLfloat valence = ring.n;
+            out.v[i] = v[i] * ((valence - 2) / valence) +
+                (ring.sum + ring.face_sum) / (valence * valence);
+        }
+    });
+
+    delete[] offset;
+    delete[] adjacent;
+
+    // Quad at every corner: the corner, the point of its edge, the face point
+    // and the point of the previous edge
+    parallel_for(f_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            int first = in.first(i), size = in.size(i);
+
+            for (int k = 0; k < size; k++) {
+                int c = first + k;
+                int next = first + (k + 1) % size;
+                int previous = first + (k + size - 1) % size;
+                int e = in.corner_edge[c], pe = in.corner_edge[previous];
+
+                GLuint *o = out.f + 4 * c;
+
+                o[0] = f[c];
+                o[1] = n + f_number + e;
+                o[2] = n + i;
+                o[3] = n + f_number + pe;
+
+                // Half of the edge at the corner is in this quad, the other
+                // one in the next quad
+                int s = side(edges[e], i);
+
+                if (s >= 0) {
+                    out.edges[half(edges, e, f[c])].face[s] = c;
+                    out.edges[half(edges, e, f[next])].face[s] = next;
+                }
+
+                // Inner edge from the face point to the edge point, shared
+                // with the next quad
+                Edge & g = out.edges[e_number * 2 + c];
+
+                g.a = n + i, g.b = n + f_number + e;
+                g.face[0] = c;
+                g.face[1] = next;
+
+                int *ce = out.corner_edge + 4 * c;
+
+                ce[0] = half(edges, e, f[c]);
+                ce[1] = e_number * 2 + c;
+                ce[2] = e_number * 2 + previous;
+                ce[3] = half(edges, pe, f[c]);
+            }
+        }
+    });
+}
+
+// Split faces of a level into fans of triangles around their first corners,
+// faces of its edges become the triangles at the edges
+static GLuint *triangulate(Level & level, int & f_number)
+{
+    if (level.offset == 0 && level.sides == 3) {
+        GLuint *f = level.f;
+        level.f = 0;
+        f_number = level.f_number;
+
+        return f;
+    }
+
+    f_number = level.corners() - level.f_number * 2;
+    GLuint *out = new GLuint[f_number * 3];
+
+    // Fan of face i starts with the triangle first(i) - 2 * i
+    parallel_for(level.f_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++) {
+            int first = level.first(i), size = level.size(i);
+            GLuint *o = out + 3 * (first - 2 * i);
+
+            for (int k = 2; k < size; k++) {
+                *o++ = level.f[first];
+                *o++ = level.f[first + k - 1];
+                *o++ = level.f[first + k];
+            }
+        }
+    });
+
+    // Edge from the k-th corner is in the (k - 1)-th triangle of the fan,
+    // the first and the last edge are in the first and the last triangle
+    parallel_for(level.e_number, [&](int begin, int end, int) {
+        for (int i = begin; i < end; i++)
+            for (int s = 0; s < 2; s++) {
+                int j = level.edges[i].face[s];
+
+                if (j < 0)
+                    continue;
+
+                int first = level.first(j), size = level.size(j), k = 0;
+
+                while (k < size - 1 && level.corner_edge[first + k] != i)
+                    k++;
+
+                k = k == 0 ? 0 : k == size - 1 ? size - 3 : k - 1;
+                level.edges[i].face[s] = first - 2 * j + k;
+            }
+    });
+
+    return out;
+}
+
+int subdivide(const vec3 *v, int v_number, const GLuint *f, const int *offset,
+    int f_number, int levels, vec3 *&out_v, GLuint *&out_f,
+    int & out_f_number, Edge *&out_edges, int & out_e_number)
+{
+    // Parent and child levels take turns
+    Level level[2];
+    control_level(v, v_number, f, offset, f_number, level[0]);
+
+    for (int l = 0; l < levels; l++) {
+        Level & in = level[l % 2], & out = level[(l + 1) % 2];
+
+        if (offset == 0)
+            loop_step(in, out);
+        else
+            catmull_clark_step(in, out);
+
+        in.clear();
+    }
+
+    Level & surface = level[levels % 2];
+
+    out_f = triangulate(surface, out_f_number);
+
+    out_v = surface.v;
+    out_edges = surface.edges;
+    out_e_number = surface.e_number;
+
+    surface.v = 0;
+    surface.edges = 0;
+
+    return surface.v_number;
+}
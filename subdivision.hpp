@@ -0,0 +1,29 @@
+#ifndef SUBDIVISION_HPP
+#define SUBDIVISION_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+#include "edges.hpp"
+
+// Subdivision surface of a control mesh after levels steps: Loop for triangle
+// meshes (offset is null), Catmull-Clark for polygons (corners of face i are
+// f[offset[i]] ... f[offset[i + 1] - 1]).
+//
+// Every step computes new positions by stencils in parallel over faces, edges
+// and vertices; old vertices keep their indices and new ones follow them.
+// Unique edges are found once for the control mesh (see edges.hpp), every
+// step derives the edges of its faces from those of the parent faces.
+// Boundary edges keep the boundary curve, vertices at the end of non-manifold
+// edges or of more than two boundary edges stay where they are; corners
+// repeating the previous one are dropped, and so are faces left with fewer
+// than three.
+//
+// out_v, out_f and out_edges are allocated with new[]: out_f are triangles
+// (polygons are split into fans), out_edges are the edges of the surface (of
+// quads for Catmull-Clark, fan diagonals aren't included) with faces in
+// out_f. Returns the number of vertices
+int subdivide(const vec3 *v, int v_number, const GLuint *f, const int *offset,
+    int f_number, int levels, vec3 *&out_v, GLuint *&out_f,
+    int & out_f_number, Edge *&out_edges, int & out_e_number);
+
+#endif
@@ -0,0 +1,36 @@
+#include "synthetic.hpp"
+
+#include <cmath>
+#include <random>
+
+void synthetic_scene(SyntheticObject *objects, int n, long long triangles,
+    int shape, unsigned int seed, GLfloat spacing)
+{
+    const Primitive cycle[] = { Primitive::icosphere, Primitive::uv_sphere,
+        Primitive::cylinder, Primitive::torus, Primitive::grid };
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<GLfloat> angle(0, 2 * pi), scale(0.5, 0.85);
+
+    int side = ceil(sqrt((double) n));
+    long long per_object = triangles / n > 0 ? triangles / n : 1;
+
+    for (int i = 0; i < n; i++) {
+        SyntheticObject & o = objects[i];
+
+        o.shape = shape >= 0 ? (Primitive) shape : cycle[i % 5];
+
+        o.resolution = primitive_resolution(o.shape, per_object);
+
+        vec3 cell = vec3(i % side - (side - 1) / 2.0, 0,
+            i / side - (side - 1) / 2.0) * spacing;
+
+        // Primitives fit the [-1, 1] cube (within sqrt(3) of the centre), so
+        // turned ones scaled below spacing / 3 stay in their cells
+        GLfloat a = angle(random), b = angle(random);
+        GLfloat s = scale(random) * spacing / 3;
+
+        o.transformation = Transform(cell,
+            quat(vec3(0, 1, 0), -a) * quat(vec3(1, 0, 0), b), vec3(s));
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef SYNTHETIC_HPP
+#define SYNTHETIC_HPP
+
+#include "graphics_root.hpp"
+#include "mat.hpp"
+#include "primitives.hpp"
+
+// Object of a synthetic scene: a primitive (see primitives.hpp) and its model
+// transformation
+struct SyntheticObject {
+    Primitive shape;
+    int resolution;
+    Transform transformation;
+};
+
+// Fill n objects of a scene of about triangles in total, for tests at scale.
+// Objects stand in the cells of a square grid spacing apart in the y = 0
+// plane, turned and scaled (to fit their cells) at random: the same seed
+// gives the same scene. shape is a Primitive, or -1 to cycle through all the
+// shapes but the box
+void synthetic_scene(SyntheticObject *objects, int n, long long triangles,
+    int shape, unsigned int seed, GLfloat spacing);
+
+#endif
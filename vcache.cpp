@@ -0,0 +1,374 @@
+#include "vcache.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// ACMR below which a cluster of the overdraw order may end at a face with
+// two cache misses: higher values give more clusters at some cache cost
+const float overdraw_lambda = 0.75;
+
+// Score of a vertex by its position in the cache and by the number of faces
+// not yet added that use it
+static float vertex_score(int cache_position, int remaining)
+{
+    if (remaining == 0)
+        return -1;
+
+    float score = 0;
+
+    if (cache_position >= 0) {
+        // Vertices of the last face are scored equally, so that the order
+        // of the face doesn't matter
+        if (cache_position < 3)
+            score = 0.75;
+        else
+            score = pow(1 - (cache_position - 3) /
+                (float) (forsyth_cache_size - 3), 1.5);
+    }
+
+    // Vertices with few faces left are preferred, to finish them off
+    return score + 2 * pow(remaining, -0.5);
+}
+
+CacheStats vertex_cache_stats(const GLuint *f, int f_number, int v_number,
+    int cache_size)
+{
+    CacheStats stats;
+    stats.acmr = stats.atvr = 0;
+
+    if (f_number == 0 || v_number == 0)
+        return stats;
+
+    // Time stamp of a vertex entering the FIFO cache
+    int *stamp = new int[v_number];
+    for (int i = 0; i < v_number; i++)
+        stamp[i] = -cache_size - 1;
+
+    int misses = 0;
+
+    for (int i = 0; i < f_number * 3; i++)
+        if (misses - stamp[f[i]] > cache_size) {
+            stamp[f[i]] = misses;
+            misses++;
+        }
+
+    delete[] stamp;
+
+    stats.acmr = misses / (double) f_number;
+    stats.atvr = misses / (double) v_number;
+
+    return stats;
+}
+
+void vertex_cache_order(const GLuint *f, int f_number, int v_number,
+    int *order)
+{
+    // Faces of every vertex: faces[offset[v]] ... faces[offset[v + 1] - 1],
+    // the first remaining[v] of them are not added yet
+    int *offset = new int[v_number + 1];
+    int *remaining = new int[v_number];
+    int *faces = new int[f_number * 3];
+
+    for (int i = 0; i < v_number; i++)
+        remaining[i] = 0;
+    for (int i = 0; i < f_number * 3; i++)
+        remaining[f[i]]++;
+
+    offset[0] = 0;
+    for (int i = 0; i < v_number; i++)
+        offset[i + 1] = offset[i] + remaining[i];
+
+    for (int i = 0; i < v_number; i++)
+        remaining[i] = 0;
+    for (int i = 0; i < f_number * 3; i++)
+        faces[offset[f[i]] + remaining[f[i]]++] = i / 3;
+
+    int *position = new int[v_number];
+    float *score = new float[v_number];
+
+    for (int i = 0; i < v_number; i++) {
+        position[i] = -1;
+        score[i] = vertex_score(-1, remaining[i]);
+    }
+
+    bool *added = new bool[f_number];
+    float *face_score = new float[f_number];
+
+    for (int i = 0; i < f_number; i++) {
+        added[i] = false;
+        face_score[i] = score[f[3 * i]] + score[f[3 * i + 1]] +
+            score[f[3 * i + 2]];
+    }
+
+    // Cache is one face larger, so that pushed out vertices can be rescored
+    int cache[forsyth_cache_size + 3], cache_number = 0;
+    int new_cache[forsyth_cache_size + 3];
+
+    int best = -1;
+    int cursor = 0;     // All the faces before it are added
+
+    int *dead_end = new int[f_number * 3], dead_end_number = 0;
+
+    for (int n = 0; n < f_number; n++) {
+
+        // Nothing in cache to continue with: the best face of the latest
+        // vertex with faces left (vertices of added faces are stacked, as in
+        // Tipsify), or the next remaining face in the input order. Every
+        // vertex is popped and every face passed over once
+        while (best == -1 && dead_end_number > 0) {
+            int v = dead_end[--dead_end_number];
+
+            for (int k = 0; k < remaining[v]; k++) {
+                int face = faces[offset[v] + k];
+
+                if (best == -1 || face_score[face] > face_score[best])
+                    best = face;
+            }
+        }
+
+        if (best == -1) {
+            while (added[cursor])
+                cursor++;
+
+            best = cursor;
+        }
+
+        order[n] = best;
+        added[best] = true;
+
+        for (int j = 0; j < 3; j++)
+            dead_end[dead_end_number++] = f[3 * best + j];
+
+        // Remove the face from its vertices' lists of remaining faces
+        for (int j = 0; j < 3; j++) {
+            GLuint v = f[3 * best + j];
+            int *list = faces + offset[v];
+
+            for (int k = 0; k < remaining[v]; k++)
+                if (list[k] == best) {
+                    list[k] = list[--remaining[v]];
+                    list[remaining[v]] = best;
+                    break;
+                }
+        }
+
+        // Vertices of the face go to the front of the cache
+        int new_number = 0;
+        for (int j = 0; j < 3; j++)
+            new_cache[new_number++] = f[3 * best + j];
+
+        for (int i = 0; i < cache_number; i++) {
+            GLuint v = cache[i];
+
+            if (v != f[3 * best] && v != f[3 * best + 1] &&
+                v != f[3 * best + 2])
+                new_cache[new_number++] = v;
+        }
+
+        for (int i = 0; i < new_number; i++) {
+            cache[i] = new_cache[i];
+
+            int v = cache[i];
+            position[v] = i < forsyth_cache_size ? i : -1;
+            score[v] = vertex_score(position[v], remaining[v]);
+        }
+
+        // Rescore faces around cached vertices and the ones pushed out, pick
+        // the best of the cached ones
+        best = -1;
+        float best_score = -1;
+
+        for (int i = 0; i < new_number; i++) {
+            int v = cache[i];
+
+            for (int k = 0; k < remaining[v]; k++) {
+                int face = faces[offset[v] + k];
+
+                face_score[face] = score[f[3 * face]] +
+                    score[f[3 * face + 1]] + score[f[3 * face + 2]];
+
+                if (i < forsyth_cache_size && face_score[face] > best_score) {
+                    best_score = face_score[face];
+                    best = face;
+                }
+            }
+        }
+
+        cache_number = new_number < forsyth_cache_size ? new_number :
+            forsyth_cache_size;
+    }
+
+    delete[] offset;
+    delete[] remaining;
+    delete[] faces;
+    delete[] position;
+    delete[] score;
+    delete[] added;
+    delete[] face_score;
+    delete[] dead_end;
+}
+
+void overdraw_order(const vec3 *v, int v_number, const GLuint *f,
+    int f_number, int *order)
+{
+    if (f_number == 0)
+        return;
+
+    // Clusters start at faces whose three vertices all miss the cache, or
+    // two of them once the cluster has an ACMR below lambda, so reordering
+    // them loses few hits
+    int *cluster_start = new int[f_number + 1], cluster_number = 0;
+    int *stamp = new int[v_number];
+    int misses = 0, cluster_misses = 0;
+
+    for (int i = 0; i < v_number; i++)
+        stamp[i] = -forsyth_cache_size - 1;
+
+    for (int i = 0; i < f_number; i++) {
+        int face_misses = 0;
+
+        for (int j = 0; j < 3; j++) {
+            GLuint k = f[3 * order[i] + j];
+
+            if (misses - stamp[k] > forsyth_cache_size) {
+                stamp[k] = misses++;
+                face_misses++;
+            }
+        }
+
+        int faces = i - (cluster_number > 0 ?
+            cluster_start[cluster_number - 1] : 0);
+
+        if (i == 0 || face_misses == 3 || (face_misses == 2 &&
+            cluster_misses <= overdraw_lambda * faces)) {
+            cluster_start[cluster_number++] = i;
+            cluster_misses = 0;
+        }
+
+        cluster_misses += face_misses;
+    }
+
+    cluster_start[cluster_number] = f_number;
+
+    // Area weighted centroids and normals of the clusters and the mesh
+    vec3 *centre = new vec3[cluster_number];
+    vec3 *normal = new vec3[cluster_number];
+    vec3 mesh_centre(0);
+    GLfloat mesh_area = 0;
+
+    for (int c = 0; c < cluster_number; c++) {
+        vec3 sum(0), n(0);
+        GLfloat area = 0;
+
+        for (int i = cluster_start[c]; i < cluster_start[c + 1]; i++) {
+            const GLuint *t = f + 3 * order[i];
+            vec3 cross = (v[t[1]] - v[t[0]]) * (v[t[2]] - v[t[0]]);
+            GLfloat a = length(cross);
+
+            sum += a * (v[t[0]] + v[t[1]] + v[t[2]]) / 3;
+            n += cross;
+            area += a;
+        }
+
+        centre[c] = area > 0 ? sum / area : v[f[3 * order[cluster_start[c]]]];
+        normal[c] = n;
+        mesh_centre += sum;
+        mesh_area += area;
+    }
+
+    if (mesh_area > 0)
+        mesh_centre /= mesh_area;
+
+    // Clusters facing out of the mesh are drawn first, they occlude the
+    // ones behind them from most of the views
+    float *key = new float[cluster_number];
+    int *sorted = new int[cluster_number];
+
+    for (int c = 0; c < cluster_number; c++) {
+        GLfloat l = length(normal[c]);
+
+        key[c] = l > 0 ? dot(centre[c] - mesh_centre, normal[c]) / l : 0;
+        sorted[c] = c;
+    }
+
+    std::stable_sort(sorted, sorted + cluster_number, [key](int a, int b) {
+        return key[a] > key[b];
+    });
+
+    int *tmp = new int[f_number], n = 0;
+
+    for (int k = 0; k < cluster_number; k++) {
+        int c = sorted[k];
+
+        for (int i = cluster_start[c]; i < cluster_start[c + 1]; i++)
+            tmp[n++] = order[i];
+    }
+
+    for (int i = 0; i < f_number; i++)
+        order[i] = tmp[i];
+
+    delete[] cluster_start;
+    delete[] stamp;
+    delete[] centre;
+    delete[] normal;
+    delete[] key;
+    delete[] sorted;
+    delete[] tmp;
+}
+
+void vertex_fetch_order(vec3 *v, int v_number, GLuint *f, int f_number,
+    vec3 *vn)
+{
+    int *remap = new int[v_number];
+    for (int i = 0; i < v_number; i++)
+        remap[i] = -1;
+
+    int n = 0;
+    for (int i = 0; i < f_number * 3; i++) {
+        if (remap[f[i]] == -1)
+            remap[f[i]] = n++;
+
+        f[i] = remap[f[i]];
+    }
+
+    for (int i = 0; i < v_number; i++)
+        if (remap[i] == -1)
+            remap[i] = n++;
+
+    vec3 *tmp = new vec3[v_number];
+    for (int i = 0; i < v_number; i++)
+        tmp[remap[i]] = v[i];
+    for (int i = 0; i < v_number; i++)
+        v[i] = tmp[i];
+
+    if (vn != 0) {
+        for (int i = 0; i < v_number; i++)
+            tmp[remap[i]] = vn[i];
+        for (int i = 0; i < v_number; i++)
+            vn[i] = tmp[i];
+    }
+
+    delete[] tmp;
+    delete[] remap;
+}
+
+void optimize_vertex_cache(vec3 *v, int v_number, GLuint *f, int f_number,
+    vec3 *vn)
+{
+    int *order = new int[f_number];
+    vertex_cache_order(f, f_number, v_number, order);
+    overdraw_order(v, v_number, f, f_number, order);
+
+    GLuint *tmp = new GLuint[f_number * 3];
+
+    for (int i = 0; i < f_number; i++)
+        for (int j = 0; j < 3; j++)
+            tmp[3 * i + j] = f[3 * order[i] + j];
+    for (int i = 0; i < f_number * 3; i++)
+        f[i] = tmp[i];
+
+    delete[] tmp;
+    delete[] order;
+
+    vertex_fetch_order(v, v_number, f, f_number, vn);
+}
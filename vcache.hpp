@@ -0,0 +1,41 @@
+#ifndef VCACHE_HPP
+#define VCACHE_HPP
+
+#include "graphics_root.hpp"
+#include "vec.hpp"
+
+// Post-transform vertex cache efficiency of an index array, simulated with a
+// FIFO cache of a given size
+struct CacheStats {
+    double acmr;        // Average cache miss ratio, misses per triangle
+    double atvr;        // Average transformed vertex ratio, misses per vertex
+};
+
+CacheStats vertex_cache_stats(const GLuint *f, int f_number, int v_number,
+    int cache_size = 16);
+
+// Size of the cache modelled by the optimiser
+const int forsyth_cache_size = 32;
+
+// Forsyth's linear-speed vertex cache optimisation, order[i] is the index of
+// the face to be drawn i-th
+void vertex_cache_order(const GLuint *f, int f_number, int v_number,
+    int *order);
+
+// Tipsify's overdraw ordering of faces already in vertex cache order: the
+// order is split into clusters where the cache misses all three vertices of
+// a face, and clusters facing out of the mesh (from its centroid) go first
+void overdraw_order(const vec3 *v, int v_number, const GLuint *f,
+    int f_number, int *order);
+
+// Reorder vertices by their first use in f (unused vertices go last), f is
+// updated accordingly and vertex normals vn (if not null) are reordered too
+void vertex_fetch_order(vec3 *v, int v_number, GLuint *f, int f_number,
+    vec3 *vn = 0);
+
+// All of the above: reorder faces for the vertex cache and overdraw, then
+// vertices
+void optimize_vertex_cache(vec3 *v, int v_number, GLuint *f, int f_number,
+    vec3 *vn = 0);
+
+#endif
@@ -363,6 +363,71 @@ istream& operator >> (istream& is, vec4& v)
 }
 
 
+//
+// Quaternion
+//
+
+// Constructors
+quat::quat()
+{
+    x = 0, y = 0, z = 0, w = 1;
+}
+
+quat::quat(const GLfloat a, const GLfloat b, const GLfloat c, const GLfloat d)
+{
+    x = a, y = b, z = c, w = d;
+}
+
+quat::quat(const vec3 & axis, const GLfloat theta)
+{
+    GLfloat s = sin(theta / 2);
+
+    x = axis.x * s, y = axis.y * s, z = axis.z * s;
+    w = cos(theta / 2);
+}
+
+quat operator * (const quat & p, const quat & q)
+{
+    return quat(
+        p.w * q.x + p.x * q.w + p.y * q.z - p.z * q.y,
+        p.w * q.y - p.x * q.z + p.y * q.w + p.z * q.x,
+        p.w * q.z + p.x * q.y - p.y * q.x + p.z * q.w,
+        p.w * q.w - p.x * q.x - p.y * q.y - p.z * q.z
+    );
+}
+
+ostream& operator << (ostream& os, const quat& q)
+{
+    return os << q.x << ' ' << q.y << ' ' << q.z << ' ' << q.w;
+}
+
+GLfloat length(const quat & q)
+{
+    return sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+}
+
+quat normalize(const quat & q)
+{
+    GLfloat l = length(q);
+
+    return quat(q.x / l, q.y / l, q.z / l, q.w / l);
+}
+
+quat conjugate(const quat & q)
+{
+    return quat(-q.x, -q.y, -q.z, q.w);
+}
+
+// v + 2 w (u x v) + 2 u x (u x v) for q = (u, w)
+vec3 rotate(const quat & q, const vec3 & v)
+{
+    vec3 u(q.x, q.y, q.z);
+    vec3 t = 2 * (u * v);
+
+    return v + q.w * t + u * t;
+}
+
+
 //
 // Math functions
 //
@@ -387,3 +452,30 @@ bool belongs_to_segment(const vec2 & point, const vec2 & end_0,
 
     return false;
 }
+
+vec2 oct_encode(const vec3 & n)
+{
+    GLfloat l = fabs(n.x) + fabs(n.y) + fabs(n.z);
+    vec2 e(n.x / l, n.y / l);
+
+    // Lower hemisphere is folded over the diagonals
+    if (n.z < 0)
+        e = vec2(
+            (1 - fabs(e.y)) * (e.x >= 0 ? 1 : -1),
+            (1 - fabs(e.x)) * (e.y >= 0 ? 1 : -1));
+
+    return e;
+}
+
+vec3 oct_decode(const vec2 & e)
+{
+    vec3 n(e.x, e.y, 1 - fabs(e.x) - fabs(e.y));
+
+    if (n.z < 0) {
+        GLfloat x = n.x;
+        n.x = (1 - fabs(n.y)) * (x >= 0 ? 1 : -1);
+        n.y = (1 - fabs(x)) * (n.y >= 0 ? 1 : -1);
+    }
+
+    return normalize(n);
+}
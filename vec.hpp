@@ -163,6 +163,48 @@ struct vec4 {
 };
 
 
+//
+// Quaternion x i + y j + z k + w, unit quaternions are rotations
+//
+struct quat {
+    GLfloat x;
+    GLfloat y;
+    GLfloat z;
+    GLfloat w;
+
+    // Constructors, the default one is the identity rotation
+    quat();
+    quat(const GLfloat a, const GLfloat b, const GLfloat c, const GLfloat d);
+
+    // Rotation by angle theta about a unit axis, counterclockwise looking
+    // from its end as RotX() and RotZ() (RotY() turns the other way)
+    quat(const vec3 & axis, const GLfloat theta);
+
+    //
+    // Operator overloading
+    //
+
+    // Hamilton product: rotation p * q is q followed by p
+    friend quat operator * (const quat & p, const quat & q);
+
+    // Output
+    friend ostream& operator << (ostream& os, const quat& q);
+};
+
+// Length of a quaternion
+GLfloat length(const quat & q);
+
+// Normalized quaternion: products of unit quaternions drift away from unit
+// length slowly, normalizing brings them back to rotations exactly
+quat normalize(const quat & q);
+
+// Inverse rotation of a unit quaternion
+quat conjugate(const quat & q);
+
+// Rotate a vector by a unit quaternion
+vec3 rotate(const quat & q, const vec3 & v);
+
+
 //
 // Some geometrical functions involving vectors
 //
@@ -171,4 +213,8 @@ struct vec4 {
 bool belongs_to_segment(const vec2 & point, const vec2 & end_0,
     const vec2 & end_1, const double precision);
 
+// Octahedral mapping of a unit vector to the square [-1, 1]^2 and back
+vec2 oct_encode(const vec3 & n);
+vec3 oct_decode(const vec2 & e);
+
 #endif